@@ -0,0 +1,43 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file examples/floating-point/constexpr_codecs.cpp
+ *
+ * @brief Compile-time conversions from floating_point.hpp.
+ *
+ * Including the header runs its static_asserts, so this example must be
+ * built as C++20. At run time it checks the constexpr encoders against the
+ * C library on a stride through every fp32 bit pattern.
+ */
+
+#include "floating_point.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace fixed_point::literals;
+
+constexpr float16_t  half_max      = 65504.0_h;
+constexpr float16_t  half_overflow = 70000.0_h;
+constexpr bfloat16_t bf_quarter    = 0.25_bf;
+constexpr auto       fp8_values    = fixed_point::float8_table();
+
+int main(void) {
+    printf("65504.0_h = 0x%04X\n", half_max);
+    printf("70000.0_h = 0x%04X\n", half_overflow);
+    printf("0.25_bf   = 0x%04X\n", bf_quarter);
+    printf("fp8 0x7E  = %g\n", fp8_values[0x7E]);
+
+    // 4093 is prime, so the stride visits every exponent and sign
+    size_t mismatches = 0;
+    for (uint64_t i = 0; i <= UINT32_MAX; i += 4093) {
+        const float value = decode_float32((float32_t) i);
+        mismatches += fixed_point::encode_float16(value) != encode_float16(value);
+        mismatches += fixed_point::encode_bfloat16(value) != encode_bfloat16(value);
+        mismatches += fixed_point::encode_float8(value) != encode_float8(value);
+    }
+
+    printf("%zu mismatches against the C codecs\n", mismatches);
+    return 0 == mismatches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,139 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/bit_dump.h
+ *
+ * @brief Bulk text rendering and statistics for raw number buffers.
+ *
+ * bit_dump_format() renders one fixed-width line per element into a caller
+ * buffer, without stdio:
+ *
+ *              index            value  hex     s expon mantissa
+ *                 42  -1.50000000e+00  0xBE00  1 01111 1000000000
+ *
+ * Each encoding splits its bits into sign, exponent and mantissa fields; for
+ * fixed16_t these are the sign, the 15 integer bits and the 16 fraction bits.
+ * Values are printed with nine significant digits, enough to round-trip any
+ * float. Since every line has the same width, callers can size output
+ * buffers exactly with bit_dump_line_width().
+ */
+
+#ifndef BIT_DUMP_H
+#define BIT_DUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    BIT_DUMP_F32,     // IEEE-754 binary32
+    BIT_DUMP_F16,     // IEEE-754 binary16
+    BIT_DUMP_BF16,    // bfloat16
+    BIT_DUMP_F8,      // OCP E4M3FN
+    BIT_DUMP_FIXED16, // fixed16_t, Q15.16
+    BIT_DUMP_MAX_TYPE,
+} bit_dump_type_t;
+
+/**
+ * @brief Summary of a buffer, accumulated by bit_dump_stats_update().
+ *
+ * min, max, sum and sum_squares cover finite values only. exponents counts
+ * each biased exponent field value and stays zero for fixed16_t.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t zeros;
+    uint64_t subnormals;
+    uint64_t infinities;
+    uint64_t nans;
+    double   min;
+    double   max;
+    double   sum;
+    double   sum_squares;
+    uint64_t exponents[256];
+} bit_dump_stats_t;
+
+/**
+ * @brief Parses "f32", "f16", "bf16", "f8" or "fixed16".
+ *
+ * @return The matching type, or BIT_DUMP_MAX_TYPE if the name is unknown.
+ */
+bit_dump_type_t bit_dump_type_from_name(const char* name);
+
+/**
+ * @brief Name accepted by bit_dump_type_from_name(), or NULL for an unknown type.
+ */
+const char* bit_dump_type_name(bit_dump_type_t type);
+
+/**
+ * @brief Bytes per element.
+ */
+size_t bit_dump_type_size(bit_dump_type_t type);
+
+/**
+ * @brief Characters per rendered line, including the newline.
+ */
+size_t bit_dump_line_width(bit_dump_type_t type);
+
+/**
+ * @brief Writes the column header line.
+ *
+ * @return Characters written, or 0 if capacity is smaller than bit_dump_line_width().
+ */
+size_t bit_dump_header(bit_dump_type_t type, char* out, size_t capacity);
+
+/**
+ * @brief Renders up to n elements, stopping at the last line that fits.
+ *
+ * No terminating NUL is written.
+ *
+ * @param[in]  type        Encoding of src.
+ * @param[in]  src         Elements to render; any alignment.
+ * @param[in]  n           Number of elements.
+ * @param[in]  first_index Index printed for src[0].
+ * @param[out] out         Output characters.
+ * @param[in]  capacity    Size of out in bytes.
+ *
+ * @return Elements rendered; they occupy that many times bit_dump_line_width() bytes.
+ */
+size_t bit_dump_format(
+    bit_dump_type_t type,
+    const void*     src,
+    size_t          n,
+    uint64_t        first_index,
+    char*           out,
+    size_t          capacity
+);
+
+/**
+ * @brief Clears stats to the empty state.
+ */
+void bit_dump_stats_reset(bit_dump_stats_t* stats);
+
+/**
+ * @brief Classifies n elements and adds them to stats.
+ */
+void bit_dump_stats_update(
+    bit_dump_type_t type, const void* src, size_t n, bit_dump_stats_t* stats
+);
+
+/**
+ * @brief Adds src into dst. Merging partials in a fixed order gives the same
+ *        sums for any thread count.
+ */
+void bit_dump_stats_merge(bit_dump_stats_t* dst, const bit_dump_stats_t* src);
+
+/**
+ * @brief Prints counts, range, mean, standard deviation and the exponent histogram.
+ */
+void bit_dump_stats_print(FILE* stream, bit_dump_type_t type, const bit_dump_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BIT_DUMP_H
@@ -0,0 +1,87 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/blas_half.h
+ *
+ * @brief Element-wise and BLAS-1 kernels on float16_t and bfloat16_t arrays.
+ *
+ * Inputs are widened to fp32 in registers, combined, and rounded back to the
+ * storage type on the way out, so no fp32 temporaries are allocated and each
+ * element is read and written exactly once. Results equal computing in fp32
+ * and re-encoding with encode_float16() or encode_bfloat16(). With AVX-512
+ * FP16, add and mul run natively on half precision lanes; a single fp16
+ * rounding of an exact sum or product gives the same bits.
+ *
+ * Output arrays may alias any input array.
+ */
+
+#ifndef BLAS_HALF_H
+#define BLAS_HALF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "floating_point.h"
+
+#include <stddef.h>
+
+/**
+ * @brief out[i] = a[i] + b[i]
+ */
+void add_f16(const float16_t* a, const float16_t* b, float16_t* out, size_t n);
+
+/**
+ * @brief out[i] = a[i] * b[i]
+ */
+void mul_f16(const float16_t* a, const float16_t* b, float16_t* out, size_t n);
+
+/**
+ * @brief out[i] = a[i] * b[i] + c[i], with a single fp32 rounding before re-encoding.
+ */
+void fma_f16(
+    const float16_t* a, const float16_t* b, const float16_t* c, float16_t* out, size_t n
+);
+
+/**
+ * @brief y[i] = alpha * x[i] + y[i]
+ */
+void axpy_f16(float alpha, const float16_t* x, float16_t* y, size_t n);
+
+/**
+ * @brief x[i] = alpha * x[i]
+ */
+void scale_f16(float alpha, float16_t* x, size_t n);
+
+/**
+ * @brief out[i] = a[i] + b[i]
+ */
+void add_bf16(const bfloat16_t* a, const bfloat16_t* b, bfloat16_t* out, size_t n);
+
+/**
+ * @brief out[i] = a[i] * b[i]
+ */
+void mul_bf16(const bfloat16_t* a, const bfloat16_t* b, bfloat16_t* out, size_t n);
+
+/**
+ * @brief out[i] = a[i] * b[i] + c[i], with a single fp32 rounding before re-encoding.
+ */
+void fma_bf16(
+    const bfloat16_t* a, const bfloat16_t* b, const bfloat16_t* c, bfloat16_t* out, size_t n
+);
+
+/**
+ * @brief y[i] = alpha * x[i] + y[i]
+ */
+void axpy_bf16(float alpha, const bfloat16_t* x, bfloat16_t* y, size_t n);
+
+/**
+ * @brief x[i] = alpha * x[i]
+ */
+void scale_bf16(float alpha, bfloat16_t* x, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BLAS_HALF_H
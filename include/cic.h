@@ -0,0 +1,201 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/cic.h
+ *
+ * @brief Multi-channel CIC decimators, interpolators and moving-average filters.
+ *
+ * A cascaded integrator-comb filter of order N, rate change R and
+ * differential delay M is N running sums at the high rate and N first
+ * differences over M samples at the low rate. No multipliers are needed.
+ * The integrators overflow by design. Two's-complement wrap-around makes
+ * every intermediate value exact modulo 2^64, and the combs remove the
+ * wrapped part, so the output is exact as long as it fits in the register.
+ * The state is uint64_t, where wrapping is defined, and it is read back as
+ * int64_t.
+ *
+ * The DC gain is (R * M)^N for a decimator and R^(N - 1) * M^N for an
+ * interpolator. The output is scaled back to unity gain with a single
+ * rounding shift. When the gain is not a power of two, the full-width sum is
+ * first multiplied by a Q31 correction. Outputs are sum / gain rounded to
+ * nearest, ties up, while |sum| <= 2^31 (fixed16_t signals within [-1, 1]
+ * and gains up to 2^15) and within one LSB beyond. Sums are exact while
+ * |x| * gain < 2^63, and inputs must satisfy |x| < 2^30 (fixed16_t within
+ * [-16384, 16384)). fixed16_t signals within [-1, 1] allow up to
+ * CIC_MAX_GROWTH bits of gain.
+ *
+ * The CIC passband droops like sinc^N. A compensation FIR with Q1.15 taps
+ * can be attached at the low rate: it runs after a decimator and before an
+ * interpolator. cic_design_compensator() derives an inverse-sinc response,
+ * and any other taps can be supplied instead.
+ *
+ * A moving average of length L is a CIC with R = 1 and M = L, so
+ * malloc_moving_average() returns a cic_t. It costs O(order) per sample
+ * whatever the length, and order 2 and above give the cascaded triangular
+ * and smoother kernels.
+ *
+ * Samples are interleaved, src[frame * n_channels + channel]. Four channels
+ * share the 64-bit AVX2 lanes, and their integrators stay in registers for
+ * the whole block. The SIMD and scalar paths match bit for bit.
+ *
+ *     cic_t*  cic = malloc_cic(CIC_DECIMATE, 2, 4, 64, 1);
+ *     int16_t taps[CIC_COMPENSATOR_TAPS];
+ *     cic_design_compensator(cic, 0.5, CIC_COMPENSATOR_TAPS, taps);
+ *     cic_set_compensator(cic, taps, CIC_COMPENSATOR_TAPS);
+ *     while (... next block ...) {
+ *         size_t n = cic_process(cic, adc, frames, out);
+ *         ...
+ *     }
+ *     free_cic(cic);
+ */
+
+#ifndef CIC_H
+#define CIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Highest supported filter order.
+#define CIC_MAX_ORDER         8
+
+/// Largest DC gain, as a power of two, that full-scale fixed16_t input allows in 64 bits.
+#define CIC_MAX_GROWTH        46
+
+/// Default compensation FIR length.
+#define CIC_COMPENSATOR_TAPS  31
+
+/// Longest compensation FIR.
+#define CIC_MAX_COMPENSATOR   256
+
+typedef enum {
+    CIC_DECIMATE,    // n inputs -> floor(n / ratio) outputs, integrators first
+    CIC_INTERPOLATE, // n inputs -> n * ratio outputs, combs first
+} cic_mode_t;
+
+/**
+ * @brief CIC filter state.
+ *
+ * @param mode        Decimation or interpolation.
+ * @param n_channels  Interleaved channels.
+ * @param order       Number of integrator and comb stages, N.
+ * @param ratio       Rate change, R.
+ * @param delay       Differential delay of the combs, M.
+ * @param shift       Rounding shift of the gain normalization.
+ * @param multiplier  Q31 gain correction, rounded up, or 0 when the gain is a power of two.
+ * @param integrators order x n_channels running sums.
+ * @param combs       order x delay x n_channels delay lines.
+ * @param comb_index  Next delay line slot.
+ * @param phase       Inputs since the last decimated output.
+ * @param taps        Q1.15 compensation FIR, or NULL.
+ * @param n_taps      Length of taps.
+ * @param fir_history n_taps x n_channels ring of low-rate samples.
+ * @param fir_index   Next ring slot.
+ * @param scratch     One block of compensated interpolator input.
+ */
+typedef struct {
+    cic_mode_t mode;
+    size_t     n_channels;
+    size_t     order;
+    size_t     ratio;
+    size_t     delay;
+    int32_t    shift;
+    int32_t    multiplier;
+    uint64_t*  integrators;
+    uint64_t*  combs;
+    size_t     comb_index;
+    size_t     phase;
+    int16_t*   taps;
+    size_t     n_taps;
+    fixed16_t* fir_history;
+    size_t     fir_index;
+    fixed16_t* scratch;
+} cic_t;
+
+/**
+ * @brief Creates a CIC filter with cleared state.
+ *
+ * @param mode       CIC_DECIMATE or CIC_INTERPOLATE.
+ * @param n_channels Interleaved channels, at least 1.
+ * @param order      Stages in [1, CIC_MAX_ORDER].
+ * @param ratio      Rate change, at least 1.
+ * @param delay      Differential delay, at least 1; usually 1 or 2.
+ * @return The filter, or NULL for invalid parameters, a gain above 2^CIC_MAX_GROWTH
+ *         or an allocation failure.
+ */
+cic_t* malloc_cic(cic_mode_t mode, size_t n_channels, size_t order, size_t ratio, size_t delay);
+
+/**
+ * @brief Creates a moving average of length samples, cascaded order times.
+ *
+ * Every output is the rounded mean of the last length inputs (order 1), or
+ * the mean of those means for higher orders. Inputs before the first call
+ * count as zero.
+ */
+cic_t* malloc_moving_average(size_t n_channels, size_t length, size_t order);
+
+/**
+ * @brief Frees a filter returned by malloc_cic() or malloc_moving_average().
+ */
+void free_cic(cic_t* cic);
+
+/**
+ * @brief Clears the integrators, delay lines and compensator history.
+ */
+void cic_reset(cic_t* cic);
+
+/**
+ * @brief Attaches a compensation FIR that runs at the low rate.
+ *
+ * @param taps   n_taps Q1.15 coefficients, copied; NULL removes the compensator.
+ * @param n_taps Length in [1, CIC_MAX_COMPENSATOR].
+ * @return false for an invalid length or an allocation failure; the filter is then unchanged.
+ */
+bool cic_set_compensator(cic_t* cic, const int16_t* taps, size_t n_taps);
+
+/**
+ * @brief Designs a linear-phase FIR that flattens the passband droop of cic.
+ *
+ * The response is the inverse of the CIC's response up to the passband edge,
+ * rolls off to zero over the same width again, and has unity DC gain. The
+ * boost is capped at 24 dB near the CIC's nulls. Setup runs in double
+ * precision and is meant for offline use.
+ *
+ * @param[in]  passband Passband edge as a fraction of the low-rate Nyquist frequency, in (0, 1).
+ * @param[in]  n_taps   Length in [1, CIC_MAX_COMPENSATOR]; odd lengths delay by a whole sample.
+ * @param[out] taps     n_taps Q1.15 coefficients.
+ * @return false, leaving taps untouched, when n_taps is out of range.
+ */
+bool cic_design_compensator(const cic_t* cic, double passband, size_t n_taps, int16_t* taps);
+
+/**
+ * @brief Upper bound on the frames one cic_process() call writes for n input frames.
+ */
+size_t cic_max_output(const cic_t* cic, size_t n);
+
+/**
+ * @brief Filters n interleaved input frames and writes every output they complete.
+ *
+ * A decimator emits one frame per ratio inputs and carries the remainder
+ * over to the next call. An interpolator emits ratio frames per input. Block
+ * sizes never change the output stream.
+ *
+ * @param[in,out] cic Filter state.
+ * @param[in]     src n * n_channels samples.
+ * @param[in]     n   Input frames.
+ * @param[out]    dst Room for cic_max_output(cic, n) frames; may not alias src.
+ * @return Frames written to dst.
+ */
+size_t cic_process(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CIC_H
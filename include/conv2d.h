@@ -0,0 +1,203 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/conv2d.h
+ *
+ * @brief Integer 2D convolution over NHWC int8 and Q15 tensors.
+ *
+ * Standard convolutions are lowered with im2col. A tile of CONV2D_TILE_M
+ * output pixels is gathered into int16 patch rows, multiplied against
+ * int8 weights pre-packed into int16 panels of CONV2D_NR output channels, and
+ * accumulated in int32. Depthwise convolutions skip the lowering and
+ * accumulate each channel directly from the input. Both paths finish with the
+ * same fused epilogue: bias, optional ReLU, then per-channel requantization
+ * through Q31 multipliers (see quant_affine.h) to int8 or Q15.
+ *
+ * Tensor layouts:
+ *
+ * - Input:             batch x height x width x in_channels (NHWC)
+ * - Weights:           out_channels x kernel_h x kernel_w x in_channels (OHWI)
+ * - Depthwise weights: kernel_h x kernel_w x channels (HWC)
+ * - Output:            batch x out_h x out_w x out_channels (NHWC)
+ *
+ * int8 tensors are affine with a per-tensor zero point, and weights are
+ * symmetric. Q15 tensors are symmetric int16. Products are summed in int32
+ * and are exact while the patch length K = kernel_h * kernel_w * in_channels
+ * stays within 2^31 / 2^22 = 512 for Q15 inputs and 2^31 / 2^15 = 65536 for
+ * int8 inputs (kernel_h * kernel_w for depthwise layers). Longer patches
+ * round every product pair down by the fewest bits that rule out overflow
+ * at full scale, one bit per doubling of K, and the epilogue shifts by that
+ * much less; this costs at most half an accumulator LSB per pair. Any K
+ * below 2^31 is supported.
+ */
+
+#ifndef CONV2D_H
+#define CONV2D_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+#include "quant_affine.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Output pixels lowered and multiplied per tile.
+#define CONV2D_TILE_M 32
+
+/// Patch rows per micro-kernel step.
+#define CONV2D_MR     4
+
+/// Output channels per packed weight panel and micro-kernel step.
+#define CONV2D_NR     8
+
+typedef enum {
+    CONV2D_I8,  // Affine int8
+    CONV2D_Q15, // Symmetric Q1.15 int16
+} conv2d_type_t;
+
+/**
+ * @brief Convolution geometry.
+ *
+ * Padding is applied symmetrically: pad_h rows above and below and pad_w
+ * columns on both sides. Zero strides and dilations are treated as 1.
+ */
+typedef struct {
+    size_t batch;
+    size_t height;
+    size_t width;
+    size_t in_channels;
+    size_t out_channels;
+    size_t kernel_h;
+    size_t kernel_w;
+    size_t stride_h;
+    size_t stride_w;
+    size_t pad_h;
+    size_t pad_w;
+    size_t dilation_h;
+    size_t dilation_w;
+} conv2d_shape_t;
+
+/**
+ * @brief Fused output stage, applied per output channel.
+ *
+ * acc = max(acc + bias, 0) when relu is set, otherwise acc + bias. An int8
+ * output is clamp(fixed_mul_shift(acc, multiplier, shift) + output_zero_point).
+ * A Q15 output is the same product, saturated to int16.
+ *
+ * @param bias              out_channels int32 biases in accumulator units, or NULL.
+ * @param multiplier        out_channels Q31 multipliers.
+ * @param shift             out_channels shifts.
+ * @param input_zero_point  Zero point of an int8 input; ignored for Q15.
+ * @param output_zero_point Zero point of an int8 output; ignored for Q15.
+ * @param relu              Clamps negative results to real zero.
+ */
+typedef struct {
+    const int32_t* bias;
+    const int32_t* multiplier;
+    const int32_t* shift;
+    int32_t        input_zero_point;
+    int32_t        output_zero_point;
+    bool           relu;
+} conv2d_epilogue_t;
+
+/**
+ * @brief Weights packed for the im2col micro-kernel.
+ *
+ * @param out_channels Output channels.
+ * @param k            Patch length, kernel_h * kernel_w * in_channels.
+ * @param k_pad        k rounded up to even, the int16 pair width of the panels.
+ * @param panels       ceil(out_channels / CONV2D_NR) panels; each holds k_pad / 2 steps of
+ *                     CONV2D_NR channel pairs, zero filled past out_channels and k.
+ */
+typedef struct {
+    size_t   out_channels;
+    size_t   k;
+    size_t   k_pad;
+    int16_t* panels;
+} conv2d_weights_t;
+
+/**
+ * @brief Output height, (height + 2 * pad_h - dilation_h * (kernel_h - 1) - 1) / stride_h + 1.
+ */
+size_t conv2d_out_height(const conv2d_shape_t* shape);
+
+/**
+ * @brief Output width, computed like conv2d_out_height().
+ */
+size_t conv2d_out_width(const conv2d_shape_t* shape);
+
+/**
+ * @brief Integer-only requantization multiplier for input_scale * weight_scale / output_scale.
+ *
+ * All three scales are positive fixed16_t reals; the product is formed in 64
+ * bits, so scales far below 2^-16 in combination keep their precision.
+ */
+quant_multiplier_t conv2d_multiplier(
+    fixed16_t input_scale, fixed16_t weight_scale, fixed16_t output_scale
+);
+
+/**
+ * @brief Packs OHWI int8 weights into int16 panels, once per layer.
+ *
+ * @return The packed weights, or NULL on an allocation failure.
+ */
+conv2d_weights_t* malloc_conv2d_weights(const conv2d_shape_t* shape, const int8_t* w);
+
+/**
+ * @brief Frees weights returned by malloc_conv2d_weights().
+ */
+void free_conv2d_weights(conv2d_weights_t* weights);
+
+/**
+ * @brief Standard convolution through im2col and an integer GEMM.
+ *
+ * @param[in]  shape     Geometry.
+ * @param[in]  src_type  Input encoding.
+ * @param[in]  src       NHWC input.
+ * @param[in]  weights   Weights packed for this shape.
+ * @param[in]  epilogue  Bias, activation and requantization.
+ * @param[in]  dst_type  Output encoding.
+ * @param[out] dst       NHWC output.
+ * @param[in]  n_threads Worker count; 1 runs inline on the caller, 0 uses every processor.
+ *
+ * @return false if the per-thread tile buffers cannot be allocated.
+ */
+bool conv2d(
+    const conv2d_shape_t*    shape,
+    conv2d_type_t            src_type,
+    const void*              src,
+    const conv2d_weights_t*  weights,
+    const conv2d_epilogue_t* epilogue,
+    conv2d_type_t            dst_type,
+    void*                    dst,
+    size_t                   n_threads
+);
+
+/**
+ * @brief Depthwise convolution with one filter per channel.
+ *
+ * shape->out_channels must equal shape->in_channels. See conv2d() for the
+ * remaining parameters.
+ *
+ * @param[in] w kernel_h x kernel_w x channels int8 weights.
+ */
+bool conv2d_depthwise(
+    const conv2d_shape_t*    shape,
+    conv2d_type_t            src_type,
+    const void*              src,
+    const int8_t*            w,
+    const conv2d_epilogue_t* epilogue,
+    conv2d_type_t            dst_type,
+    void*                    dst,
+    size_t                   n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CONV2D_H
@@ -0,0 +1,94 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/fixed_math.h
+ *
+ * @brief Integer-only log2, exp2, pow and rsqrt for fixed16_t.
+ *
+ * Arguments are normalized with a leading-zero count. A short minimax
+ * polynomial then evaluates the reduced argument in Q28, using 64-bit
+ * products and no floating point. The array forms use the same Q28
+ * arithmetic under AVX2, emulating lzcnt through the int-to-float exponent,
+ * so their results are bit-identical to the scalar functions.
+ *
+ * Maximum errors over the whole fixed16_t domain, in ulps of 2^-16:
+ *
+ * - fixed_log2:  0.63 ulp
+ * - fixed_exp2:  0.5 ulp from rounding plus 1e-7 relative, which exceeds
+ *                1 ulp only for results above 2^8
+ * - fixed_rsqrt: 0.51 ulp
+ */
+
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Fractional bits of the internal polynomial arithmetic.
+#define FIXED_MATH_Q 28
+
+/**
+ * @brief Base-2 logarithm.
+ *
+ * @param x Positive argument.
+ * @return log2(x), in [-16, 15); INT32_MIN for x <= 0.
+ */
+fixed16_t fixed_log2(fixed16_t x);
+
+/**
+ * @brief Power of two.
+ *
+ * @return 2^x; INT32_MAX for x >= 15 and 0 once the result rounds below 2^-16.
+ */
+fixed16_t fixed_exp2(fixed16_t x);
+
+/**
+ * @brief x raised to y, as 2^(y * log2(x)).
+ *
+ * The product y * log2(x) is kept with 26 fractional bits, so large
+ * exponents do not amplify the rounding of log2(x) to 16 bits.
+ *
+ * @param x Non-negative base.
+ * @param y Exponent.
+ * @return x^y, saturated to [0, INT32_MAX]. 0^y is 0 for y > 0, 1 for y = 0
+ *         and INT32_MAX for y < 0. Negative bases return 0.
+ */
+fixed16_t fixed_pow(fixed16_t x, fixed16_t y);
+
+/**
+ * @brief Reciprocal square root.
+ *
+ * Starts from a cubic estimate on [1, 4) and refines it with two
+ * Newton-Raphson steps.
+ *
+ * @return 1 / sqrt(x); INT32_MAX for x <= 0.
+ */
+fixed16_t fixed_rsqrt(fixed16_t x);
+
+/**
+ * @brief y[i] = fixed_log2(x[i]) for n elements.
+ */
+void fixed_log2_array(const fixed16_t* x, fixed16_t* y, size_t n);
+
+/**
+ * @brief y[i] = fixed_exp2(x[i]) for n elements.
+ */
+void fixed_exp2_array(const fixed16_t* x, fixed16_t* y, size_t n);
+
+/**
+ * @brief y[i] = fixed_rsqrt(x[i]) for n elements.
+ */
+void fixed_rsqrt_array(const fixed16_t* x, fixed16_t* y, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FIXED_MATH_H
@@ -98,6 +98,59 @@ typedef int32_t fixed16_t;
  */
 #define FIXED_TO_FLOAT(x) ((float) (x) / FIXED_VAL)
 
+/// Number of fractional bits in a Q31 multiplier.
+#define Q31_SIZE          31
+
+/**
+ * @brief Rounding doubling high multiply of two Q31 values.
+ *
+ * Returns the upper 32 bits of 2 * a * b rounded to nearest (ties toward
+ * positive infinity), i.e. (a * b) / 2^31. The single overflowing input
+ * pair, INT32_MIN * INT32_MIN, saturates to INT32_MAX.
+ *
+ * @param a Left operand.
+ * @param b Right operand, typically a Q31 multiplier in [2^30, 2^31).
+ * @return The rounded Q31 product.
+ */
+static inline int32_t fixed_mul_q31(int32_t a, int32_t b) {
+    if (INT32_MIN == a && INT32_MIN == b) {
+        return INT32_MAX;
+    }
+    const int64_t product = (int64_t) a * (int64_t) b;
+    return (int32_t) ((product + ((int64_t) 1 << (Q31_SIZE - 1))) >> Q31_SIZE);
+}
+
+/**
+ * @brief Arithmetic right shift that rounds to nearest, ties away from zero.
+ *
+ * @param x     Value to shift.
+ * @param shift Number of bits in [0, 31].
+ * @return x / 2^shift rounded to nearest.
+ */
+static inline int32_t fixed_round_shift(int32_t x, int shift) {
+    const int32_t mask      = (int32_t) (((int64_t) 1 << shift) - 1);
+    const int32_t remainder = x & mask;
+    const int32_t threshold = (mask >> 1) + (x < 0);
+    return (x >> shift) + (remainder > threshold);
+}
+
+/**
+ * @brief Scales x by a Q31 multiplier and a power of two: x * (m / 2^31) * 2^-shift.
+ *
+ * @param x          Value to scale, usually an int32 accumulator.
+ * @param multiplier Q31 multiplier in [2^30, 2^31).
+ * @param shift      Right shift in [-31, 31]; negative values shift left before
+ *                   multiplying, saturating to the int32 range.
+ * @return The scaled value, rounded to nearest.
+ */
+static inline int32_t fixed_mul_shift(int32_t x, int32_t multiplier, int32_t shift) {
+    const int32_t left  = shift < 0 ? -shift : 0;
+    const int32_t right = shift > 0 ? shift : 0;
+    int64_t       wide  = (int64_t) x * ((int64_t) 1 << left);
+    wide                = wide > INT32_MAX ? INT32_MAX : (wide < INT32_MIN ? INT32_MIN : wide);
+    return fixed_round_shift(fixed_mul_q31((int32_t) wide, multiplier), right);
+}
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
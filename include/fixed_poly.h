@@ -0,0 +1,223 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/fixed_poly.h
+ *
+ * @brief Fixed-point polynomial and rational evaluation with Estrin's scheme.
+ *
+ * Horner's rule needs degree dependent multiply-adds in a chain. Estrin's
+ * scheme pairs neighbouring terms as c[2j] + c[2j+1] * x, which are all
+ * independent, then pairs those results with x^2, x^4, ... It needs only
+ * ceil(log2(degree + 1)) dependent levels, so a degree 7 polynomial finishes
+ * in 3 multiply-add latencies instead of 7.
+ *
+ * Arguments, coefficients and results share one Q format with q fractional
+ * bits. Products are formed in 64 bits and truncated back to 32. A
+ * coefficient may carry its own shift: coeffs[k] is read as a value with
+ * q + shifts[k] fractional bits. Positive shifts keep precision in tiny
+ * high-order terms, and negative shifts fit coefficients larger than
+ * 2^(31 - q). Callers must keep every partial sum and x^(2^level) within
+ * 32 bits, which in practice means |x| <= 1 for q near 30.
+ *
+ * Coefficient tables are constant expressions built with FIXED_POLY_COEFF(),
+ * so they are rounded at compile time:
+ *
+ *     static const int32_t exp2_q28[] = {
+ *         FIXED_POLY_COEFF(0.9999999251, 28),
+ *         FIXED_POLY_COEFF(0.6931530732, 28),
+ *         ...
+ *     };
+ *     static const fixed_poly_t exp2_poly = FIXED_POLY_INIT(exp2_q28, 28);
+ *
+ * The scalar and AVX2 evaluators use the same operation order and
+ * truncation, so their results are bit-identical.
+ */
+
+#ifndef FIXED_POLY_H
+#define FIXED_POLY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+/// Highest supported degree: four Estrin levels.
+#define FIXED_POLY_MAX_DEGREE 15
+
+/// Rounds a real coefficient to q fractional bits at compile time.
+#define FIXED_POLY_COEFF(value, q) \
+    ((int32_t) ((value) * (double) (INT64_C(1) << (q)) + ((value) < 0 ? -0.5 : 0.5)))
+
+/// Number of elements in a coefficient array.
+#define FIXED_POLY_COUNT(coeffs) (sizeof(coeffs) / sizeof((coeffs)[0]))
+
+/// Degree of a coefficient array; more than FIXED_POLY_MAX_DEGREE + 1 coefficients fail to compile.
+#define FIXED_POLY_DEGREE(coeffs) \
+    (FIXED_POLY_COUNT(coeffs) - 1 \
+     + 0 * sizeof(char[FIXED_POLY_COUNT(coeffs) <= FIXED_POLY_MAX_DEGREE + 1 ? 1 : -1]))
+
+/// Initializer for a polynomial over a whole coefficient array, without per-term shifts.
+#define FIXED_POLY_INIT(coeffs, q) {(coeffs), NULL, FIXED_POLY_DEGREE(coeffs), (q)}
+
+/**
+ * @brief A polynomial c[0] + c[1] x + ... + c[degree] x^degree.
+ *
+ * @param coeffs degree + 1 coefficients, lowest power first.
+ * @param shifts Optional extra fractional bits per coefficient, or NULL for none.
+ * @param degree Degree, at most FIXED_POLY_MAX_DEGREE.
+ * @param q      Fractional bits of the argument and the result.
+ */
+typedef struct {
+    const int32_t* coeffs;
+    const int8_t*  shifts;
+    size_t         degree;
+    int            q;
+} fixed_poly_t;
+
+static inline int32_t fixed_poly_mul(int32_t a, int32_t b, int shift) {
+    return (int32_t) (((int64_t) a * b) >> shift);
+}
+
+// Coefficient k in the common Q format when it stands alone
+static inline int32_t fixed_poly_constant(const fixed_poly_t* p, size_t k) {
+    const int shift = p->shifts ? p->shifts[k] : 0;
+    return shift >= 0 ? p->coeffs[k] >> shift : (int32_t) ((uint32_t) p->coeffs[k] << -shift);
+}
+
+// Fractional bits dropped after multiplying coefficient k by the argument
+static inline int fixed_poly_shift(const fixed_poly_t* p, size_t k) {
+    return p->q + (p->shifts ? p->shifts[k] : 0);
+}
+
+/**
+ * @brief Evaluates p at x with Estrin's scheme.
+ *
+ * Inlined with a constant p, the loops unroll into straight-line code.
+ */
+static inline int32_t fixed_poly_eval(const fixed_poly_t* p, int32_t x) {
+    assert(p->degree <= FIXED_POLY_MAX_DEGREE);
+
+    int32_t terms[(FIXED_POLY_MAX_DEGREE + 2) / 2];
+    size_t  count = 0;
+
+    for (size_t k = 0; k <= p->degree; k += 2) {
+        int32_t term = fixed_poly_constant(p, k);
+        if (k + 1 <= p->degree) {
+            term += fixed_poly_mul(p->coeffs[k + 1], x, fixed_poly_shift(p, k + 1));
+        }
+        terms[count++] = term;
+    }
+
+    int32_t power = x;
+    while (count > 1) {
+        power       = fixed_poly_mul(power, power, p->q);
+        size_t next = 0;
+        for (size_t j = 0; j < count; j += 2) {
+            terms[next++] = j + 1 < count ? terms[j] + fixed_poly_mul(terms[j + 1], power, p->q)
+                                          : terms[j];
+        }
+        count = next;
+    }
+
+    return terms[0];
+}
+
+#if defined(__AVX2__)
+
+/**
+ * @brief (a * b) >> shift per lane, keeping the low 32 bits as fixed_poly_mul() does.
+ */
+static inline __m256i fixed_poly_mul_epi32(__m256i a, __m256i b, int shift) {
+    const __m256i even = _mm256_mul_epi32(a, b);
+    const __m256i odd  = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+
+    // Past 32 the result holds sign bits, which only an arithmetic shift of the high half keeps
+    if (shift > 32) {
+        const __m256i high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        return _mm256_sra_epi32(high, _mm_cvtsi32_si128(shift - 32));
+    }
+
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    return _mm256_blend_epi32(
+        _mm256_srl_epi64(even, count), _mm256_slli_epi64(_mm256_srl_epi64(odd, count), 32), 0xAA
+    );
+}
+
+/**
+ * @brief Evaluates p at eight arguments; lane results equal fixed_poly_eval().
+ */
+static inline __m256i fixed_poly_eval_epi32(const fixed_poly_t* p, __m256i x) {
+    assert(p->degree <= FIXED_POLY_MAX_DEGREE);
+
+    __m256i terms[(FIXED_POLY_MAX_DEGREE + 2) / 2];
+    size_t  count = 0;
+
+    for (size_t k = 0; k <= p->degree; k += 2) {
+        __m256i term = _mm256_set1_epi32(fixed_poly_constant(p, k));
+        if (k + 1 <= p->degree) {
+            term = _mm256_add_epi32(
+                term,
+                fixed_poly_mul_epi32(
+                    _mm256_set1_epi32(p->coeffs[k + 1]), x, fixed_poly_shift(p, k + 1)
+                )
+            );
+        }
+        terms[count++] = term;
+    }
+
+    __m256i power = x;
+    while (count > 1) {
+        power       = fixed_poly_mul_epi32(power, power, p->q);
+        size_t next = 0;
+        for (size_t j = 0; j < count; j += 2) {
+            terms[next] = terms[j];
+            if (j + 1 < count) {
+                const __m256i high = fixed_poly_mul_epi32(terms[j + 1], power, p->q);
+                terms[next]        = _mm256_add_epi32(terms[j], high);
+            }
+            next++;
+        }
+        count = next;
+    }
+
+    return terms[0];
+}
+
+#endif
+
+/**
+ * @brief y[i] = p(x[i]) for n elements.
+ */
+void fixed_poly_eval_array(const fixed_poly_t* p, const int32_t* x, int32_t* y, size_t n);
+
+/**
+ * @brief num(x) / den(x) in the numerator's Q format.
+ *
+ * Both polynomials must share q. The quotient is saturated to the int32
+ * range; a zero denominator gives INT32_MAX or INT32_MIN by the sign of the
+ * numerator.
+ */
+int32_t fixed_rational_eval(const fixed_poly_t* num, const fixed_poly_t* den, int32_t x);
+
+/**
+ * @brief y[i] = num(x[i]) / den(x[i]) for n elements.
+ *
+ * Both polynomials are evaluated eight lanes at a time and only the
+ * divisions are scalar.
+ */
+void fixed_rational_eval_array(
+    const fixed_poly_t* num, const fixed_poly_t* den, const int32_t* x, int32_t* y, size_t n
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FIXED_POLY_H
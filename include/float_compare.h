@@ -0,0 +1,94 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/float_compare.h
+ *
+ * @brief Bulk approximate-equality and ULP-distance checks over encoded arrays.
+ *
+ * These are the array-level counterparts of float_is_close(). They use the
+ * same tolerance convention, 10^-significand. A pair (a, ref) is close when
+ * a == ref, or when both are finite and
+ *
+ *     |a - ref| <= 10^-significand * max(1, |a|, |ref|)
+ *
+ * The tolerance is absolute near zero and relative elsewhere. NaN is never
+ * close to anything.
+ *
+ * The tested array may be fp32, fp16 or bf16 and is widened in registers;
+ * references are fp32. Work is split into COMPARE_CHUNK-element chunks across
+ * threads, and all_close() stops every worker at the first mismatch.
+ *
+ * @param type        Encoding of the tested array: TYPE_FLOAT_F32, TYPE_FLOAT_F16
+ *                    or TYPE_FLOAT_BF16.
+ * @param significand Decimal digits of agreement, as for float_is_close().
+ * @param n_threads   Worker count; 0 uses every online processor.
+ */
+
+#ifndef FLOAT_COMPARE_H
+#define FLOAT_COMPARE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "floating_point.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Elements per independently scheduled chunk.
+#define COMPARE_CHUNK (1 << 14)
+
+/**
+ * @brief True when every element of a is close to the matching reference.
+ */
+bool all_close(
+    data_type_t  type,
+    const void*  a,
+    const float* ref,
+    size_t       n,
+    int64_t      significand,
+    size_t       n_threads
+);
+
+/**
+ * @brief Number of elements of a that are not close to their reference.
+ */
+size_t count_not_close(
+    data_type_t  type,
+    const void*  a,
+    const float* ref,
+    size_t       n,
+    int64_t      significand,
+    size_t       n_threads
+);
+
+/**
+ * @brief Largest |a - ref| / |ref| over the arrays.
+ *
+ * Equal pairs (including equal infinities) contribute 0. A pair with a NaN,
+ * a zero reference against a nonzero value, or an overflowing difference
+ * contributes INFINITY.
+ */
+float max_relative_error(
+    data_type_t type, const void* a, const float* ref, size_t n, size_t n_threads
+);
+
+/**
+ * @brief Largest distance in units in the last place between two arrays of one encoding.
+ *
+ * Codes are mapped to a monotonic integer line, so +0 and -0 are 0 ULP apart
+ * and the largest finite value is 1 ULP from infinity.
+ *
+ * @return The maximum distance, or UINT32_MAX if any pair involves a NaN.
+ */
+uint32_t max_ulp_distance(
+    data_type_t type, const void* a, const void* b, size_t n, size_t n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FLOAT_COMPARE_H
@@ -45,9 +45,16 @@ typedef enum {
     TYPE_FLOAT_F32,  // IEEE-754 32-bit precision
     TYPE_FLOAT_F16,  // IEEE-754 16-bit precision
     TYPE_FLOAT_BF16, // Google Brain bfloat16 precision
-    TYPE_FLOAT_F8,   // Extended 8-bit precision
+    TYPE_FLOAT_F8,   // Extended 8-bit precision (OCP E4M3FN)
     TYPE_QUANT_K8,   // k-bit precision
     TYPE_QUANT_K4,   // k-bit precision
+    TYPE_QUANT_K2,   // k-bit precision
+    TYPE_MX_FP8,     // OCP microscaling, E4M3 elements
+    TYPE_MX_FP6,     // OCP microscaling, E2M3 elements
+    TYPE_MX_FP4,     // OCP microscaling, E2M1 elements
+    TYPE_MX_INT8,    // OCP microscaling, 8-bit integer elements
+    TYPE_QUANT_FP4,  // 4-bit E2M1 codebook
+    TYPE_QUANT_NF4,  // 4-bit NormalFloat codebook
     TYPE_MAX_COUNT,  // Number of data types
 } data_type_t;
 
@@ -142,7 +149,9 @@ float decode_bfloat16(bfloat16_t bits);
 
 /**
  * @brief Encodes a given float value into its corresponding 8-bit representation (Extended 8-bit
- * floating point).
+ * floating point, OCP E4M3FN: 4 exponent bits with bias 7, 3 mantissa bits, no infinities).
+ *
+ * Rounds to nearest even and saturates out of range values to ±448.
  *
  * @param[in] value The floating point number to be encoded.
  *
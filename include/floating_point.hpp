@@ -0,0 +1,261 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/floating_point.hpp
+ *
+ * @brief C++20 constexpr counterparts of the floating_point.h conversions.
+ *
+ * Every function here reproduces its C namesake bit for bit, but uses
+ * std::bit_cast instead of a union so it can be evaluated at compile time.
+ * Constants and lookup tables built from these functions are emitted into
+ * .rodata rather than computed at startup, e.g.
+ *
+ * @code
+ * using namespace fixed_point::literals;
+ *
+ * constexpr float16_t one_and_half = 1.5_h;
+ * constexpr auto      fp8_values   = fixed_point::float8_table();
+ * @endcode
+ *
+ * Literals are converted to float first, exactly as a C call would receive
+ * them, then encoded.
+ */
+
+#ifndef FLOATING_POINT_HPP
+#define FLOATING_POINT_HPP
+
+#include "fixed_point.h"
+#include "floating_point.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace fixed_point {
+
+/*
+ * Binary 32-bit floating point
+ */
+
+constexpr float32_t encode_float32(float value) {
+    return std::bit_cast<float32_t>(value);
+}
+
+constexpr float decode_float32(float32_t bits) {
+    return std::bit_cast<float>(bits);
+}
+
+// fabsf() is not constexpr before C++23
+constexpr float abs_float32(float value) {
+    return decode_float32(encode_float32(value) & UINT32_C(0x7FFFFFFF));
+}
+
+/*
+ * Binary 16-bit floating point
+ */
+
+constexpr float16_t encode_float16(float value) {
+    // Magnitudes from 65520 up round to infinity; return it before the scaling
+    // below overflows, which a constant expression may not do
+    const uint32_t magnitude = encode_float32(value) & UINT32_C(0x7FFFFFFF);
+    if (magnitude >= UINT32_C(0x477FF000) && magnitude <= UINT32_C(0x7F800000)) {
+        return static_cast<float16_t>(((encode_float32(value) >> 16) & 0x8000) | 0x7C00);
+    }
+
+    const float scale_to_inf  = decode_float32(UINT32_C(0x77800000));
+    const float scale_to_zero = decode_float32(UINT32_C(0x08800000));
+
+    const float saturated_f = abs_float32(value) * scale_to_inf;
+    float       base        = saturated_f * scale_to_zero;
+
+    const uint32_t f      = encode_float32(value);
+    const uint32_t shl1_f = f + f;
+    const uint32_t sign   = f & UINT32_C(0x80000000);
+    uint32_t       bias   = shl1_f & UINT32_C(0xFF000000);
+    if (bias < UINT32_C(0x71000000)) {
+        bias = UINT32_C(0x71000000);
+    }
+
+    base                         = decode_float32((bias >> 1) + UINT32_C(0x07800000)) + base;
+    const uint32_t bits          = encode_float32(base);
+    const uint32_t exp_bits      = (bits >> 13) & UINT32_C(0x00007C00);
+    const uint32_t mantissa_bits = bits & UINT32_C(0x00000FFF);
+    const uint32_t nonsign       = exp_bits + mantissa_bits;
+
+    return static_cast<float16_t>(
+        (sign >> 16) | (shl1_f > UINT32_C(0xFF000000) ? UINT16_C(0x7E00) : nonsign)
+    );
+}
+
+constexpr float decode_float16(float16_t bits) {
+    const uint32_t f      = static_cast<uint32_t>(bits) << 16;
+    const uint32_t sign   = f & UINT32_C(0x80000000);
+    const uint32_t shl1_f = f + f;
+
+    const uint32_t exp_offset       = UINT32_C(0xE0) << 23;
+    const float    exp_scale        = decode_float32(UINT32_C(0x7800000));
+    const float    normalized_value = decode_float32((shl1_f >> 4) + exp_offset) * exp_scale;
+
+    const uint32_t magic_mask         = UINT32_C(126) << 23;
+    const float    magic_bias         = 0.5f;
+    const float    denormalized_value = decode_float32((shl1_f >> 17) | magic_mask) - magic_bias;
+
+    const uint32_t denormalized_cutoff = UINT32_C(1) << 27;
+    return decode_float32(
+        sign
+        | (shl1_f < denormalized_cutoff ? encode_float32(denormalized_value)
+                                        : encode_float32(normalized_value))
+    );
+}
+
+/*
+ * 16-bit brain floating point
+ */
+
+constexpr bfloat16_t encode_bfloat16(float value) {
+    const uint32_t bits = encode_float32(value);
+
+    // NaN: force to quiet NaN
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        return static_cast<bfloat16_t>((bits >> 16) | 0x0040);
+    }
+
+    // Subnormals flush to zero
+    if ((bits & 0x7f800000) == 0) {
+        return static_cast<bfloat16_t>((bits >> 16) & 0x8000);
+    }
+
+    // Round to nearest even
+    return static_cast<bfloat16_t>((bits + 0x00007fff + ((bits >> 16) & 1)) >> 16);
+}
+
+constexpr float decode_bfloat16(bfloat16_t bits) {
+    return decode_float32(static_cast<uint32_t>(bits) << 16);
+}
+
+/*
+ * 8-bit floating point (OCP E4M3FN)
+ */
+
+constexpr float8_t encode_float8(float value) {
+    const uint32_t bits = encode_float32(value);
+    const uint8_t  sign = (bits >> 24) & 0x80;
+    const uint32_t abs  = bits & UINT32_C(0x7FFFFFFF);
+
+    if (abs > UINT32_C(0x7F800000)) {
+        return sign | 0x7F;
+    }
+
+    if (abs >= UINT32_C(0x43E00000)) {
+        return sign | 0x7E;
+    }
+
+    if (abs < UINT32_C(0x3C800000)) {
+        // Exact scaling into [0, 8), then round half to even as nearbyintf() does
+        const float scaled = decode_float32(abs) * 512.0f;
+        uint8_t     whole  = static_cast<uint8_t>(scaled);
+        const float frac   = scaled - static_cast<float>(whole);
+        if (frac > 0.5f || (frac == 0.5f && (whole & 1))) {
+            whole++;
+        }
+        return sign | whole;
+    }
+
+    const uint32_t rounded = abs + UINT32_C(0x0007FFFF) + ((abs >> 20) & 1);
+    return sign | static_cast<uint8_t>((((rounded >> 23) - 120) << 3) | ((rounded >> 20) & 0x07));
+}
+
+constexpr float decode_float8(float8_t bits) {
+    const uint32_t sign     = static_cast<uint32_t>(bits & 0x80) << 24;
+    const uint32_t exponent = (bits >> 3) & 0x0F;
+    const uint32_t mantissa = bits & 0x07;
+
+    if (0x0F == exponent && 0x07 == mantissa) {
+        return decode_float32(sign | UINT32_C(0x7FC00000));
+    }
+
+    if (0 == exponent) {
+        return decode_float32(sign | encode_float32(static_cast<float>(mantissa) / 512.0f));
+    }
+
+    return decode_float32(sign | ((exponent + 120) << 23) | (mantissa << 20));
+}
+
+/*
+ * Fixed-point Q formats
+ */
+
+/**
+ * @brief Converts to a signed Q format with Frac fractional bits, truncating
+ *        toward zero like FLOAT_TO_FIXED().
+ */
+template <int Frac>
+constexpr int32_t encode_fixed(double value) {
+    static_assert(Frac >= 0 && Frac < 32, "Q format must fit in 32 bits");
+    return static_cast<int32_t>(value * static_cast<double>(INT64_C(1) << Frac));
+}
+
+/**
+ * @brief Converts a signed Q format value with Frac fractional bits to float.
+ */
+template <int Frac>
+constexpr float decode_fixed(int32_t value) {
+    static_assert(Frac >= 0 && Frac < 32, "Q format must fit in 32 bits");
+    return static_cast<float>(static_cast<double>(value) / static_cast<double>(INT64_C(1) << Frac));
+}
+
+/*
+ * Compile-time tables
+ */
+
+/**
+ * @brief Every fp8 code decoded to float, indexed by code.
+ */
+constexpr std::array<float, 256> float8_table() {
+    std::array<float, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i) {
+        table[i] = decode_float8(static_cast<float8_t>(i));
+    }
+    return table;
+}
+
+/*
+ * User-defined literals
+ */
+
+inline namespace literals {
+
+/// Half precision bit pattern, e.g. 1.5_h == 0x3E00.
+constexpr float16_t operator""_h(long double value) {
+    return encode_float16(static_cast<float>(value));
+}
+
+/// bfloat16 bit pattern, e.g. 0.25_bf == 0x3E80.
+constexpr bfloat16_t operator""_bf(long double value) {
+    return encode_bfloat16(static_cast<float>(value));
+}
+
+/// OCP E4M3FN bit pattern, e.g. 1.0_f8 == 0x38.
+constexpr float8_t operator""_f8(long double value) {
+    return encode_float8(static_cast<float>(value));
+}
+
+/// Q16.16 value, e.g. 3.0_q16 == INT_TO_FIXED(3).
+constexpr fixed16_t operator""_q16(long double value) {
+    return encode_fixed<FIXED_SIZE>(static_cast<double>(value));
+}
+
+} // namespace literals
+
+static_assert(0x3E00 == 1.5_h);
+static_assert(0x7BFF == 65504.0_h);
+static_assert(0x7C00 == 70000.0_h);
+static_assert(0xFC00 == encode_float16(-1e30f));
+static_assert(0x3E80 == 0.25_bf);
+static_assert(0x38 == 1.0_f8);
+static_assert(INT_TO_FIXED(3) == 3.0_q16);
+static_assert(448.0f == float8_table()[0x7E]);
+
+} // namespace fixed_point
+
+#endif // FLOATING_POINT_HPP
@@ -0,0 +1,90 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/gemm_bf16.h
+ *
+ * @brief Dot product, matrix-vector and matrix-matrix kernels on bfloat16 data.
+ *
+ * Operands stay in the bfloat16 encoding produced by encode_bfloat16() and
+ * are consumed a pair at a time, so no fp32 copy of either matrix is made
+ * and memory traffic is half that of fp32. All accumulation is fp32.
+ *
+ * With AVX-512 BF16 the inner loop is vdpbf16ps. Otherwise bfloat16 values
+ * are widened to fp32 in registers by a 16-bit shift, which is exactly what
+ * decode_bfloat16() does. vdpbf16ps flushes subnormal inputs and rounds each
+ * pair sum, so results may differ in the last bits between the two paths.
+ */
+
+#ifndef GEMM_BF16_H
+#define GEMM_BF16_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "floating_point.h"
+
+#include <stddef.h>
+
+/// Activation rows processed per micro-kernel tile.
+#define GEMM_BF16_MR 4
+
+/// Weight rows processed per micro-kernel tile.
+#define GEMM_BF16_NR 2
+
+/**
+ * @brief Dot product of two bfloat16 vectors.
+ *
+ * @param[in] a First vector of n elements.
+ * @param[in] b Second vector of n elements.
+ * @param[in] n Number of elements.
+ *
+ * @return sum(a[i] * b[i]) accumulated in fp32.
+ */
+float dot_bf16(const bfloat16_t* a, const bfloat16_t* b, size_t n);
+
+/**
+ * @brief y[rows] = W[rows x cols] * x[cols].
+ *
+ * @param[in]  w         Row-major weights.
+ * @param[in]  x         cols inputs.
+ * @param[out] y         rows outputs.
+ * @param[in]  rows      Weight rows.
+ * @param[in]  cols      Weight columns.
+ * @param[in]  n_threads Worker count; 0 uses every online processor.
+ */
+void gemv_bf16(
+    const bfloat16_t* w,
+    const bfloat16_t* x,
+    float*            y,
+    size_t            rows,
+    size_t            cols,
+    size_t            n_threads
+);
+
+/**
+ * @brief C[m x n] = A[m x k] * W[n x k]^T.
+ *
+ * @param[in]  a         Row-major activations, m rows of k values.
+ * @param[in]  w         Row-major weights, n rows of k values.
+ * @param[out] c         Row-major output, m rows of n floats.
+ * @param[in]  m         Activation rows (batch size).
+ * @param[in]  n         Weight rows (output channels).
+ * @param[in]  k         Shared inner dimension.
+ * @param[in]  n_threads Worker count; 0 uses every online processor.
+ */
+void gemm_bf16(
+    const bfloat16_t* a,
+    const bfloat16_t* w,
+    float*            c,
+    size_t            m,
+    size_t            n,
+    size_t            k,
+    size_t            n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // GEMM_BF16_H
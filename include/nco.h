@@ -0,0 +1,124 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/nco.h
+ *
+ * @brief Bank of table-driven numerically controlled oscillators.
+ *
+ * Each channel owns a 32-bit phase accumulator that wraps once per cycle.
+ * The top two phase bits select the quadrant. The next NCO_TABLE_BITS bits
+ * index a quarter-wave sine table in Q1.15 with NCO_TABLE_SIZE + 2 entries,
+ * about 2 KiB at the default size, so it stays in L1. The remaining bits are
+ * the fraction between table entries. It is either dropped, blended linearly
+ * with the next entry, or used for a first-order Taylor step along the
+ * cosine, which the same table provides at the mirrored index.
+ *
+ * Optional phase dithering adds a per-channel xorshift32 sequence below the
+ * table resolution. This turns the periodic truncation spurs into a noise
+ * floor.
+ *
+ * Channels are laid out in structure-of-arrays form. Eight of them advance
+ * together in the AVX2 lanes, and output samples are interleaved as
+ * dst[sample * n_channels + channel]. The SIMD and scalar paths match bit for
+ * bit, and generation uses integers only.
+ */
+
+#ifndef NCO_H
+#define NCO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// log2 of the quarter-wave table length.
+#define NCO_TABLE_BITS 10
+
+/// Quarter-wave table intervals; the table stores NCO_TABLE_SIZE + 1 points and one guard entry.
+#define NCO_TABLE_SIZE (1 << NCO_TABLE_BITS)
+
+/// Phase bits below the table index.
+#define NCO_FRAC_BITS  (30 - NCO_TABLE_BITS)
+
+typedef enum {
+    NCO_INTERP_NONE,   // Nearest lower table entry
+    NCO_INTERP_LINEAR, // Linear blend of neighbouring entries
+    NCO_INTERP_TAYLOR, // sin(x + d) ~ sin(x) + d * cos(x)
+} nco_interp_t;
+
+/**
+ * @brief Oscillator bank state.
+ *
+ * @param n_channels  Number of oscillators.
+ * @param phase       Per-channel phase; a full cycle is 2^32.
+ * @param increment   Per-channel phase step per sample.
+ * @param seed        Per-channel xorshift32 dither state, never zero.
+ * @param table       Quarter-wave sine in Q1.15.
+ * @param interp      Interpolation between table entries.
+ * @param dither_bits Width of the phase dither, 0 to disable.
+ */
+typedef struct {
+    size_t       n_channels;
+    uint32_t*    phase;
+    uint32_t*    increment;
+    uint32_t*    seed;
+    int16_t*     table;
+    nco_interp_t interp;
+    int          dither_bits;
+} nco_bank_t;
+
+/**
+ * @brief Creates a bank with every channel at phase 0 and increment 0.
+ *
+ * @param n_channels  Number of oscillators.
+ * @param interp      Interpolation mode.
+ * @param dither_bits Phase dither width in [0, 32]; NCO_FRAC_BITS dithers exactly one table step.
+ * @return The bank, or NULL on an allocation failure.
+ */
+nco_bank_t* malloc_nco_bank(size_t n_channels, nco_interp_t interp, int dither_bits);
+
+/**
+ * @brief Frees a bank returned by malloc_nco_bank().
+ */
+void free_nco_bank(nco_bank_t* bank);
+
+/**
+ * @brief Phase increment for an integer frequency, frequency * 2^32 / sample_rate.
+ */
+uint32_t nco_increment(uint32_t frequency, uint32_t sample_rate);
+
+/**
+ * @brief Phase increment for a real frequency; negative frequencies run backwards.
+ *
+ * Intended for offline setup.
+ */
+uint32_t nco_increment_from_float(double frequency, double sample_rate);
+
+/**
+ * @brief Sets the increment and phase of one channel.
+ */
+void nco_set(nco_bank_t* bank, size_t channel, uint32_t increment, uint32_t phase);
+
+/**
+ * @brief Writes n_samples of every channel as fixed16_t in [-1, 1] and advances the phases.
+ *
+ * @param[out] dst n_samples * n_channels samples, interleaved by channel.
+ */
+void nco_generate_fixed16(nco_bank_t* bank, fixed16_t* dst, size_t n_samples);
+
+/**
+ * @brief Writes n_samples of every channel as Q1.15 int16 and advances the phases.
+ *
+ * @param[out] dst n_samples * n_channels samples, interleaved by channel.
+ */
+void nco_generate_i16(nco_bank_t* bank, int16_t* dst, size_t n_samples);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // NCO_H
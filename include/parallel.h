@@ -0,0 +1,67 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/parallel.h
+ *
+ * @brief Minimal work-stealing parallel loop for the bulk kernels.
+ *
+ * The index space [0, n) is cut into tasks of `grain` indices and dealt out
+ * to the workers as contiguous ranges. A worker consumes its own range from
+ * the front; once it runs dry it steals the back half of the fullest range
+ * left. Which thread runs a task never affects what the task computes, so
+ * kernels that write disjoint outputs per index stay deterministic for any
+ * thread count.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Upper bound on worker threads spawned by a single parallel_for() call.
+#define PARALLEL_MAX_THREADS 256
+
+/**
+ * @brief Body of a parallel loop.
+ *
+ * @param ctx    Opaque pointer passed through from parallel_for().
+ * @param begin  First index of the range.
+ * @param end    One past the last index of the range.
+ * @param thread Index of the calling worker in [0, n_threads).
+ */
+typedef void (*parallel_fn_t)(void* ctx, size_t begin, size_t end, size_t thread);
+
+/**
+ * @brief True on a thread spawned by parallel_for() to run loop bodies.
+ */
+bool parallel_is_worker(void);
+
+/**
+ * @brief Number of online processors, or 1 if it cannot be determined.
+ */
+size_t parallel_thread_count(void);
+
+/**
+ * @brief Runs fn over [0, n) split into tasks of at most grain indices.
+ *
+ * The calling thread participates as worker 0. Returns once every index has
+ * been processed.
+ *
+ * @param[in] n         Number of indices.
+ * @param[in] grain     Indices per task; 0 selects n / (8 * n_threads).
+ * @param[in] n_threads Worker count; 0 selects parallel_thread_count().
+ * @param[in] fn        Loop body.
+ * @param[in] ctx       Opaque pointer passed to fn.
+ */
+void parallel_for(size_t n, size_t grain, size_t n_threads, parallel_fn_t fn, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // PARALLEL_H
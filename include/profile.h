@@ -0,0 +1,149 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/profile.h
+ *
+ * @brief Opt-in per-kernel instrumentation with hardware performance counters.
+ *
+ * Bulk kernels bracket their work with PROFILE_BEGIN() and PROFILE_END().
+ * When the library is built without FIXED_POINT_PROFILE (the default) both
+ * macros expand to nothing and their arguments are never evaluated. When it
+ * is enabled, every call adds to the kernel's call, element and byte counts
+ * and its wall time.
+ *
+ * Cycles, instructions and cache misses come from perf_event_open(). Each
+ * thread opens its counters on its first profiled call, with inheritance on,
+ * so threads spawned by parallel_for() fold their counts into the caller's.
+ * Hardware counts are therefore attributed to the outermost profiled kernel
+ * on the calling thread, including its workers; nested kernels and calls made
+ * on workers record everything except hardware counts. Where perf events are
+ * unavailable (e.g. perf_event_paranoid or containers) hardware counts stay
+ * zero and everything else still works.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PROFILE_QUANTIZE_ROW,
+    PROFILE_DEQUANTIZE_ROW,
+    PROFILE_QUANTIZE_TENSOR,
+    PROFILE_QUANTIZE_ACT,
+    PROFILE_GEMM_QUANT,
+    PROFILE_GEMM_BF16,
+    PROFILE_GEMV_LUT,
+    PROFILE_BLAS_HALF,
+    PROFILE_REDUCE,
+    PROFILE_COMPARE,
+    PROFILE_NORM,
+    PROFILE_CONV2D,
+    PROFILE_RESAMPLE,
+    PROFILE_NCO,
+    PROFILE_CIC,
+    PROFILE_QUANTIZE_AFFINE,
+    PROFILE_DEQUANTIZE_AFFINE,
+    PROFILE_REQUANTIZE,
+    PROFILE_MAX_KERNEL,
+} profile_kernel_t;
+
+/**
+ * @brief Totals accumulated for one kernel.
+ */
+typedef struct {
+    uint64_t calls;
+    uint64_t elements; // values converted or reduced; multiply-adds for dot, GEMV and GEMM
+    uint64_t bytes;    // operand bytes read plus bytes written
+    uint64_t nanoseconds;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cache_misses;
+} profile_counters_t;
+
+/**
+ * @brief Snapshot taken by profile_begin(); lives on the caller's stack.
+ */
+typedef struct {
+    uint64_t start_ns;
+    uint64_t hardware[3];
+    bool     owner; // outermost scope holding the thread's hardware counters
+} profile_sample_t;
+
+#if defined(FIXED_POINT_PROFILE)
+    #define PROFILE_BEGIN(sample) \
+        profile_sample_t sample;  \
+        profile_begin(&sample)
+    #define PROFILE_END(sample, kernel, elements, bytes) \
+        profile_end(&sample, kernel, elements, bytes)
+#else
+    #define PROFILE_BEGIN(sample)                        ((void) 0)
+    #define PROFILE_END(sample, kernel, elements, bytes) ((void) 0)
+#endif
+
+/**
+ * @brief True when the library was built with FIXED_POINT_PROFILE.
+ */
+bool profile_enabled(void);
+
+/**
+ * @brief Starts a sample on the calling thread.
+ */
+void profile_begin(profile_sample_t* sample);
+
+/**
+ * @brief Ends a sample and adds it to the kernel's totals.
+ *
+ * @param[in] elements Elements processed by the call.
+ * @param[in] bytes    Bytes read plus bytes written by the call.
+ */
+void profile_end(
+    profile_sample_t* sample, profile_kernel_t kernel, uint64_t elements, uint64_t bytes
+);
+
+/**
+ * @brief Short name of a kernel, e.g. "quantize_row".
+ */
+const char* profile_kernel_name(profile_kernel_t kernel);
+
+/**
+ * @brief Copies the totals of one kernel.
+ *
+ * @return false if profiling is compiled out or the kernel is out of range.
+ */
+bool profile_query(profile_kernel_t kernel, profile_counters_t* counters);
+
+/**
+ * @brief Clears every kernel's totals.
+ */
+void profile_reset(void);
+
+/**
+ * @brief Writes a table of every kernel with at least one call.
+ */
+void profile_dump(FILE* stream);
+
+/**
+ * @brief Starts a background thread calling profile_dump() every interval_ms.
+ *
+ * @return false if profiling is compiled out, a dump thread is already
+ *         running, or the thread could not be created.
+ */
+bool profile_dump_start(FILE* stream, uint32_t interval_ms);
+
+/**
+ * @brief Stops the dump thread, writing one final table.
+ */
+void profile_dump_stop(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // PROFILE_H
@@ -0,0 +1,61 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_act.h
+ *
+ * @brief Dynamic int8 quantization of activations with a fused absmax.
+ *
+ * Each QUANT_BLOCK_SIZE slice of a row is loaded once: its absmax, scale and
+ * int8 values are all derived from the same registers, so the activation is
+ * read from memory a single time on its way into quant_k8_t blocks. Rounding
+ * is to nearest even on every path, so the SIMD and portable kernels agree
+ * bit for bit.
+ *
+ * Scales are per block rather than per row (token): quant_k8_t carries one
+ * scale per QUANT_BLOCK_SIZE values, and the k8 dot products consume that
+ * layout directly. A block's scale is never coarser than its row's absmax
+ * scale would be, so per-block scaling is at least as accurate.
+ *
+ * NaN inputs are skipped by the absmax and quantize to 0. An infinite input
+ * makes the block's scale infinite and every value in it quantizes to 0.
+ * Both follow quantize_row() for TYPE_QUANT_K8.
+ */
+
+#ifndef QUANT_ACT_H
+#define QUANT_ACT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Quantizes rows x cols fp32 activations into k8 blocks.
+ *
+ * @param[in]  src       Row-major activations.
+ * @param[out] dst       rows * cols / QUANT_BLOCK_SIZE blocks, row after row.
+ * @param[in]  rows      Number of rows (tokens).
+ * @param[in]  cols      Row length, a multiple of QUANT_BLOCK_SIZE.
+ * @param[in]  n_threads Worker count; 1 runs inline on the caller, 0 uses every processor.
+ */
+void quantize_act_k8_f32(
+    const float* src, quant_k8_t* dst, size_t rows, size_t cols, size_t n_threads
+);
+
+/**
+ * @brief Quantizes rows x cols bfloat16 activations into k8 blocks.
+ *
+ * See quantize_act_k8_f32() for the parameters.
+ */
+void quantize_act_k8_bf16(
+    const bfloat16_t* src, quant_k8_t* dst, size_t rows, size_t cols, size_t n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_ACT_H
@@ -0,0 +1,132 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_affine.h
+ *
+ * @brief Asymmetric per-channel int8 quantization with integer-only requantization.
+ *
+ * A channel maps real values to int8 as real = scale * (q - zero_point).
+ * Multiplying two such tensors accumulates in int32; the accumulator returns
+ * to int8 through a per-channel Q31 multiplier and shift (see fixed_mul_shift()
+ * in fixed_point.h), so the inner loop never touches a float. Multipliers are
+ * derived once, offline, either from floats or integer-only from fixed16_t.
+ */
+
+#ifndef QUANT_AFFINE_H
+#define QUANT_AFFINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+#include "quantization.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Affine quantization parameters of a single channel.
+ *
+ * @param scale      Real value of one quantization step.
+ * @param zero_point Quantized value representing real 0, in [-128, 127].
+ */
+typedef struct {
+    float   scale;
+    int32_t zero_point;
+} quant_affine_t;
+
+/**
+ * @brief Fixed-point representation of a positive real multiplier.
+ *
+ * @param multiplier Q31 mantissa in [2^30, 2^31), or 0 for a zero multiplier.
+ * @param shift      Right shift applied after the multiply; negative shifts left.
+ */
+typedef struct {
+    int32_t multiplier;
+    int32_t shift;
+} quant_multiplier_t;
+
+/**
+ * @brief Chooses parameters covering [min, max], widened to include zero.
+ *
+ * Pairs with calib_stats_t: pass its per-channel min and max.
+ */
+quant_affine_t quant_affine_params(float min, float max);
+
+/**
+ * @brief Quantizes a rows x cols matrix with one parameter set per row.
+ *
+ * @param[in]  src    Row-major source values.
+ * @param[out] dst    Row-major int8 output.
+ * @param[in]  rows   Number of rows (output channels).
+ * @param[in]  cols   Number of columns.
+ * @param[in]  params rows parameter sets.
+ */
+void quantize_affine_rows(
+    const float* src, int8_t* dst, size_t rows, size_t cols, const quant_affine_t* params
+);
+
+/**
+ * @brief Inverse of quantize_affine_rows().
+ */
+void dequantize_affine_rows(
+    const int8_t* src, float* dst, size_t rows, size_t cols, const quant_affine_t* params
+);
+
+/**
+ * @brief Decomposes a positive real multiplier into a Q31 mantissa and shift.
+ *
+ * Intended for offline setup; the result is consumed by the integer kernels.
+ * Shifts stay within [-31, 31]: reals below 2^-32 give a zero multiplier and
+ * reals of 2^31 and above saturate to INT32_MAX with a shift of -31.
+ */
+quant_multiplier_t quant_multiplier_from_float(double real);
+
+/**
+ * @brief Integer-only decomposition of a positive fixed16_t multiplier.
+ *
+ * Normalizes with a leading-zero count so targets without an FPU can derive
+ * multipliers at runtime.
+ */
+quant_multiplier_t quant_multiplier_from_fixed16(fixed16_t real);
+
+/**
+ * @brief Requantizes a single int32 accumulator to int8.
+ *
+ * @return clamp(fixed_mul_shift(acc, m) + zero_point, -128, 127).
+ */
+int8_t requantize(int32_t acc, quant_multiplier_t m, int32_t zero_point);
+
+/**
+ * @brief Requantizes a rows x channels matrix of int32 accumulators to int8.
+ *
+ * Channels are contiguous, so each vector lane carries its own channel's
+ * multiplier and shift.
+ *
+ * @param[in]  acc        Row-major int32 accumulators.
+ * @param[out] dst        Row-major int8 output.
+ * @param[in]  rows       Number of rows.
+ * @param[in]  channels   Number of channels per row.
+ * @param[in]  bias       Optional per-channel int32 bias added with saturation before
+ *                        scaling; may be NULL.
+ * @param[in]  multiplier Per-channel Q31 multipliers.
+ * @param[in]  shift      Per-channel shifts in [-31, 31]; left shifts saturate.
+ * @param[in]  zero_point Output zero point.
+ */
+void requantize_rows(
+    const int32_t* acc,
+    int8_t*        dst,
+    size_t         rows,
+    size_t         channels,
+    const int32_t* bias,
+    const int32_t* multiplier,
+    const int32_t* shift,
+    int32_t        zero_point
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_AFFINE_H
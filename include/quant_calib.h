@@ -0,0 +1,145 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_calib.h
+ *
+ * @brief Streaming per-channel calibration statistics for scale selection.
+ *
+ * Activations arrive as row-major [rows x n_channels] buffers. For every
+ * channel the collector tracks min, max, the sum of squares, and a histogram
+ * of |x| over log-linear bins: CALIB_SUB_BINS equal bins per power of two,
+ * indexed straight from the float's exponent and top mantissa bits. The
+ * histogram doubles as a quantile sketch with bounded memory; a percentile
+ * is accurate to within half a bin (about 3% relative error).
+ *
+ * Min, max and the histogram merge exactly, so partial states built on
+ * separate threads combine into the same sketch in any order. The sum of
+ * squares is a double and therefore order sensitive; merge partials in a
+ * fixed order to keep it reproducible. calib_update_parallel() needs no
+ * partials at all, since its threads own disjoint channels.
+ */
+
+#ifndef QUANT_CALIB_H
+#define QUANT_CALIB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Histogram bins per power of two (log2 of this is taken from the mantissa).
+#define CALIB_SUB_BITS 4
+#define CALIB_SUB_BINS (1 << CALIB_SUB_BITS)
+
+/// Smallest binary exponent tracked; smaller magnitudes (and zero) land in bin 0.
+#define CALIB_EXP_MIN  -32
+
+/// Number of binary exponents covered; larger magnitudes land in the last bin.
+#define CALIB_EXP_SPAN 64
+
+/// Histogram bins per channel.
+#define CALIB_BINS     (CALIB_EXP_SPAN * CALIB_SUB_BINS)
+
+/**
+ * @brief Calibration state for n_channels channels.
+ *
+ * @param n_channels Number of channels (columns) per row.
+ * @param n_rows     Rows accumulated so far.
+ * @param min        Per-channel minimum.
+ * @param max        Per-channel maximum.
+ * @param sum_sq     Per-channel sum of squares.
+ * @param histogram  Per-channel |x| counts, CALIB_BINS per channel; 64-bit so
+ *                   long calibration runs cannot wrap a bin.
+ */
+typedef struct {
+    size_t    n_channels;
+    uint64_t  n_rows;
+    float*    min;
+    float*    max;
+    double*   sum_sq;
+    uint64_t* histogram;
+} calib_stats_t;
+
+/**
+ * @brief Allocates an empty collector for n_channels channels.
+ *
+ * @return The collector, or NULL on allocation failure.
+ */
+calib_stats_t* malloc_calib(size_t n_channels);
+
+/**
+ * @brief Frees a collector returned by malloc_calib().
+ */
+void free_calib(calib_stats_t* stats);
+
+/**
+ * @brief Returns a collector to its empty state.
+ */
+void calib_reset(calib_stats_t* stats);
+
+/**
+ * @brief Accumulates rows x n_channels values.
+ */
+void calib_update(calib_stats_t* stats, const float* x, size_t rows);
+
+/**
+ * @brief Accumulates rows x n_channels values across worker threads.
+ *
+ * Channels are split into n_threads ranges of whole vectors and each range
+ * is accumulated straight into stats, so no memory is allocated and the
+ * result is bit-identical to calib_update() for any thread count.
+ *
+ * @return true; kept for callers that checked the former allocating version.
+ */
+bool calib_update_parallel(calib_stats_t* stats, const float* x, size_t rows, size_t n_threads);
+
+/**
+ * @brief Folds src into dst. Both must track the same number of channels.
+ *
+ * @return false if the channel counts differ.
+ */
+bool calib_merge(calib_stats_t* dst, const calib_stats_t* src);
+
+/**
+ * @brief Largest magnitude observed on a channel.
+ */
+float calib_absmax(const calib_stats_t* stats, size_t channel);
+
+/**
+ * @brief Approximate percentile of |x| on a channel.
+ *
+ * @param[in] p Percentile in [0, 100]; 100 returns the exact absmax.
+ */
+float calib_percentile(const calib_stats_t* stats, size_t channel, float p);
+
+/**
+ * @brief Magnitude range [lower, upper) covered by a histogram bin.
+ */
+void calib_bin_bounds(size_t bin, float* lower, float* upper);
+
+/**
+ * @brief Per-channel clipping thresholds at percentile p of |x|.
+ *
+ * @param[out] clip n_channels thresholds; divide by the type's largest level
+ *                  (127 for k8, 8 for k4) to obtain a symmetric scale.
+ */
+void calib_clip(const calib_stats_t* stats, float p, float* clip);
+
+/**
+ * @brief Per-channel mean square activation.
+ *
+ * @param[out] importance n_channels weights, ready to pass as the importance
+ *                        argument of quantize_tensor() for the matching weights.
+ */
+void calib_importance(const calib_stats_t* stats, float* importance);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_CALIB_H
@@ -0,0 +1,78 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_fp4.h
+ *
+ * @brief 4-bit codebook block formats: E2M1 floating point and NormalFloat4.
+ *
+ * Both formats map each nibble through a fixed 16-entry codebook and scale
+ * the block by a half precision factor. FP4 uses the E2M1 values
+ * {0, 0.5, 1, 1.5, 2, 3, 4, 6} and their negatives; NF4 uses the quantiles
+ * of a standard normal distribution normalized to [-1, 1], as stored by
+ * QLoRA fine-tuning. Because the codebook fits in two AVX registers, decoding
+ * is an in-register table lookup rather than arithmetic.
+ *
+ * @ref https://arxiv.org/abs/2305.14314
+ */
+
+#ifndef QUANT_FP4_H
+#define QUANT_FP4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Number of entries in a 4-bit codebook.
+#define FP4_CODEBOOK_SIZE 16
+
+/**
+ * @brief 4-bit E2M1 block: value[i] = scale * e2m1(nibble[i]).
+ *
+ * Nibbles use the split layout of quant_k4_t: element i in the low half of
+ * quants[i], element i + QUANT_BLOCK_SIZE / 2 in the high half.
+ *
+ * @param scale  Block scale (absmax / 6) as IEEE-754 half precision.
+ * @param quants Two E2M1 codes per byte.
+ */
+typedef struct {
+    float16_t scale;
+    uint8_t   quants[QUANT_BLOCK_SIZE / 2];
+} quant_fp4_t;
+
+/**
+ * @brief 4-bit NormalFloat block: value[i] = scale * nf4(nibble[i]).
+ *
+ * @param scale  Block absmax as IEEE-754 half precision.
+ * @param quants Two NF4 codebook indices per byte, split layout.
+ */
+typedef struct {
+    float16_t scale;
+    uint8_t   quants[QUANT_BLOCK_SIZE / 2];
+} quant_nf4_t;
+
+/**
+ * @brief Encodes a value in [-1, 1] as the index of the nearest NF4 codebook entry.
+ */
+uint8_t encode_nf4(float value);
+
+/**
+ * @brief Decodes an NF4 codebook index stored in the low 4 bits.
+ */
+float decode_nf4(uint8_t bits);
+
+void quantize_row_fp4(const float* src, quant_fp4_t* dst, size_t n);
+void dequantize_row_fp4(const quant_fp4_t* src, float* dst, size_t n);
+
+void quantize_row_nf4(const float* src, quant_nf4_t* dst, size_t n);
+void dequantize_row_nf4(const quant_nf4_t* src, float* dst, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_FP4_H
@@ -0,0 +1,75 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_gemm.h
+ *
+ * @brief Weight-only quantized matrix multiplication.
+ *
+ * Computes C = A * W^T where A holds full precision activations and W holds
+ * one quantized row per output channel. Weight blocks are expanded inside the
+ * micro-kernel, straight into registers on AVX2 targets and into a single
+ * block-sized panel otherwise, so a full precision copy of W never exists.
+ */
+
+#ifndef QUANT_GEMM_H
+#define QUANT_GEMM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stddef.h>
+
+/// Activation rows processed per micro-kernel tile.
+#define GEMM_MR 4
+
+/// Weight rows processed per micro-kernel tile.
+#define GEMM_NR 2
+
+/**
+ * @brief C[m x n] = A[m x k] * W[n x k]^T with fp32 activations.
+ *
+ * @param[in]  wtype     Weight encoding: TYPE_QUANT_K8 or TYPE_QUANT_K4.
+ * @param[in]  w         n weight rows of quant_row_size(wtype, k) bytes each.
+ * @param[in]  a         Row-major activations, m rows of k floats.
+ * @param[out] c         Row-major output, m rows of n floats.
+ * @param[in]  m         Activation rows (batch size).
+ * @param[in]  n         Weight rows (output channels).
+ * @param[in]  k         Shared inner dimension, a multiple of QUANT_BLOCK_SIZE.
+ * @param[in]  n_threads Worker count; 0 uses every online processor.
+ */
+void gemm_quant_f32(
+    data_type_t  wtype,
+    const void*  w,
+    const float* a,
+    float*       c,
+    size_t       m,
+    size_t       n,
+    size_t       k,
+    size_t       n_threads
+);
+
+/**
+ * @brief C[m x n] = A[m x k] * W[n x k]^T with bfloat16 activations.
+ *
+ * Activations are widened to fp32 in registers; accumulation is fp32.
+ * See gemm_quant_f32() for the parameters.
+ */
+void gemm_quant_bf16(
+    data_type_t       wtype,
+    const void*       w,
+    const bfloat16_t* a,
+    float*            c,
+    size_t            m,
+    size_t            n,
+    size_t            k,
+    size_t            n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_GEMM_H
@@ -0,0 +1,98 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_lut.h
+ *
+ * @brief Table-lookup matrix-vector product for 2 and 4-bit weights.
+ *
+ * Instead of expanding weights and multiplying, each group of four
+ * activations is turned into a 16-entry table holding the sums of every
+ * subset of the group. A weight block is split into bit planes; four bits
+ * of one plane index that table directly, so sum(q[i] * x[i]) over a group
+ * becomes one lookup per plane. Tables are quantized to int8 per block so a
+ * byte shuffle (pshufb/vpshufb) performs 32 lookups at once, one per weight
+ * row in a row tile.
+ *
+ * Weights must be repacked once into the row-interleaved bit-plane layout
+ * of lut_matrix_t before use.
+ */
+
+#ifndef QUANT_LUT_H
+#define QUANT_LUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Weight rows sharing one vector of table lookups.
+#define LUT_TILE_ROWS  32
+
+/// Activations per lookup table (one index nibble).
+#define LUT_GROUP_SIZE 4
+
+/// Lookup tables per quantized block.
+#define LUT_GROUPS     (QUANT_BLOCK_SIZE / LUT_GROUP_SIZE)
+
+/**
+ * @brief Weights repacked for table-lookup GEMV.
+ *
+ * For each tile of LUT_TILE_ROWS rows, each block and each bit plane, the
+ * layout stores LUT_GROUPS / 2 runs of LUT_TILE_ROWS bytes. Byte r of run p
+ * holds row r's plane nibble for group 2p in its low half and for group
+ * 2p + 1 in its high half.
+ *
+ * @param type    Source encoding: TYPE_QUANT_K4 or TYPE_QUANT_K2.
+ * @param rows    Number of weight rows.
+ * @param cols    Number of columns, a multiple of QUANT_BLOCK_SIZE.
+ * @param bits    Bits per weight (bit planes).
+ * @param offset  Value subtracted from every unsigned level (8 for k4, 2 for k2).
+ * @param indices Packed plane nibbles.
+ * @param scales  Row scales as floats, [tile][block][LUT_TILE_ROWS].
+ */
+typedef struct {
+    data_type_t type;
+    size_t      rows;
+    size_t      cols;
+    size_t      bits;
+    int32_t     offset;
+    uint8_t*    indices;
+    float*      scales;
+} lut_matrix_t;
+
+/**
+ * @brief Repacks rows x cols quantized weights into the lookup layout.
+ *
+ * @param[in] type Weight encoding: TYPE_QUANT_K4 or TYPE_QUANT_K2.
+ * @param[in] w    rows rows of quant_row_size(type, cols) bytes each.
+ *
+ * @return The repacked matrix, or NULL on allocation failure or unsupported type.
+ */
+lut_matrix_t* malloc_lut_matrix(data_type_t type, const void* w, size_t rows, size_t cols);
+
+/**
+ * @brief Frees a matrix returned by malloc_lut_matrix().
+ */
+void free_lut_matrix(lut_matrix_t* matrix);
+
+/**
+ * @brief y[rows] = W[rows x cols] * x[cols] using table lookups.
+ *
+ * @param[in]  w         Repacked weights.
+ * @param[in]  x         cols activations.
+ * @param[out] y         rows outputs.
+ * @param[in]  n_threads Worker count; 1 runs inline on the caller, 0 uses every processor.
+ *
+ * @return false if the activation tables could not be allocated.
+ */
+bool gemv_lut(const lut_matrix_t* w, const float* x, float* y, size_t n_threads);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_LUT_H
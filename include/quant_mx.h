@@ -0,0 +1,121 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_mx.h
+ *
+ * @brief OCP Microscaling (MX) block formats.
+ *
+ * Every MX block holds MX_BLOCK_SIZE elements sharing one E8M0 scale, an
+ * unsigned biased exponent: scale = 2^(e - 127), with 0xFF reserved for NaN.
+ * Elements are encoded as:
+ *
+ * - TYPE_MX_FP8:  E4M3, identical to encode_float8(), max 448
+ * - TYPE_MX_FP6:  E2M3, bias 1, max 7.5, four elements per three bytes
+ * - TYPE_MX_FP4:  E2M1, bias 1, max 6, two elements per byte (low nibble first)
+ * - TYPE_MX_INT8: two's complement with 6 fractional bits, max 127 / 64
+ *
+ * Sub-byte elements are packed in element order, least significant bits
+ * first, as in the OCP Microscaling Formats (MX) v1.0 specification.
+ *
+ * @ref https://www.opencompute.org/documents/ocp-microscaling-formats-mx-v1-0-spec-final-pdf
+ */
+
+#ifndef QUANT_MX_H
+#define QUANT_MX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Elements sharing one E8M0 scale.
+#define MX_BLOCK_SIZE 32
+
+/// E8M0 encoding of NaN.
+#define MX_SCALE_NAN  0xFF
+
+typedef struct {
+    uint8_t scale;
+    uint8_t elems[MX_BLOCK_SIZE];
+} mx_fp8_t;
+
+typedef struct {
+    uint8_t scale;
+    uint8_t elems[MX_BLOCK_SIZE * 6 / 8];
+} mx_fp6_t;
+
+typedef struct {
+    uint8_t scale;
+    uint8_t elems[MX_BLOCK_SIZE / 2];
+} mx_fp4_t;
+
+typedef struct {
+    uint8_t scale;
+    int8_t  elems[MX_BLOCK_SIZE];
+} mx_int8_t;
+
+/**
+ * @brief Decodes an E8M0 shared scale.
+ *
+ * @return 2^(bits - 127), or NaN for MX_SCALE_NAN.
+ */
+float decode_e8m0(uint8_t bits);
+
+/**
+ * @brief Encodes a float as E2M3 (MXFP6 element), saturating at ±7.5.
+ */
+uint8_t encode_fp6_e2m3(float value);
+
+/**
+ * @brief Decodes an E2M3 (MXFP6 element) stored in the low 6 bits.
+ */
+float decode_fp6_e2m3(uint8_t bits);
+
+/**
+ * @brief Encodes a float as E2M1 (MXFP4 element), saturating at ±6.
+ */
+uint8_t encode_fp4_e2m1(float value);
+
+/**
+ * @brief Decodes an E2M1 (MXFP4 element) stored in the low 4 bits.
+ */
+float decode_fp4_e2m1(uint8_t bits);
+
+/**
+ * @brief Quantizes n floats into MX blocks of the given type.
+ *
+ * The shared exponent is floor(log2(absmax)) minus the element format's
+ * largest exponent; elements are rounded to nearest even and saturate.
+ *
+ * @param[in]  type TYPE_MX_FP8, TYPE_MX_FP6, TYPE_MX_FP4 or TYPE_MX_INT8.
+ * @param[in]  n    Number of elements, a multiple of MX_BLOCK_SIZE.
+ */
+void quantize_row_mx(data_type_t type, const float* src, void* dst, size_t n);
+
+/**
+ * @brief Expands n elements of MX blocks back into floats.
+ */
+void dequantize_row_mx(data_type_t type, const void* src, float* dst, size_t n);
+
+/**
+ * @brief Dot product of two MX rows of the same type.
+ *
+ * Follows the MX definition: per block, 2^(scale_a + scale_b) times the sum
+ * of element products. INT8, FP6 and FP4 elements are exact small integers
+ * after a fixed scaling, so their block sums are computed in integer SIMD.
+ * quantize_row_mx() writes INT8 codes in [-127, 127], but any int8 code,
+ * -128 included, is summed exactly.
+ *
+ * @param[in] n Number of elements, a multiple of MX_BLOCK_SIZE.
+ */
+float dot_mx(data_type_t type, const void* a, const void* b, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_MX_H
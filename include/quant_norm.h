@@ -0,0 +1,150 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_norm.h
+ *
+ * @brief Integer-only RMSNorm and LayerNorm over fixed16_t and k8 activation rows.
+ *
+ * Each row is normalized in three vectorized passes, all in integers:
+ *
+ * 1. Sum and absmax, accumulated in int64.
+ * 2. Sum of squared deviations from the mean, also in int64. When the absmax
+ *    is large enough to overflow, values are shifted right first.
+ * 3. Scale by 1 / sqrt(variance + eps), then apply gamma and beta.
+ *
+ * The reciprocal square root comes from fixed_rsqrt() applied to the variance
+ * normalized into [1, 4), followed by a power-of-two shift. The normalized
+ * value carries 20 fractional bits before gamma is applied, so rows of up to
+ * 2^20 columns cannot overflow.
+ *
+ * k8 inputs are decoded into a shared integer scale by aligning the block
+ * scales' mantissas to the largest exponent in the row. That common scale
+ * cancels in the normalization. k8 outputs are requantized block by block
+ * with an integer absmax, reciprocal and float16 scale encoding, so no path
+ * touches a float. The AVX2 and scalar paths give identical results.
+ */
+
+#ifndef QUANT_NORM_H
+#define QUANT_NORM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+#include "quantization.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Fractional bits of the normalized value before gamma is applied.
+#define NORM_Q       20
+
+/// Longest supported row; normalized values are bounded by sqrt(cols).
+#define NORM_MAX_COLS (1 << 20)
+
+/**
+ * @brief y = x / sqrt(mean(x^2) + eps) * gamma, row by row.
+ *
+ * @param[in]  src       Row-major fixed16_t activations.
+ * @param[out] dst       Row-major fixed16_t output; may alias src.
+ * @param[in]  rows      Number of rows (tokens).
+ * @param[in]  cols      Row length, at most NORM_MAX_COLS.
+ * @param[in]  gamma     cols per-column gains, or NULL for 1.
+ * @param[in]  eps       Variance floor.
+ * @param[in]  n_threads Worker count; 1 runs inline on the caller, 0 uses every processor.
+ */
+void rms_norm_fixed16(
+    const fixed16_t* src,
+    fixed16_t*       dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    fixed16_t        eps,
+    size_t           n_threads
+);
+
+/**
+ * @brief rms_norm_fixed16() with the output quantized into k8 blocks.
+ *
+ * @param[out] dst rows * cols / QUANT_BLOCK_SIZE blocks; cols must be a multiple of
+ *                 QUANT_BLOCK_SIZE.
+ */
+void rms_norm_fixed16_k8(
+    const fixed16_t* src,
+    quant_k8_t*      dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    fixed16_t        eps,
+    size_t           n_threads
+);
+
+/**
+ * @brief RMSNorm from k8 blocks to k8 blocks.
+ *
+ * @return false if the per-thread decode buffers cannot be allocated.
+ */
+bool rms_norm_k8(
+    const quant_k8_t* src,
+    quant_k8_t*       dst,
+    size_t            rows,
+    size_t            cols,
+    const fixed16_t*  gamma,
+    fixed16_t         eps,
+    size_t            n_threads
+);
+
+/**
+ * @brief y = (x - mean(x)) / sqrt(var(x) + eps) * gamma + beta, row by row.
+ *
+ * See rms_norm_fixed16() for the parameters.
+ *
+ * @param[in] beta cols per-column offsets, or NULL for 0.
+ */
+void layer_norm_fixed16(
+    const fixed16_t* src,
+    fixed16_t*       dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    const fixed16_t* beta,
+    fixed16_t        eps,
+    size_t           n_threads
+);
+
+/**
+ * @brief layer_norm_fixed16() with the output quantized into k8 blocks.
+ */
+void layer_norm_fixed16_k8(
+    const fixed16_t* src,
+    quant_k8_t*      dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    const fixed16_t* beta,
+    fixed16_t        eps,
+    size_t           n_threads
+);
+
+/**
+ * @brief LayerNorm from k8 blocks to k8 blocks.
+ *
+ * @return false if the per-thread decode buffers cannot be allocated.
+ */
+bool layer_norm_k8(
+    const quant_k8_t* src,
+    quant_k8_t*       dst,
+    size_t            rows,
+    size_t            cols,
+    const fixed16_t*  gamma,
+    const fixed16_t*  beta,
+    fixed16_t         eps,
+    size_t            n_threads
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_NORM_H
@@ -0,0 +1,135 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quant_stream.h
+ *
+ * @brief Bounded-memory streaming quantization of arbitrarily large float files.
+ *
+ * The pipeline runs three threads (reader, quantizer, writer) over a small ring
+ * of fixed-size chunks. Reading the next chunk, quantizing the current chunk and
+ * writing the previous chunk overlap, and peak memory is n_chunks times the
+ * source plus destination chunk size regardless of the input length.
+ *
+ * The output container is a quant_file_header_t followed by the encoded blocks
+ * in source order. A trailing partial block is zero padded; n_elements records
+ * the unpadded length.
+ */
+
+#ifndef QUANT_STREAM_H
+#define QUANT_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "quantization.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Container magic, the bytes "FXPQ" read as a little-endian 32-bit integer.
+#define QUANT_FILE_MAGIC   0x51505846
+
+/// Container layout version.
+#define QUANT_FILE_VERSION 1
+
+/// Default number of elements per chunk (4 MiB of fp32 input).
+#define QUANT_STREAM_CHUNK (1 << 20)
+
+/// Default number of chunks in flight; one per pipeline stage.
+#define QUANT_STREAM_DEPTH 3
+
+/**
+ * @brief Header written at the start of every quantized container.
+ *
+ * @param magic      QUANT_FILE_MAGIC.
+ * @param version    QUANT_FILE_VERSION.
+ * @param type       data_type_t of the payload.
+ * @param block_size Elements per encoded block.
+ * @param n_elements Number of source elements, excluding block padding.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;
+    uint32_t block_size;
+    uint64_t n_elements;
+} quant_file_header_t;
+
+/**
+ * @brief Streaming pipeline configuration.
+ *
+ * @param src_type   Raw input encoding: TYPE_FLOAT_F32, TYPE_FLOAT_F16 or TYPE_FLOAT_BF16.
+ * @param dst_type   Output encoding; any type accepted by quantize_row().
+ * @param chunk_size Elements per chunk, rounded up to a whole number of blocks.
+ * @param n_chunks   Chunks in flight across the pipeline (at least 2).
+ */
+typedef struct {
+    data_type_t src_type;
+    data_type_t dst_type;
+    size_t      chunk_size;
+    size_t      n_chunks;
+} quant_stream_params_t;
+
+/**
+ * @brief Counters reported by a completed stream.
+ *
+ * @param n_elements    Source elements consumed.
+ * @param bytes_read    Bytes read from the source.
+ * @param bytes_written Bytes written to the destination, including the header.
+ */
+typedef struct {
+    uint64_t n_elements;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+} quant_stream_stats_t;
+
+/**
+ * @brief Returns the default parameters for converting src_type into dst_type.
+ */
+quant_stream_params_t quant_stream_default_params(data_type_t src_type, data_type_t dst_type);
+
+/**
+ * @brief Quantizes everything readable from src_fd into a container on dst_fd.
+ *
+ * If src_fd is a regular file the element count is known up front; otherwise the
+ * header is rewritten once the stream ends, which requires dst_fd to be seekable.
+ *
+ * @param[in]  src_fd Readable file descriptor holding raw src_type values.
+ * @param[in]  dst_fd Writable file descriptor positioned at the container start.
+ * @param[in]  params Pipeline configuration.
+ * @param[out] stats  Optional counters; may be NULL.
+ *
+ * @return true on success, false on an I/O or allocation failure or on invalid
+ *         parameters (errno set to EINVAL).
+ */
+bool quant_stream_fd(
+    int                          src_fd,
+    int                          dst_fd,
+    const quant_stream_params_t* params,
+    quant_stream_stats_t*        stats
+);
+
+/**
+ * @brief Path-based convenience wrapper around quant_stream_fd().
+ */
+bool quant_stream_file(
+    const char*                  src_path,
+    const char*                  dst_path,
+    const quant_stream_params_t* params,
+    quant_stream_stats_t*        stats
+);
+
+/**
+ * @brief Reads and validates a container header from fd.
+ *
+ * @return true if a complete header with a known magic and version was read.
+ */
+bool quant_file_read_header(int fd, quant_file_header_t* header);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // QUANT_STREAM_H
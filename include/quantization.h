@@ -1,3 +1,16 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/quantization.h
+ *
+ * @brief Block quantization formats and bulk conversion routines.
+ *
+ * Quantized data is stored in fixed-size blocks of QUANT_BLOCK_SIZE elements
+ * that share a single half precision scale (delta). Rows must hold a whole
+ * number of blocks; the generic row API also accepts the plain floating-point
+ * types so a single call site can emit any member of data_type_t.
+ */
+
 #ifndef QUANT_H
 #define QUANT_H
 
@@ -7,8 +20,52 @@ extern "C" {
 
 #include "floating_point.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+/// Number of elements sharing a single scale within a quantized block.
+#define QUANT_BLOCK_SIZE 32
+
+/**
+ * @brief 8-bit symmetric block: value[i] = scale * quants[i].
+ *
+ * @param scale  Block delta encoded as IEEE-754 half precision.
+ * @param quants Signed 8-bit quantized values in [-127, 127].
+ */
+typedef struct {
+    float16_t scale;
+    int8_t    quants[QUANT_BLOCK_SIZE];
+} quant_k8_t;
+
+/**
+ * @brief 4-bit symmetric block: value[i] = scale * (nibble[i] - 8).
+ *
+ * Element i (i < QUANT_BLOCK_SIZE / 2) lives in the low nibble of quants[i]
+ * and element i + QUANT_BLOCK_SIZE / 2 lives in the high nibble, so both
+ * halves unpack with a single mask or shift across the whole byte array.
+ *
+ * @param scale  Block delta encoded as IEEE-754 half precision.
+ * @param quants Two unsigned 4-bit values per byte, offset by 8.
+ */
+typedef struct {
+    float16_t scale;
+    uint8_t   quants[QUANT_BLOCK_SIZE / 2];
+} quant_k4_t;
+
+/**
+ * @brief 2-bit symmetric block: value[i] = scale * (crumb[i] - 2).
+ *
+ * Byte j holds elements j, j + 8, j + 16 and j + 24 in bits 0-1, 2-3, 4-5
+ * and 6-7 respectively, mirroring the split layout of quant_k4_t.
+ *
+ * @param scale  Block delta encoded as IEEE-754 half precision.
+ * @param quants Four unsigned 2-bit values per byte, offset by 2.
+ */
+typedef struct {
+    float16_t scale;
+    uint8_t   quants[QUANT_BLOCK_SIZE / 4];
+} quant_k2_t;
+
 // Quantization structure
 typedef struct {
     float_flex_t delta;  // Change in precision
@@ -23,6 +80,142 @@ float    decode_quant(const quant_t* quant);
 quant_t* malloc_quant(float_flex_t delta, size_t size, data_type_t dtype, uint8_t* quants);
 void     free_quant(quant_t* quant);
 
+/**
+ * @brief Number of elements stored in a single block of the given type.
+ *
+ * @return QUANT_BLOCK_SIZE for quantized types, 1 for floating-point types.
+ */
+size_t quant_block_size(data_type_t type);
+
+/**
+ * @brief Number of bytes occupied by a single block of the given type.
+ */
+size_t quant_type_size(data_type_t type);
+
+/**
+ * @brief Number of bytes required to store n elements of the given type.
+ *
+ * @note n must be a multiple of quant_block_size(type).
+ */
+size_t quant_row_size(data_type_t type, size_t n);
+
+/**
+ * @brief Short lowercase name of a data type (e.g. "f16", "k8").
+ *
+ * @return The name, or NULL for an unknown type.
+ */
+const char* quant_type_name(data_type_t type);
+
+/**
+ * @brief Parses a name produced by quant_type_name().
+ *
+ * @return The matching type, or TYPE_MAX_COUNT if the name is unknown.
+ */
+data_type_t quant_type_from_name(const char* name);
+
+/**
+ * @brief Quantizes n floats into n / QUANT_BLOCK_SIZE 8-bit blocks.
+ *
+ * @param[in]  src Source values.
+ * @param[out] dst Destination blocks.
+ * @param[in]  n   Number of elements, a multiple of QUANT_BLOCK_SIZE.
+ */
+void quantize_row_k8(const float* src, quant_k8_t* dst, size_t n);
+
+/**
+ * @brief Expands n / QUANT_BLOCK_SIZE 8-bit blocks back into n floats.
+ */
+void dequantize_row_k8(const quant_k8_t* src, float* dst, size_t n);
+
+/**
+ * @brief Quantizes n floats into n / QUANT_BLOCK_SIZE 4-bit blocks.
+ */
+void quantize_row_k4(const float* src, quant_k4_t* dst, size_t n);
+
+/**
+ * @brief Expands n / QUANT_BLOCK_SIZE 4-bit blocks back into n floats.
+ */
+void dequantize_row_k4(const quant_k4_t* src, float* dst, size_t n);
+
+/**
+ * @brief Quantizes n floats into n / QUANT_BLOCK_SIZE 2-bit blocks.
+ */
+void quantize_row_k2(const float* src, quant_k2_t* dst, size_t n);
+
+/**
+ * @brief Expands n / QUANT_BLOCK_SIZE 2-bit blocks back into n floats.
+ */
+void dequantize_row_k2(const quant_k2_t* src, float* dst, size_t n);
+
+/**
+ * @brief Importance-weighted 8-bit quantization.
+ *
+ * Searches a small set of candidate scales per block and keeps the one that
+ * minimizes sum(importance[i] * (src[i] - scale * q[i])^2), refitting the
+ * scale by weighted least squares. Slower than quantize_row_k8() but more
+ * accurate where a few columns dominate the output error.
+ *
+ * @param[in]  src        Source values.
+ * @param[out] dst        Destination blocks.
+ * @param[in]  n          Number of elements, a multiple of QUANT_BLOCK_SIZE.
+ * @param[in]  importance Non-negative weight per element; NULL weights all equally.
+ */
+void quantize_row_k8_weighted(
+    const float* src, quant_k8_t* dst, size_t n, const float* importance
+);
+
+/**
+ * @brief Importance-weighted 4-bit quantization; see quantize_row_k8_weighted().
+ */
+void quantize_row_k4_weighted(
+    const float* src, quant_k4_t* dst, size_t n, const float* importance
+);
+
+/**
+ * @brief Encodes n floats as the given type.
+ *
+ * @param[in]  type Target type; any member of data_type_t.
+ * @param[in]  src  Source values.
+ * @param[out] dst  Destination buffer of at least quant_row_size(type, n) bytes.
+ * @param[in]  n    Number of elements, a multiple of quant_block_size(type).
+ *
+ * @return The number of bytes written to dst, or 0 for an unsupported type.
+ */
+size_t quantize_row(data_type_t type, const float* src, void* dst, size_t n);
+
+/**
+ * @brief Decodes n elements of the given type back into floats.
+ *
+ * @return The number of bytes consumed from src.
+ */
+size_t dequantize_row(data_type_t type, const void* src, float* dst, size_t n);
+
+/**
+ * @brief Quantizes a rows x cols matrix row by row across multiple threads.
+ *
+ * Row ranges are scheduled with work stealing (see parallel.h) and each row
+ * is written to its own slot of quant_row_size(type, cols) bytes, so the
+ * output is bit-identical for every thread count.
+ *
+ * @param[in]  type       Target type accepted by quantize_row().
+ * @param[in]  src        Row-major source matrix.
+ * @param[out] dst        Preallocated output of rows * quant_row_size(type, cols) bytes.
+ * @param[in]  rows       Number of rows.
+ * @param[in]  cols       Number of columns, a multiple of quant_block_size(type).
+ * @param[in]  importance Optional per-column weights enabling the weighted scale
+ *                        search for quantized types; NULL for plain absmax scales.
+ * @param[in]  n_threads  Worker count; 0 uses every online processor.
+ */
+void quantize_tensor(
+    data_type_t  type,
+    const float* src,
+    void*        dst,
+    size_t       rows,
+    size_t       cols,
+    const float* importance,
+    size_t       n_threads
+);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
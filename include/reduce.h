@@ -0,0 +1,68 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/reduce.h
+ *
+ * @brief Compensated reductions over fp32, fp16, bf16 and fp8 arrays.
+ *
+ * Inputs are widened to fp32 in registers and summed in short blocks of
+ * REDUCE_BLOCK elements per lane; block sums are then folded together with
+ * Kahan-Neumaier compensation. The array is split into fixed chunks of
+ * REDUCE_CHUNK elements whose partial sums are combined in index order, so
+ * results do not depend on the thread count or on scheduling.
+ *
+ * @param type Element encoding: TYPE_FLOAT_F32, TYPE_FLOAT_F16,
+ *             TYPE_FLOAT_BF16 or TYPE_FLOAT_F8.
+ * @param n_threads Worker count; 0 uses every online processor.
+ */
+
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "floating_point.h"
+
+#include <stddef.h>
+
+/// Elements per block summed without compensation.
+#define REDUCE_BLOCK 128
+
+/// Elements per independently scheduled chunk.
+#define REDUCE_CHUNK (1 << 14)
+
+/**
+ * @brief Sum of n elements.
+ */
+float reduce_sum(data_type_t type, const void* x, size_t n, size_t n_threads);
+
+/**
+ * @brief Arithmetic mean of n elements, or 0 for an empty array.
+ */
+float reduce_mean(data_type_t type, const void* x, size_t n, size_t n_threads);
+
+/**
+ * @brief Dot product of two arrays of the same encoding.
+ */
+float reduce_dot(data_type_t type, const void* a, const void* b, size_t n, size_t n_threads);
+
+/**
+ * @brief Euclidean norm sqrt(sum(x[i]^2)).
+ */
+float reduce_norm2(data_type_t type, const void* x, size_t n, size_t n_threads);
+
+/**
+ * @brief Population variance sum((x[i] - mean)^2) / n.
+ *
+ * Computed in two passes (mean, then squared deviations) to avoid the
+ * cancellation of the sum-of-squares formula.
+ */
+float reduce_variance(data_type_t type, const void* x, size_t n, size_t n_threads);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // REDUCE_H
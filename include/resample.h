@@ -0,0 +1,157 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file include/resample.h
+ *
+ * @brief Integer-only polyphase sample-rate conversion of fixed16_t streams.
+ *
+ * A Kaiser-windowed sinc prototype is sampled at RESAMPLE_PHASES fractional
+ * offsets and stored as a bank of Q1.15 subfilters when the resampler is
+ * created. Each output sample sits at a position in the input stream whose
+ * fractional part is a fixed16_t. The top bits of that fraction select two
+ * neighbouring subfilters and the low bits blend their outputs linearly. The
+ * position advances by in_rate / out_rate per output. A remainder term keeps
+ * the step exact, so streams never drift however long they run.
+ *
+ * Inner products accumulate in 64 bits, so the AVX2 and scalar paths give
+ * identical results. Any pair of positive integer rates is supported.
+ * Downsampling lowers the cutoff and lengthens the filter by the same ratio,
+ * up to RESAMPLE_MAX_TAPS.
+ *
+ * The stream state lives in the resampler, so input can arrive in blocks of
+ * any size:
+ *
+ *     resampler_t* r   = malloc_resampler(44100, 48000);
+ *     fixed16_t*   out = malloc(resampler_max_output(r, block) * sizeof(fixed16_t));
+ *     while (... next block ...) {
+ *         size_t n = resampler_process(r, in, block, out);
+ *         ...
+ *     }
+ *     size_t n = resampler_flush(r, out);
+ *     free_resampler(r);
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "fixed_point.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Number of subfilters in the bank; the fraction's top log2(RESAMPLE_PHASES) bits select one.
+#define RESAMPLE_PHASES   256
+
+/// Subfilter length when upsampling; a multiple of 8.
+#define RESAMPLE_TAPS     64
+
+/// Longest subfilter used for large downsampling ratios.
+#define RESAMPLE_MAX_TAPS 1024
+
+/// Cutoff as a fraction of the lower Nyquist frequency.
+#define RESAMPLE_CUTOFF   0.92
+
+/// Kaiser window shape; 8 gives about 80 dB of stopband attenuation.
+#define RESAMPLE_BETA     8.0
+
+/// Fractional bits of the coefficient bank.
+#define RESAMPLE_COEFF_Q  15
+
+/**
+ * @brief Streaming resampler state.
+ *
+ * @param in_rate   Input rate, reduced by the common divisor with out_rate.
+ * @param out_rate  Output rate, reduced likewise.
+ * @param taps      Subfilter length.
+ * @param bank      RESAMPLE_PHASES + 1 subfilters of taps Q1.15 coefficients.
+ * @param step      Integer part of in_rate / out_rate.
+ * @param step_frac Fractional part of the step as a fixed16_t.
+ * @param step_rem  Remainder of the fixed16_t step, in units of 2^-16 / out_rate.
+ * @param history   Buffered input; the filter window starts at history[index].
+ * @param capacity  Size of history in samples.
+ * @param filled    Samples held in history.
+ * @param index     Integer part of the next output position.
+ * @param frac      Fractional part of the next output position.
+ * @param rem       Accumulated remainder, below out_rate.
+ * @param n_in      Samples consumed since the last reset.
+ * @param n_out     Samples produced since the last reset.
+ */
+typedef struct {
+    uint32_t   in_rate;
+    uint32_t   out_rate;
+    size_t     taps;
+    int16_t*   bank;
+    size_t     step;
+    fixed16_t  step_frac;
+    uint32_t   step_rem;
+    fixed16_t* history;
+    size_t     capacity;
+    size_t     filled;
+    size_t     index;
+    fixed16_t  frac;
+    uint32_t   rem;
+    uint64_t   n_in;
+    uint64_t   n_out;
+} resampler_t;
+
+/**
+ * @brief Creates a resampler and computes its coefficient bank.
+ *
+ * @param in_rate  Input sample rate, positive.
+ * @param out_rate Output sample rate, positive.
+ * @return The resampler, or NULL for a zero rate or an allocation failure.
+ */
+resampler_t* malloc_resampler(uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * @brief Frees a resampler returned by malloc_resampler().
+ */
+void free_resampler(resampler_t* resampler);
+
+/**
+ * @brief Clears the stream state; the next sample is treated as the first.
+ */
+void resampler_reset(resampler_t* resampler);
+
+/**
+ * @brief Upper bound on the samples one resampler_process() call writes for n inputs.
+ *
+ * Also bounds resampler_flush() with n = taps.
+ */
+size_t resampler_max_output(const resampler_t* resampler, size_t n);
+
+/**
+ * @brief Consumes n input samples and writes every output that they complete.
+ *
+ * Output sample k is the input signal evaluated at time k * in_rate / out_rate.
+ * An output is written once taps / 2 input samples past its position have
+ * arrived, so the first outputs come out with that delay.
+ *
+ * @param[in,out] resampler Stream state.
+ * @param[in]     src       Input samples.
+ * @param[in]     n         Number of input samples.
+ * @param[out]    dst       Room for resampler_max_output(resampler, n) samples.
+ * @return Samples written to dst.
+ */
+size_t resampler_process(resampler_t* resampler, const fixed16_t* src, size_t n, fixed16_t* dst);
+
+/**
+ * @brief Ends the stream by writing the outputs still held back by the filter delay.
+ *
+ * After the flush, ceil(n_in * out_rate / in_rate) samples have been written
+ * in total. The resampler is then reset for a new stream.
+ *
+ * @param[out] dst Room for resampler_max_output(resampler, taps) samples.
+ * @return Samples written to dst.
+ */
+size_t resampler_flush(resampler_t* resampler, fixed16_t* dst);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // RESAMPLE_H
@@ -0,0 +1,513 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file python/fixed_point_module.c
+ *
+ * @brief CPython bindings for the bulk conversion, quantization and
+ *        fixed-point kernels.
+ *
+ * Arguments are any C-contiguous object supporting the buffer protocol, such as
+ * NumPy arrays, array.array or bytearray. The kernels read and write those
+ * buffers in place with no copies, and the GIL is released while they run.
+ * Every output is preallocated by the caller, e.g.
+ *
+ *     dst = numpy.empty(fixed_point.row_size("k4", x.size), numpy.uint8)
+ *     fixed_point.quantize("k4", x, dst)
+ *
+ * Types are named as in quant_type_name(): "f32", "f16", "bf16", "f8", "k8", ...
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "fixed_point.h"
+#include "quant_affine.h"
+#include "quantization.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Argument helpers
+ */
+
+// Acquires a C-contiguous view; the exporter cannot resize it until released
+static bool buffer_acquire(PyObject* obj, Py_buffer* view, bool writable) {
+    const int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+    return 0 == PyObject_GetBuffer(obj, view, flags);
+}
+
+// Checks a struct-module format of one native-sized item, e.g. "f" or "<f"
+static bool buffer_check_format(
+    const Py_buffer* view, char code, Py_ssize_t itemsize, const char* name
+) {
+    const char* format = view->format ? view->format : "B";
+    if ('@' == *format || '=' == *format || (PY_LITTLE_ENDIAN && '<' == *format)) {
+        format++;
+    }
+
+    if (format[0] != code || format[1] != '\0' || view->itemsize != itemsize) {
+        PyErr_Format(
+            PyExc_TypeError, "%s: expected items of format '%c', got '%s'", name, code, view->format
+        );
+        return false;
+    }
+    return true;
+}
+
+static bool buffer_check_bytes(const Py_buffer* view, size_t bytes, const char* name) {
+    if ((size_t) view->len < bytes) {
+        PyErr_Format(
+            PyExc_ValueError, "%s: buffer holds %zd bytes, %zu required", name, view->len, bytes
+        );
+        return false;
+    }
+    return true;
+}
+
+static bool parse_type(const char* name, data_type_t* type) {
+    *type = quant_type_from_name(name);
+    if (TYPE_MAX_COUNT == *type) {
+        PyErr_Format(PyExc_ValueError, "unknown data type '%s'", name);
+        return false;
+    }
+    return true;
+}
+
+static bool check_block_multiple(data_type_t type, size_t n) {
+    if (0 != n % quant_block_size(type)) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "%zu elements is not a multiple of the %s block size %zu",
+            n,
+            quant_type_name(type),
+            quant_block_size(type)
+        );
+        return false;
+    }
+    return true;
+}
+
+static void buffer_release(Py_buffer* views, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (views[i].obj) {
+            PyBuffer_Release(&views[i]);
+        }
+    }
+}
+
+/*
+ * Layout queries
+ */
+
+static PyObject* py_row_size(PyObject* self, PyObject* args) {
+    (void) self;
+
+    const char* name;
+    Py_ssize_t  n;
+    data_type_t type;
+    if (!PyArg_ParseTuple(args, "sn:row_size", &name, &n) || !parse_type(name, &type)) {
+        return NULL;
+    }
+    if (n < 0) {
+        return PyErr_Format(PyExc_ValueError, "negative element count");
+    }
+    if (!check_block_multiple(type, (size_t) n)) {
+        return NULL;
+    }
+
+    return PyLong_FromSize_t(quant_row_size(type, (size_t) n));
+}
+
+static PyObject* py_block_size(PyObject* self, PyObject* args) {
+    (void) self;
+
+    const char* name;
+    data_type_t type;
+    if (!PyArg_ParseTuple(args, "s:block_size", &name) || !parse_type(name, &type)) {
+        return NULL;
+    }
+
+    return PyLong_FromSize_t(quant_block_size(type));
+}
+
+/*
+ * Conversion and quantization
+ */
+
+static PyObject* py_quantize(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+
+    static char* keywords[] = {"type", "src", "dst", "cols", "importance", "n_threads", NULL};
+
+    const char* name;
+    PyObject*   src_obj;
+    PyObject*   dst_obj;
+    Py_ssize_t  cols           = 0;
+    PyObject*   importance_obj = Py_None;
+    Py_ssize_t  n_threads      = 0;
+    if (!PyArg_ParseTupleAndKeywords(
+            args,
+            kwargs,
+            "sOO|nOn:quantize",
+            keywords,
+            &name,
+            &src_obj,
+            &dst_obj,
+            &cols,
+            &importance_obj,
+            &n_threads
+        )) {
+        return NULL;
+    }
+
+    data_type_t type;
+    if (!parse_type(name, &type)) {
+        return NULL;
+    }
+
+    Py_buffer views[3] = {{0}};
+    PyObject* result   = NULL;
+    if (!buffer_acquire(src_obj, &views[0], false) || !buffer_acquire(dst_obj, &views[1], true)
+        || (Py_None != importance_obj && !buffer_acquire(importance_obj, &views[2], false))) {
+        goto done;
+    }
+    if (!buffer_check_format(&views[0], 'f', sizeof(float), "src")) {
+        goto done;
+    }
+
+    // Rows default to the innermost dimension of the source
+    const size_t n = (size_t) (views[0].len / views[0].itemsize);
+    if (0 == cols) {
+        cols = views[0].ndim > 1 ? views[0].shape[views[0].ndim - 1] : (Py_ssize_t) n;
+    }
+    if (cols < 0 || n_threads < 0 || (cols > 0 && 0 != n % (size_t) cols)) {
+        PyErr_SetString(PyExc_ValueError, "cols must be positive and divide the element count");
+        goto done;
+    }
+    const size_t rows = cols ? n / (size_t) cols : 0;
+    if (!check_block_multiple(type, (size_t) cols)
+        || !buffer_check_bytes(&views[1], rows * quant_row_size(type, (size_t) cols), "dst")) {
+        goto done;
+    }
+
+    const float* importance = NULL;
+    if (views[2].obj) {
+        if (!buffer_check_format(&views[2], 'f', sizeof(float), "importance")
+            || !buffer_check_bytes(&views[2], (size_t) cols * sizeof(float), "importance")) {
+            goto done;
+        }
+        importance = (const float*) views[2].buf;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    quantize_tensor(
+        type,
+        (const float*) views[0].buf,
+        views[1].buf,
+        rows,
+        (size_t) cols,
+        importance,
+        (size_t) n_threads
+    );
+    Py_END_ALLOW_THREADS;
+
+    result = PyLong_FromSize_t(rows * quant_row_size(type, (size_t) cols));
+
+done:
+    buffer_release(views, 3);
+    return result;
+}
+
+static PyObject* py_dequantize(PyObject* self, PyObject* args) {
+    (void) self;
+
+    const char* name;
+    PyObject*   src_obj;
+    PyObject*   dst_obj;
+    data_type_t type;
+    if (!PyArg_ParseTuple(args, "sOO:dequantize", &name, &src_obj, &dst_obj)
+        || !parse_type(name, &type)) {
+        return NULL;
+    }
+
+    Py_buffer views[2] = {{0}};
+    PyObject* result   = NULL;
+    if (!buffer_acquire(src_obj, &views[0], false) || !buffer_acquire(dst_obj, &views[1], true)
+        || !buffer_check_format(&views[1], 'f', sizeof(float), "dst")) {
+        goto done;
+    }
+
+    // The element count comes from the output, which is always float32
+    const size_t n = (size_t) (views[1].len / views[1].itemsize);
+    if (!check_block_multiple(type, n)
+        || !buffer_check_bytes(&views[0], quant_row_size(type, n), "src")) {
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    dequantize_row(type, views[0].buf, (float*) views[1].buf, n);
+    Py_END_ALLOW_THREADS;
+
+    result = PyLong_FromSize_t(n);
+
+done:
+    buffer_release(views, 2);
+    return result;
+}
+
+/*
+ * Fixed point
+ */
+
+static PyObject* py_fixed16_convert(PyObject* args, bool to_fixed) {
+    PyObject* src_obj;
+    PyObject* dst_obj;
+    const char* format = to_fixed ? "OO:to_fixed16" : "OO:from_fixed16";
+    if (!PyArg_ParseTuple(args, format, &src_obj, &dst_obj)) {
+        return NULL;
+    }
+
+    Py_buffer views[2] = {{0}};
+    PyObject* result   = NULL;
+    if (!buffer_acquire(src_obj, &views[0], false) || !buffer_acquire(dst_obj, &views[1], true)
+        || !buffer_check_format(&views[0], to_fixed ? 'f' : 'i', 4, "src")
+        || !buffer_check_format(&views[1], to_fixed ? 'i' : 'f', 4, "dst")) {
+        goto done;
+    }
+
+    const size_t n = (size_t) (views[0].len / 4);
+    if (!buffer_check_bytes(&views[1], n * 4, "dst")) {
+        goto done;
+    }
+
+    // FLOAT_TO_FIXED() is undefined outside the Q16.16 range, so reject before converting
+    if (to_fixed) {
+        const float* src = (const float*) views[0].buf;
+        for (size_t i = 0; i < n; ++i) {
+            if (!(src[i] >= -32768.0f && src[i] < 32768.0f)) {
+                PyErr_Format(
+                    PyExc_ValueError, "src[%zu] is not finite or outside [-32768, 32768)", i
+                );
+                goto done;
+            }
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    if (to_fixed) {
+        const float* src = (const float*) views[0].buf;
+        fixed16_t*   dst = (fixed16_t*) views[1].buf;
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = FLOAT_TO_FIXED(src[i]);
+        }
+    } else {
+        const fixed16_t* src = (const fixed16_t*) views[0].buf;
+        float*           dst = (float*) views[1].buf;
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = FIXED_TO_FLOAT(src[i]);
+        }
+    }
+    Py_END_ALLOW_THREADS;
+
+    result = PyLong_FromSize_t(n);
+
+done:
+    buffer_release(views, 2);
+    return result;
+}
+
+static PyObject* py_to_fixed16(PyObject* self, PyObject* args) {
+    (void) self;
+    return py_fixed16_convert(args, true);
+}
+
+static PyObject* py_from_fixed16(PyObject* self, PyObject* args) {
+    (void) self;
+    return py_fixed16_convert(args, false);
+}
+
+static PyObject* py_multiplier_from_float(PyObject* self, PyObject* args) {
+    (void) self;
+
+    double real;
+    if (!PyArg_ParseTuple(args, "d:multiplier_from_float", &real)) {
+        return NULL;
+    }
+    if (!isfinite(real) || real < 0.0) {
+        return PyErr_Format(PyExc_ValueError, "multiplier must be finite and non-negative");
+    }
+
+    const quant_multiplier_t m = quant_multiplier_from_float(real);
+    return Py_BuildValue("(ii)", m.multiplier, m.shift);
+}
+
+static PyObject* py_requantize(PyObject* self, PyObject* args, PyObject* kwargs) {
+    (void) self;
+
+    static char* keywords[] = {"acc", "dst", "multiplier", "shift", "zero_point", "bias", NULL};
+
+    PyObject* acc_obj;
+    PyObject* dst_obj;
+    PyObject* multiplier_obj;
+    PyObject* shift_obj;
+    int       zero_point = 0;
+    PyObject* bias_obj   = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(
+            args,
+            kwargs,
+            "OOOO|iO:requantize",
+            keywords,
+            &acc_obj,
+            &dst_obj,
+            &multiplier_obj,
+            &shift_obj,
+            &zero_point,
+            &bias_obj
+        )) {
+        return NULL;
+    }
+
+    Py_buffer views[5] = {{0}};
+    PyObject* result   = NULL;
+    if (!buffer_acquire(acc_obj, &views[0], false) || !buffer_acquire(dst_obj, &views[1], true)
+        || !buffer_acquire(multiplier_obj, &views[2], false)
+        || !buffer_acquire(shift_obj, &views[3], false)
+        || (Py_None != bias_obj && !buffer_acquire(bias_obj, &views[4], false))) {
+        goto done;
+    }
+    if (!buffer_check_format(&views[0], 'i', sizeof(int32_t), "acc")
+        || !buffer_check_format(&views[1], 'b', sizeof(int8_t), "dst")
+        || !buffer_check_format(&views[2], 'i', sizeof(int32_t), "multiplier")
+        || !buffer_check_format(&views[3], 'i', sizeof(int32_t), "shift")
+        || (views[4].obj && !buffer_check_format(&views[4], 'i', sizeof(int32_t), "bias"))) {
+        goto done;
+    }
+
+    // One multiplier per channel; channels are the innermost dimension
+    const size_t n        = (size_t) (views[0].len / views[0].itemsize);
+    const size_t channels = (size_t) (views[2].len / views[2].itemsize);
+    if (0 == channels || 0 != n % channels || views[3].len != views[2].len
+        || (views[4].obj && views[4].len != views[2].len)) {
+        PyErr_SetString(
+            PyExc_ValueError, "multiplier, shift and bias must hold one item per channel of acc"
+        );
+        goto done;
+    }
+    if (!buffer_check_bytes(&views[1], n, "dst")) {
+        goto done;
+    }
+
+    // fixed_mul_shift() is only defined for shifts in [-31, 31]
+    const int32_t* shift = (const int32_t*) views[3].buf;
+    for (size_t c = 0; c < channels; ++c) {
+        if (shift[c] < -31 || shift[c] > 31) {
+            PyErr_Format(
+                PyExc_ValueError, "shift[%zu] = %d is outside [-31, 31]", c, (int) shift[c]
+            );
+            goto done;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    requantize_rows(
+        (const int32_t*) views[0].buf,
+        (int8_t*) views[1].buf,
+        n / channels,
+        channels,
+        (const int32_t*) views[4].buf,
+        (const int32_t*) views[2].buf,
+        (const int32_t*) views[3].buf,
+        zero_point
+    );
+    Py_END_ALLOW_THREADS;
+
+    result = PyLong_FromSize_t(n);
+
+done:
+    buffer_release(views, 5);
+    return result;
+}
+
+/*
+ * Module definition
+ */
+
+static PyMethodDef fixed_point_methods[] = {
+    {"row_size", py_row_size, METH_VARARGS, "row_size(type, n) -> bytes needed for n elements"},
+    {"block_size", py_block_size, METH_VARARGS, "block_size(type) -> elements per block"},
+    {"quantize",
+     (PyCFunction) (void (*)(void)) py_quantize,
+     METH_VARARGS | METH_KEYWORDS,
+     "quantize(type, src, dst, cols=0, importance=None, n_threads=0) -> bytes written\n\n"
+     "Encodes float32 src into dst row by row; cols defaults to the innermost dimension."},
+    {"dequantize",
+     py_dequantize,
+     METH_VARARGS,
+     "dequantize(type, src, dst) -> elements written\n\nDecodes src into the float32 buffer dst."},
+    {"to_fixed16",
+     py_to_fixed16,
+     METH_VARARGS,
+     "to_fixed16(src, dst): float32 -> Q16.16 int32\n\n"
+     "Raises ValueError for values that are not finite or outside [-32768, 32768)."},
+    {"from_fixed16",
+     py_from_fixed16,
+     METH_VARARGS,
+     "from_fixed16(src, dst): Q16.16 int32 -> float32"},
+    {"multiplier_from_float",
+     py_multiplier_from_float,
+     METH_VARARGS,
+     "multiplier_from_float(real) -> (q31_multiplier, shift)\n\n"
+     "real must be finite and non-negative."},
+    {"requantize",
+     (PyCFunction) (void (*)(void)) py_requantize,
+     METH_VARARGS | METH_KEYWORDS,
+     "requantize(acc, dst, multiplier, shift, zero_point=0, bias=None) -> elements written\n\n"
+     "Scales int32 accumulators to int8 with per-channel Q31 multipliers and shifts;\n"
+     "every shift must lie in [-31, 31]."},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef fixed_point_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name    = "fixed_point",
+    .m_doc     = "Zero-copy bindings for the fixed-point library's bulk kernels.",
+    .m_size    = -1,
+    .m_methods = fixed_point_methods,
+};
+
+PyMODINIT_FUNC PyInit_fixed_point(void) {
+    PyObject* module = PyModule_Create(&fixed_point_module);
+    if (!module) {
+        return NULL;
+    }
+
+    PyObject* types = PyTuple_New(TYPE_MAX_COUNT);
+    if (!types) {
+        Py_DECREF(module);
+        return NULL;
+    }
+    for (int type = 0; type < TYPE_MAX_COUNT; ++type) {
+        PyObject* name = PyUnicode_FromString(quant_type_name((data_type_t) type));
+        if (!name) {
+            Py_DECREF(types);
+            Py_DECREF(module);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(types, type, name);
+    }
+
+    // PyModule_AddObject() steals the reference only when it succeeds
+    if (PyModule_AddObject(module, "TYPES", types) < 0) {
+        Py_DECREF(types);
+        Py_DECREF(module);
+        return NULL;
+    }
+    if (PyModule_AddIntConstant(module, "FIXED_SIZE", FIXED_SIZE) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
@@ -0,0 +1,433 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/bit_dump.c
+ *
+ * @brief Bulk text rendering and statistics for raw number buffers.
+ *
+ * Lines are assembled directly into the output buffer. Digits are written
+ * with small integer loops and values are rounded once in double precision,
+ * so rendering costs tens of nanoseconds per element instead of a printf call
+ * per bit.
+ */
+
+#include "bit_dump.h"
+#include "fixed_point.h"
+#include "floating_point.h"
+
+#include <math.h>
+#include <string.h>
+
+/// Columns of the element index and of the value.
+#define BIT_DUMP_INDEX_WIDTH 15
+#define BIT_DUMP_VALUE_WIDTH 15
+
+/// Blank columns between fields.
+#define BIT_DUMP_GAP         2
+
+/// Elements counted per code histogram pass; keeps every bin below 2^32.
+#define BIT_DUMP_HISTOGRAM_BATCH (UINT32_C(1) << 30)
+
+typedef struct {
+    const char* name;
+    size_t      size;           // bytes per element
+    unsigned    exponent_bits;  // exponent field, or integer bits for fixed16
+    unsigned    mantissa_bits;  // mantissa field, or fraction bits for fixed16
+} bit_dump_layout_t;
+
+static const bit_dump_layout_t bit_dump_layouts[BIT_DUMP_MAX_TYPE] = {
+    [BIT_DUMP_F32]     = {"f32", 4, 8, 23},
+    [BIT_DUMP_F16]     = {"f16", 2, 5, 10},
+    [BIT_DUMP_BF16]    = {"bf16", 2, 8, 7},
+    [BIT_DUMP_F8]      = {"f8", 1, 4, 3},
+    [BIT_DUMP_FIXED16] = {"fixed16", 4, 15, 16},
+};
+
+static const double bit_dump_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+bit_dump_type_t bit_dump_type_from_name(const char* name) {
+    for (int type = 0; type < BIT_DUMP_MAX_TYPE; ++type) {
+        if (name && 0 == strcmp(name, bit_dump_layouts[type].name)) {
+            return (bit_dump_type_t) type;
+        }
+    }
+    return BIT_DUMP_MAX_TYPE;
+}
+
+const char* bit_dump_type_name(bit_dump_type_t type) {
+    return type < BIT_DUMP_MAX_TYPE ? bit_dump_layouts[type].name : NULL;
+}
+
+size_t bit_dump_type_size(bit_dump_type_t type) {
+    assert(type < BIT_DUMP_MAX_TYPE);
+    return bit_dump_layouts[type].size;
+}
+
+static size_t bit_dump_hex_width(const bit_dump_layout_t* layout) {
+    return 2 + 2 * layout->size;
+}
+
+size_t bit_dump_line_width(bit_dump_type_t type) {
+    assert(type < BIT_DUMP_MAX_TYPE);
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+
+    // index, value, hex, then "s exponent mantissa" and the newline
+    return BIT_DUMP_INDEX_WIDTH + BIT_DUMP_GAP + BIT_DUMP_VALUE_WIDTH + BIT_DUMP_GAP
+           + bit_dump_hex_width(layout) + BIT_DUMP_GAP + 1 + 1 + layout->exponent_bits + 1
+           + layout->mantissa_bits + 1;
+}
+
+/*
+ * Element access
+ */
+
+static uint32_t bit_dump_load(const bit_dump_layout_t* layout, const uint8_t* p) {
+    switch (layout->size) {
+        case 1:
+            return p[0];
+        case 2: {
+            uint16_t bits;
+            memcpy(&bits, p, sizeof(bits));
+            return bits;
+        }
+        default: {
+            uint32_t bits;
+            memcpy(&bits, p, sizeof(bits));
+            return bits;
+        }
+    }
+}
+
+static double bit_dump_decode(bit_dump_type_t type, uint32_t bits) {
+    switch (type) {
+        case BIT_DUMP_F32:
+            return decode_float32(bits);
+        case BIT_DUMP_F16:
+            return decode_float16((float16_t) bits);
+        case BIT_DUMP_BF16:
+            return decode_bfloat16((bfloat16_t) bits);
+        case BIT_DUMP_F8:
+            return decode_float8((float8_t) bits);
+        default:
+            return (double) (fixed16_t) bits / FIXED_VAL;
+    }
+}
+
+/*
+ * Field writers
+ */
+
+// Right-aligned decimal, truncated to the lowest width digits if it does not fit
+static char* put_decimal(char* p, uint64_t value, size_t width) {
+    char* q = p + width;
+    do {
+        *--q   = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value && q > p);
+    memset(p, ' ', (size_t) (q - p));
+    return p + width;
+}
+
+// Zero-padded decimal of exactly width digits
+static char* put_digits(char* p, uint64_t value, size_t width) {
+    for (size_t i = width; i-- > 0;) {
+        p[i]   = (char) ('0' + value % 10);
+        value /= 10;
+    }
+    return p + width;
+}
+
+static char* put_padded(char* p, const char* text, size_t width) {
+    const size_t length = strlen(text) < width ? strlen(text) : width;
+    memset(p, ' ', width - length);
+    memcpy(p + width - length, text, length);
+    return p + width;
+}
+
+// Scientific notation with nine significant digits: "+d.dddddddde+dd"
+static char* put_scientific(char* p, double value) {
+    if (isnan(value)) {
+        return put_padded(p, "nan", BIT_DUMP_VALUE_WIDTH);
+    }
+    if (isinf(value)) {
+        return put_padded(p, value < 0 ? "-inf" : "+inf", BIT_DUMP_VALUE_WIDTH);
+    }
+
+    const double magnitude = fabs(value);
+    int          exponent  = 0;
+    uint64_t     digits    = 0;
+    if (magnitude > 0.0) {
+        exponent = (int) floor(log10(magnitude));
+
+        // Scale to nine integer digits; log10 may be off by one near powers of ten
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const int shift  = 8 - exponent;
+            double    scaled = magnitude;
+            for (int k = shift; k != 0;) {
+                const int step = k > 22 ? 22 : (k < -22 ? -22 : k);
+                scaled         = step > 0 ? scaled * bit_dump_pow10[step]
+                                          : scaled / bit_dump_pow10[-step];
+                k             -= step;
+            }
+            digits = (uint64_t) llround(scaled);
+            if (digits >= UINT64_C(1000000000)) {
+                exponent++;
+            } else if (digits < UINT64_C(100000000)) {
+                exponent--;
+            } else {
+                break;
+            }
+        }
+        if (digits >= UINT64_C(1000000000)) {
+            digits /= 10;
+        }
+    }
+
+    *p++ = signbit(value) ? '-' : '+';
+    *p++ = (char) ('0' + digits / UINT64_C(100000000));
+    *p++ = '.';
+    p    = put_digits(p, digits % UINT64_C(100000000), 8);
+    *p++ = 'e';
+    *p++ = exponent < 0 ? '-' : '+';
+    return put_digits(p, (uint64_t) abs(exponent), 2);
+}
+
+static char* put_hex(char* p, uint32_t bits, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+
+    *p++ = '0';
+    *p++ = 'x';
+    for (int shift = (int) (8 * size) - 4; shift >= 0; shift -= 4) {
+        *p++ = hex[(bits >> shift) & 0xF];
+    }
+    return p;
+}
+
+static char* put_bits(char* p, uint32_t bits, unsigned width) {
+    for (unsigned i = width; i-- > 0;) {
+        *p++ = (char) ('0' + ((bits >> i) & 1));
+    }
+    return p;
+}
+
+static char* put_label(char* p, const char* text, size_t width) {
+    const size_t length = strlen(text) < width ? strlen(text) : width;
+    memcpy(p, text, length);
+    memset(p + length, ' ', width - length);
+    return p + width;
+}
+
+static char* put_gap(char* p) {
+    memset(p, ' ', BIT_DUMP_GAP);
+    return p + BIT_DUMP_GAP;
+}
+
+/*
+ * Rendering
+ */
+
+size_t bit_dump_header(bit_dump_type_t type, char* out, size_t capacity) {
+    const size_t width = bit_dump_line_width(type);
+    if (capacity < width) {
+        return 0;
+    }
+
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+    const bool               fixed  = BIT_DUMP_FIXED16 == type;
+
+    char* p = out;
+    p       = put_padded(p, "index", BIT_DUMP_INDEX_WIDTH);
+    p       = put_gap(p);
+    p       = put_padded(p, "value", BIT_DUMP_VALUE_WIDTH);
+    p       = put_gap(p);
+
+    // Field labels are left-aligned and cut to their column
+    p    = put_label(p, "hex", bit_dump_hex_width(layout));
+    p    = put_gap(p);
+    *p++ = 's';
+    *p++ = ' ';
+    p    = put_label(p, fixed ? "integer" : "exponent", layout->exponent_bits);
+    *p++ = ' ';
+    p    = put_label(p, fixed ? "fraction" : "mantissa", layout->mantissa_bits);
+    *p++ = '\n';
+
+    return (size_t) (p - out);
+}
+
+size_t bit_dump_format(
+    bit_dump_type_t type,
+    const void*     src,
+    size_t          n,
+    uint64_t        first_index,
+    char*           out,
+    size_t          capacity
+) {
+    assert(type < BIT_DUMP_MAX_TYPE);
+
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+    const size_t             width  = bit_dump_line_width(type);
+    const size_t             lines  = capacity / width < n ? capacity / width : n;
+    const uint8_t*           bytes  = (const uint8_t*) src;
+
+    const unsigned fields = layout->exponent_bits + layout->mantissa_bits;
+    for (size_t i = 0; i < lines; ++i) {
+        const uint32_t bits = bit_dump_load(layout, bytes + i * layout->size);
+
+        char* p = out + i * width;
+        p       = put_decimal(p, first_index + i, BIT_DUMP_INDEX_WIDTH);
+        p       = put_gap(p);
+        p       = put_scientific(p, bit_dump_decode(type, bits));
+        p       = put_gap(p);
+        p       = put_hex(p, bits, layout->size);
+        p       = put_gap(p);
+        *p++    = (char) ('0' + ((bits >> fields) & 1));
+        *p++    = ' ';
+        p       = put_bits(p, bits >> layout->mantissa_bits, layout->exponent_bits);
+        *p++    = ' ';
+        p       = put_bits(p, bits, layout->mantissa_bits);
+        *p      = '\n';
+    }
+
+    return lines;
+}
+
+/*
+ * Statistics
+ */
+
+void bit_dump_stats_reset(bit_dump_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->min = INFINITY;
+    stats->max = -INFINITY;
+}
+
+// Adds count occurrences of one code
+static inline void bit_dump_stats_add(
+    bit_dump_type_t type, uint32_t bits, uint64_t count, bit_dump_stats_t* stats
+) {
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+    const double             value  = bit_dump_decode(type, bits);
+
+    if (BIT_DUMP_FIXED16 != type) {
+        const uint32_t top      = (UINT32_C(1) << layout->exponent_bits) - 1;
+        const uint32_t mantissa = (UINT32_C(1) << layout->mantissa_bits) - 1;
+        const uint32_t exponent = (bits >> layout->mantissa_bits) & top;
+        const uint32_t fraction = bits & mantissa;
+
+        stats->exponents[exponent] += count;
+        if (0 == exponent && 0 != fraction) {
+            stats->subnormals += count;
+        }
+        if (BIT_DUMP_F8 == type) {
+            // E4M3FN has no infinities; only S.1111.111 is NaN
+            stats->nans += top == exponent && mantissa == fraction ? count : 0;
+        } else if (top == exponent) {
+            stats->nans       += 0 != fraction ? count : 0;
+            stats->infinities += 0 == fraction ? count : 0;
+        }
+    }
+
+    if (isfinite(value)) {
+        stats->zeros       += 0.0 == value ? count : 0;
+        stats->sum         += value * (double) count;
+        stats->sum_squares += value * value * (double) count;
+        stats->min          = value < stats->min ? value : stats->min;
+        stats->max          = value > stats->max ? value : stats->max;
+    }
+}
+
+void bit_dump_stats_update(
+    bit_dump_type_t type, const void* src, size_t n, bit_dump_stats_t* stats
+) {
+    assert(type < BIT_DUMP_MAX_TYPE);
+
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+    const uint8_t*           bytes  = (const uint8_t*) src;
+    stats->count                   += n;
+
+    if (layout->size > 2) {
+        for (size_t i = 0; i < n; ++i) {
+            bit_dump_stats_add(type, bit_dump_load(layout, bytes + i * layout->size), 1, stats);
+        }
+        return;
+    }
+
+    // Narrow codes are counted first and classified once per distinct code
+    const size_t codes = (size_t) 1 << (8 * layout->size);
+    uint32_t     histogram[1 << 16];
+    for (size_t first = 0; first < n; first += BIT_DUMP_HISTOGRAM_BATCH) {
+        const size_t left  = n - first;
+        const size_t count = left < BIT_DUMP_HISTOGRAM_BATCH ? left : BIT_DUMP_HISTOGRAM_BATCH;
+
+        memset(histogram, 0, codes * sizeof(uint32_t));
+        for (size_t i = first; i < first + count; ++i) {
+            histogram[bit_dump_load(layout, bytes + i * layout->size)]++;
+        }
+
+        for (size_t code = 0; code < codes; ++code) {
+            if (histogram[code]) {
+                bit_dump_stats_add(type, (uint32_t) code, histogram[code], stats);
+            }
+        }
+    }
+}
+
+void bit_dump_stats_merge(bit_dump_stats_t* dst, const bit_dump_stats_t* src) {
+    dst->count       += src->count;
+    dst->zeros       += src->zeros;
+    dst->subnormals  += src->subnormals;
+    dst->infinities  += src->infinities;
+    dst->nans        += src->nans;
+    dst->sum         += src->sum;
+    dst->sum_squares += src->sum_squares;
+    dst->min          = src->min < dst->min ? src->min : dst->min;
+    dst->max          = src->max > dst->max ? src->max : dst->max;
+    for (size_t e = 0; e < 256; ++e) {
+        dst->exponents[e] += src->exponents[e];
+    }
+}
+
+void bit_dump_stats_print(FILE* stream, bit_dump_type_t type, const bit_dump_stats_t* stats) {
+    assert(type < BIT_DUMP_MAX_TYPE);
+
+    const bit_dump_layout_t* layout = &bit_dump_layouts[type];
+    const uint64_t finite = stats->count - stats->nans - stats->infinities;
+    const double   mean   = finite ? stats->sum / (double) finite : 0.0;
+    const double   var    = finite ? stats->sum_squares / (double) finite - mean * mean : 0.0;
+
+    fprintf(stream, "type:        %s\n", layout->name);
+    fprintf(stream, "count:       %llu\n", (unsigned long long) stats->count);
+    fprintf(stream, "zeros:       %llu\n", (unsigned long long) stats->zeros);
+    fprintf(stream, "subnormals:  %llu\n", (unsigned long long) stats->subnormals);
+    fprintf(stream, "infinities:  %llu\n", (unsigned long long) stats->infinities);
+    fprintf(stream, "nans:        %llu\n", (unsigned long long) stats->nans);
+    if (finite) {
+        fprintf(stream, "min:         %.9g\n", stats->min);
+        fprintf(stream, "max:         %.9g\n", stats->max);
+        fprintf(stream, "mean:        %.9g\n", mean);
+        fprintf(stream, "stddev:      %.9g\n", sqrt(var > 0.0 ? var : 0.0));
+    }
+
+    if (BIT_DUMP_FIXED16 == type) {
+        return;
+    }
+
+    // Biased exponent histogram, unbiased exponent alongside
+    const int bias = (1 << (layout->exponent_bits - 1)) - 1;
+    fprintf(stream, "exponents:\n");
+    for (size_t e = 0; e < ((size_t) 1 << layout->exponent_bits); ++e) {
+        if (stats->exponents[e]) {
+            fprintf(
+                stream,
+                "  %3zu (2^%-4d) %14llu  %6.2f%%\n",
+                e,
+                (int) e - bias,
+                (unsigned long long) stats->exponents[e],
+                100.0 * (double) stats->exponents[e] / (double) stats->count
+            );
+        }
+    }
+}
@@ -0,0 +1,205 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/blas_half.c
+ *
+ * @brief Element-wise and BLAS-1 kernels on half precision storage.
+ *
+ * Each public kernel is a constant-folded instance of one loop, half_map_f16()
+ * or half_map_bf16(), parameterized by the operation. The loop converts eight
+ * elements per operand into fp32 registers, applies the operation and
+ * converts back; leftover elements go through the scalar codecs.
+ */
+
+#include "blas_half.h"
+#include "profile.h"
+#include "simd_convert.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+    #include <immintrin.h>
+#endif
+
+typedef enum {
+    HALF_ADD,   // out = a + b
+    HALF_MUL,   // out = a * b
+    HALF_FMA,   // out = a * b + c
+    HALF_AXPY,  // out = alpha * a + b
+    HALF_SCALE, // out = alpha * a
+} half_op_t;
+
+static inline __attribute__((always_inline)) float
+half_apply(half_op_t op, float alpha, float a, float b, float c) {
+    switch (op) {
+        case HALF_ADD:
+            return a + b;
+        case HALF_MUL:
+            return a * b;
+        case HALF_FMA:
+            return fmaf(a, b, c);
+        case HALF_AXPY:
+            return fmaf(alpha, a, b);
+        default:
+            return alpha * a;
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+static inline __attribute__((always_inline)) __m256
+half_apply_ps(half_op_t op, __m256 alpha, __m256 a, __m256 b, __m256 c) {
+    switch (op) {
+        case HALF_ADD:
+            return _mm256_add_ps(a, b);
+        case HALF_MUL:
+            return _mm256_mul_ps(a, b);
+        case HALF_FMA:
+            return _mm256_fmadd_ps(a, b, c);
+        case HALF_AXPY:
+            return _mm256_fmadd_ps(alpha, a, b);
+        default:
+            return _mm256_mul_ps(alpha, a);
+    }
+}
+
+#endif
+
+/*
+ * Half precision
+ */
+
+static inline __attribute__((always_inline)) void half_map_f16(
+    half_op_t        op,
+    float            alpha,
+    const float16_t* a,
+    const float16_t* b,
+    const float16_t* c,
+    float16_t*       out,
+    size_t           n
+) {
+    PROFILE_BEGIN(sample);
+
+    size_t i = 0;
+
+#if defined(__AVX512FP16__)
+    // An exact sum or product rounded once to fp16 equals the fp32 route
+    if (HALF_ADD == op || HALF_MUL == op) {
+        for (; i + 32 <= n; i += 32) {
+            const __m512h va = _mm512_loadu_ph(a + i);
+            const __m512h vb = _mm512_loadu_ph(b + i);
+            const __m512h r  = HALF_ADD == op ? _mm512_add_ph(va, vb) : _mm512_mul_ph(va, vb);
+            _mm512_storeu_ph(out + i, r);
+        }
+    }
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    const __m256 valpha = _mm256_set1_ps(alpha);
+    for (; i + 8 <= n; i += 8) {
+        const __m256 va = simd_load_f16_ps(a + i);
+        const __m256 vb = b ? simd_load_f16_ps(b + i) : _mm256_setzero_ps();
+        const __m256 vc = c ? simd_load_f16_ps(c + i) : _mm256_setzero_ps();
+        simd_store_f16_ps(out + i, half_apply_ps(op, valpha, va, vb, vc));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const float vb = b ? decode_float16(b[i]) : 0.0f;
+        const float vc = c ? decode_float16(c[i]) : 0.0f;
+        out[i]         = encode_float16(half_apply(op, alpha, decode_float16(a[i]), vb, vc));
+    }
+
+    // Every operand read plus the output written
+    PROFILE_END(
+        sample,
+        PROFILE_BLAS_HALF,
+        n,
+        (2 + (b != NULL) + (c != NULL)) * n * sizeof(float16_t)
+    );
+}
+
+void add_f16(const float16_t* a, const float16_t* b, float16_t* out, size_t n) {
+    half_map_f16(HALF_ADD, 0.0f, a, b, NULL, out, n);
+}
+
+void mul_f16(const float16_t* a, const float16_t* b, float16_t* out, size_t n) {
+    half_map_f16(HALF_MUL, 0.0f, a, b, NULL, out, n);
+}
+
+void fma_f16(
+    const float16_t* a, const float16_t* b, const float16_t* c, float16_t* out, size_t n
+) {
+    half_map_f16(HALF_FMA, 0.0f, a, b, c, out, n);
+}
+
+void axpy_f16(float alpha, const float16_t* x, float16_t* y, size_t n) {
+    half_map_f16(HALF_AXPY, alpha, x, y, NULL, y, n);
+}
+
+void scale_f16(float alpha, float16_t* x, size_t n) {
+    half_map_f16(HALF_SCALE, alpha, x, NULL, NULL, x, n);
+}
+
+/*
+ * Brain floating point
+ */
+
+static inline __attribute__((always_inline)) void half_map_bf16(
+    half_op_t         op,
+    float             alpha,
+    const bfloat16_t* a,
+    const bfloat16_t* b,
+    const bfloat16_t* c,
+    bfloat16_t*       out,
+    size_t            n
+) {
+    PROFILE_BEGIN(sample);
+
+    size_t i = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m256 valpha = _mm256_set1_ps(alpha);
+    for (; i + 8 <= n; i += 8) {
+        const __m256 va = simd_load_bf16_ps(a + i);
+        const __m256 vb = b ? simd_load_bf16_ps(b + i) : _mm256_setzero_ps();
+        const __m256 vc = c ? simd_load_bf16_ps(c + i) : _mm256_setzero_ps();
+
+        simd_store_bf16_ps(out + i, half_apply_ps(op, valpha, va, vb, vc));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const float vb = b ? decode_bfloat16(b[i]) : 0.0f;
+        const float vc = c ? decode_bfloat16(c[i]) : 0.0f;
+        out[i]         = encode_bfloat16(half_apply(op, alpha, decode_bfloat16(a[i]), vb, vc));
+    }
+
+    // Every operand read plus the output written
+    PROFILE_END(
+        sample,
+        PROFILE_BLAS_HALF,
+        n,
+        (2 + (b != NULL) + (c != NULL)) * n * sizeof(bfloat16_t)
+    );
+}
+
+void add_bf16(const bfloat16_t* a, const bfloat16_t* b, bfloat16_t* out, size_t n) {
+    half_map_bf16(HALF_ADD, 0.0f, a, b, NULL, out, n);
+}
+
+void mul_bf16(const bfloat16_t* a, const bfloat16_t* b, bfloat16_t* out, size_t n) {
+    half_map_bf16(HALF_MUL, 0.0f, a, b, NULL, out, n);
+}
+
+void fma_bf16(
+    const bfloat16_t* a, const bfloat16_t* b, const bfloat16_t* c, bfloat16_t* out, size_t n
+) {
+    half_map_bf16(HALF_FMA, 0.0f, a, b, c, out, n);
+}
+
+void axpy_bf16(float alpha, const bfloat16_t* x, bfloat16_t* y, size_t n) {
+    half_map_bf16(HALF_AXPY, alpha, x, y, NULL, y, n);
+}
+
+void scale_bf16(float alpha, bfloat16_t* x, size_t n) {
+    half_map_bf16(HALF_SCALE, alpha, x, NULL, NULL, x, n);
+}
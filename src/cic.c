@@ -0,0 +1,554 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/cic.c
+ *
+ * @brief Multi-channel CIC decimators, interpolators and moving-average filters.
+ *
+ * Every channel of a block shares the same decimation phase and comb slot, so
+ * the kernels walk the channels in groups with local copies of both. The
+ * driver then advances the shared state once for the whole block. AVX2 has no
+ * 64-bit arithmetic shift, so it is built from a logical shift between two
+ * XORs with the sign mask, which gives exactly the scalar result.
+ */
+
+#include "cic.h"
+#include "profile.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+/// Interpolator input frames compensated per pass.
+#define CIC_BLOCK        256
+
+/// Frequency grid of the compensator design.
+#define CIC_DESIGN_GRID  2048
+
+/// Largest compensator boost, 24 dB.
+#define CIC_DESIGN_BOOST 16.0
+
+cic_t* malloc_cic(cic_mode_t mode, size_t n_channels, size_t order, size_t ratio, size_t delay) {
+    if (0 == n_channels || 0 == order || order > CIC_MAX_ORDER || 0 == ratio || 0 == delay) {
+        return NULL;
+    }
+
+    // Gain (R * M)^N, or R^(N - 1) * M^N after zero stuffing
+    const uint64_t limit = UINT64_C(1) << CIC_MAX_GROWTH;
+    if (delay > limit || ratio > limit / delay) {
+        return NULL;
+    }
+    uint64_t gain = 1;
+    for (size_t i = 0; i < order; ++i) {
+        const uint64_t factor = CIC_INTERPOLATE == mode && 0 == i ? delay : ratio * delay;
+        if (factor > limit / gain) {
+            return NULL;
+        }
+        gain *= factor;
+    }
+
+    cic_t* cic = (cic_t*) calloc(1, sizeof(cic_t));
+    if (!cic) {
+        return NULL;
+    }
+
+    cic->mode        = mode;
+    cic->n_channels  = n_channels;
+    cic->order       = order;
+    cic->ratio       = ratio;
+    cic->delay       = delay;
+    cic->integrators = (uint64_t*) calloc(order * n_channels, sizeof(uint64_t));
+    cic->combs       = (uint64_t*) calloc(order * delay * n_channels, sizeof(uint64_t));
+    if (!cic->integrators || !cic->combs) {
+        free_cic(cic);
+        return NULL;
+    }
+
+    // Unity gain: a shift by floor(log2(gain)), after 2^shift / gain in Q31 by long division,
+    // rounded up so that the product never falls below the exact quotient
+    cic->shift = 63 - __builtin_clzll(gain);
+    if (gain != UINT64_C(1) << cic->shift) {
+        uint64_t rem = UINT64_C(1) << cic->shift;
+        uint64_t q   = 0;
+        for (int bit = 0; bit < Q31_SIZE; ++bit) {
+            rem <<= 1;
+            q <<= 1;
+            if (rem >= gain) {
+                rem -= gain;
+                q |= 1;
+            }
+        }
+        q += 0 != rem;
+        cic->multiplier = q > INT32_MAX ? INT32_MAX : (int32_t) q;
+    }
+    return cic;
+}
+
+cic_t* malloc_moving_average(size_t n_channels, size_t length, size_t order) {
+    return malloc_cic(CIC_DECIMATE, n_channels, order, 1, length);
+}
+
+void free_cic(cic_t* cic) {
+    if (cic) {
+        free(cic->integrators);
+        free(cic->combs);
+        free(cic->taps);
+        free(cic->fir_history);
+        free(cic->scratch);
+        free(cic);
+    }
+}
+
+void cic_reset(cic_t* cic) {
+    memset(cic->integrators, 0, cic->order * cic->n_channels * sizeof(uint64_t));
+    memset(cic->combs, 0, cic->order * cic->delay * cic->n_channels * sizeof(uint64_t));
+    cic->comb_index = 0;
+    cic->phase      = 0;
+    if (cic->taps) {
+        memset(cic->fir_history, 0, cic->n_taps * cic->n_channels * sizeof(fixed16_t));
+        cic->fir_index = 0;
+    }
+}
+
+size_t cic_max_output(const cic_t* cic, size_t n) {
+    return CIC_DECIMATE == cic->mode ? (cic->phase + n) / cic->ratio : n * cic->ratio;
+}
+
+/*
+ * Compensator
+ */
+
+bool cic_set_compensator(cic_t* cic, const int16_t* taps, size_t n_taps) {
+    if (!taps) {
+        free(cic->taps);
+        free(cic->fir_history);
+        free(cic->scratch);
+        cic->taps        = NULL;
+        cic->fir_history = NULL;
+        cic->scratch     = NULL;
+        cic->n_taps      = 0;
+        cic->fir_index   = 0;
+        return true;
+    }
+    if (0 == n_taps || n_taps > CIC_MAX_COMPENSATOR) {
+        return false;
+    }
+
+    int16_t*   copy    = (int16_t*) malloc(n_taps * sizeof(int16_t));
+    fixed16_t* history = (fixed16_t*) calloc(n_taps * cic->n_channels, sizeof(fixed16_t));
+    fixed16_t* scratch = NULL;
+    if (CIC_INTERPOLATE == cic->mode) {
+        scratch = (fixed16_t*) malloc(CIC_BLOCK * cic->n_channels * sizeof(fixed16_t));
+    }
+    if (!copy || !history || (CIC_INTERPOLATE == cic->mode && !scratch)) {
+        free(copy);
+        free(history);
+        free(scratch);
+        return false;
+    }
+
+    cic_set_compensator(cic, NULL, 0);
+    memcpy(copy, taps, n_taps * sizeof(int16_t));
+    cic->taps        = copy;
+    cic->n_taps      = n_taps;
+    cic->fir_history = history;
+    cic->scratch     = scratch;
+    return true;
+}
+
+// CIC magnitude at f cycles per low-rate sample, normalized to 1 at DC
+static double cic_response(const cic_t* cic, double f) {
+    if (0.0 == f) {
+        return 1.0;
+    }
+    const double m = (double) cic->delay;
+    const double r = (double) cic->ratio;
+    return pow(fabs(sin(M_PI * f * m) / (r * m * sin(M_PI * f / r))), (double) cic->order);
+}
+
+bool cic_design_compensator(const cic_t* cic, double passband, size_t n_taps, int16_t* taps) {
+    if (0 == n_taps || n_taps > CIC_MAX_COMPENSATOR) {
+        return false;
+    }
+
+    const double edge   = 0.5 * passband;
+    const double stop   = 2.0 * edge < 0.5 ? 2.0 * edge : 0.5;
+    const double center = 0.5 * (double) (n_taps - 1);
+    double       h[CIC_MAX_COMPENSATOR];
+
+    // Desired response: 1 / H up to the edge, then a raised-cosine taper to zero at stop
+    double desired[CIC_DESIGN_GRID];
+    for (size_t i = 0; i < CIC_DESIGN_GRID; ++i) {
+        const double f = 0.5 * ((double) i + 0.5) / CIC_DESIGN_GRID;
+        const double g = cic_response(cic, f < edge ? f : edge);
+        double       d = g > 1.0 / CIC_DESIGN_BOOST ? 1.0 / g : CIC_DESIGN_BOOST;
+        if (f > edge) {
+            d *= f >= stop ? 0.0 : 0.5 + 0.5 * cos(M_PI * (f - edge) / (stop - edge));
+        }
+        desired[i] = d;
+    }
+
+    // Frequency sampling of the even-symmetric response under a Hamming window
+    double sum = 0.0;
+    for (size_t k = 0; k < n_taps; ++k) {
+        double acc = 0.0;
+        for (size_t i = 0; i < CIC_DESIGN_GRID; ++i) {
+            const double f = 0.5 * ((double) i + 0.5) / CIC_DESIGN_GRID;
+            acc += desired[i] * cos(2.0 * M_PI * f * ((double) k - center));
+        }
+        const double phase  = n_taps > 1 ? 2.0 * M_PI * (double) k / (double) (n_taps - 1) : 0.0;
+        const double window = n_taps > 1 ? 0.54 - 0.46 * cos(phase) : 1.0;
+        h[k]                = acc / CIC_DESIGN_GRID * window;
+        sum += h[k];
+    }
+
+    // Unity DC gain; rounding error goes to the center tap so the integer taps sum to 1.0
+    int32_t total = 0;
+    for (size_t k = 0; k < n_taps; ++k) {
+        const long v = lround(h[k] / sum * 32768.0);
+        taps[k]      = (int16_t) (v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v));
+        total += taps[k];
+    }
+    int32_t fixed    = taps[n_taps / 2] + 32768 - total;
+    fixed            = fixed < INT16_MIN ? INT16_MIN : (fixed > INT16_MAX ? INT16_MAX : fixed);
+    taps[n_taps / 2] = (int16_t) fixed;
+    return true;
+}
+
+/*
+ * Scalar kernels
+ */
+
+static inline int32_t cic_normalize(const cic_t* cic, uint64_t v) {
+    const uint64_t round = cic->shift ? UINT64_C(1) << (cic->shift - 1) : 0;
+    if (cic->multiplier) {
+        // floor(v * m / 2^31) from the halves of v, before the only rounding shift.
+        // Negative sums use m - 1, below 2^(31 + shift) / gain, to keep the error positive.
+        const int64_t  m  = cic->multiplier - ((int64_t) v < 0);
+        const int64_t  hi = (int64_t) v >> 32;
+        const uint64_t lo = v & UINT64_C(0xFFFFFFFF);
+        v                 = ((uint64_t) (hi * m) << 1) + ((lo * (uint64_t) m) >> Q31_SIZE);
+    }
+    return (int32_t) ((int64_t) (v + round) >> cic->shift);
+}
+
+static void cic_decimate_channels(
+    cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst, size_t begin, size_t end
+) {
+    const size_t nch = cic->n_channels;
+
+    for (size_t c = begin; c < end; ++c) {
+        uint64_t integ[CIC_MAX_ORDER];
+        for (size_t i = 0; i < cic->order; ++i) {
+            integ[i] = cic->integrators[i * nch + c];
+        }
+
+        size_t phase = cic->phase;
+        size_t index = cic->comb_index;
+        size_t out   = 0;
+        for (size_t s = 0; s < n; ++s) {
+            uint64_t v = (uint64_t) (int64_t) src[s * nch + c];
+            for (size_t i = 0; i < cic->order; ++i) {
+                integ[i] += v;
+                v = integ[i];
+            }
+
+            if (++phase == cic->ratio) {
+                phase = 0;
+                for (size_t j = 0; j < cic->order; ++j) {
+                    uint64_t*      slot = cic->combs + (j * cic->delay + index) * nch + c;
+                    const uint64_t old  = *slot;
+                    *slot               = v;
+                    v -= old;
+                }
+                index                = index + 1 == cic->delay ? 0 : index + 1;
+                dst[out++ * nch + c] = cic_normalize(cic, v);
+            }
+        }
+
+        for (size_t i = 0; i < cic->order; ++i) {
+            cic->integrators[i * nch + c] = integ[i];
+        }
+    }
+}
+
+static void cic_interpolate_channels(
+    cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst, size_t begin, size_t end
+) {
+    const size_t nch = cic->n_channels;
+
+    for (size_t c = begin; c < end; ++c) {
+        uint64_t integ[CIC_MAX_ORDER];
+        for (size_t i = 0; i < cic->order; ++i) {
+            integ[i] = cic->integrators[i * nch + c];
+        }
+
+        size_t index = cic->comb_index;
+        for (size_t s = 0; s < n; ++s) {
+            uint64_t v = (uint64_t) (int64_t) src[s * nch + c];
+            for (size_t j = 0; j < cic->order; ++j) {
+                uint64_t*      slot = cic->combs + (j * cic->delay + index) * nch + c;
+                const uint64_t old  = *slot;
+                *slot               = v;
+                v -= old;
+            }
+            index = index + 1 == cic->delay ? 0 : index + 1;
+
+            // Zero stuffing: only the first of ratio outputs sees the comb output
+            for (size_t p = 0; p < cic->ratio; ++p) {
+                uint64_t x = p ? 0 : v;
+                for (size_t i = 0; i < cic->order; ++i) {
+                    integ[i] += x;
+                    x = integ[i];
+                }
+                dst[(s * cic->ratio + p) * nch + c] = cic_normalize(cic, x);
+            }
+        }
+
+        for (size_t i = 0; i < cic->order; ++i) {
+            cic->integrators[i * nch + c] = integ[i];
+        }
+    }
+}
+
+static inline int32_t cic_saturate(int64_t x) {
+    return (int32_t) (x < INT32_MIN ? INT32_MIN : (x > INT32_MAX ? INT32_MAX : x));
+}
+
+// Ring slot holding the sample t frames before the one at position
+static inline size_t cic_fir_slot(const cic_t* cic, size_t position, size_t t) {
+    return position >= t ? position - t : position + cic->n_taps - t;
+}
+
+static void cic_compensate_channels(
+    cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst, size_t begin, size_t end
+) {
+    const size_t nch = cic->n_channels;
+
+    for (size_t c = begin; c < end; ++c) {
+        size_t position = cic->fir_index;
+        for (size_t s = 0; s < n; ++s) {
+            cic->fir_history[position * nch + c] = src[s * nch + c];
+
+            int64_t acc = 0;
+            for (size_t t = 0; t < cic->n_taps; ++t) {
+                const int64_t x = cic->fir_history[cic_fir_slot(cic, position, t) * nch + c];
+                acc += cic->taps[t] * x;
+            }
+            dst[s * nch + c] = cic_saturate((acc + (1 << 14)) >> 15);
+            position         = position + 1 == cic->n_taps ? 0 : position + 1;
+        }
+    }
+}
+
+/*
+ * AVX2 kernels
+ */
+
+#if defined(__AVX2__)
+
+static inline __m256i cic_srai_epi64(__m256i x, int shift) {
+    const __m256i sign  = _mm256_cmpgt_epi64(_mm256_setzero_si256(), x);
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    return _mm256_xor_si256(_mm256_srl_epi64(_mm256_xor_si256(x, sign), count), sign);
+}
+
+static inline __m256i cic_load_epi64(const fixed16_t* src) {
+    return _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) src));
+}
+
+// Low halves of four 64-bit lanes to four int32
+static inline void cic_store_epi64(fixed16_t* dst, __m256i x) {
+    const __m256i lo = _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+    _mm_storeu_si128((__m128i*) dst, _mm256_castsi256_si128(lo));
+}
+
+static inline __m256i cic_normalize_epi64(const cic_t* cic, __m256i v) {
+    const uint64_t round = cic->shift ? UINT64_C(1) << (cic->shift - 1) : 0;
+    if (cic->multiplier) {
+        // Signed high half and unsigned low half of each lane times m, or m - 1 when negative
+        const __m256i m  = _mm256_add_epi64(
+            _mm256_set1_epi64x(cic->multiplier), _mm256_cmpgt_epi64(_mm256_setzero_si256(), v)
+        );
+        const __m256i hi = _mm256_mul_epi32(_mm256_srli_epi64(v, 32), m);
+        const __m256i lo = _mm256_mul_epu32(v, m);
+        v = _mm256_add_epi64(_mm256_slli_epi64(hi, 1), _mm256_srli_epi64(lo, Q31_SIZE));
+    }
+    return cic_srai_epi64(_mm256_add_epi64(v, _mm256_set1_epi64x((int64_t) round)), cic->shift);
+}
+
+static size_t cic_decimate_avx2(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    const size_t nch = cic->n_channels;
+
+    size_t c = 0;
+    for (; c + 4 <= nch; c += 4) {
+        __m256i integ[CIC_MAX_ORDER];
+        for (size_t i = 0; i < cic->order; ++i) {
+            integ[i] = _mm256_loadu_si256((const __m256i*) (cic->integrators + i * nch + c));
+        }
+
+        size_t phase = cic->phase;
+        size_t index = cic->comb_index;
+        size_t out   = 0;
+        for (size_t s = 0; s < n; ++s) {
+            __m256i v = cic_load_epi64(src + s * nch + c);
+            for (size_t i = 0; i < cic->order; ++i) {
+                integ[i] = _mm256_add_epi64(integ[i], v);
+                v        = integ[i];
+            }
+
+            if (++phase == cic->ratio) {
+                phase = 0;
+                for (size_t j = 0; j < cic->order; ++j) {
+                    uint64_t*     comb = cic->combs + (j * cic->delay + index) * nch + c;
+                    __m256i*      slot = (__m256i*) comb;
+                    const __m256i old  = _mm256_loadu_si256(slot);
+                    _mm256_storeu_si256(slot, v);
+                    v = _mm256_sub_epi64(v, old);
+                }
+                index = index + 1 == cic->delay ? 0 : index + 1;
+                cic_store_epi64(dst + out++ * nch + c, cic_normalize_epi64(cic, v));
+            }
+        }
+
+        for (size_t i = 0; i < cic->order; ++i) {
+            _mm256_storeu_si256((__m256i*) (cic->integrators + i * nch + c), integ[i]);
+        }
+    }
+    return c;
+}
+
+static size_t cic_interpolate_avx2(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    const size_t nch = cic->n_channels;
+
+    size_t c = 0;
+    for (; c + 4 <= nch; c += 4) {
+        __m256i integ[CIC_MAX_ORDER];
+        for (size_t i = 0; i < cic->order; ++i) {
+            integ[i] = _mm256_loadu_si256((const __m256i*) (cic->integrators + i * nch + c));
+        }
+
+        size_t index = cic->comb_index;
+        for (size_t s = 0; s < n; ++s) {
+            __m256i v = cic_load_epi64(src + s * nch + c);
+            for (size_t j = 0; j < cic->order; ++j) {
+                __m256i*      slot = (__m256i*) (cic->combs + (j * cic->delay + index) * nch + c);
+                const __m256i old  = _mm256_loadu_si256(slot);
+                _mm256_storeu_si256(slot, v);
+                v = _mm256_sub_epi64(v, old);
+            }
+            index = index + 1 == cic->delay ? 0 : index + 1;
+
+            for (size_t p = 0; p < cic->ratio; ++p) {
+                __m256i x = p ? _mm256_setzero_si256() : v;
+                for (size_t i = 0; i < cic->order; ++i) {
+                    integ[i] = _mm256_add_epi64(integ[i], x);
+                    x        = integ[i];
+                }
+                cic_store_epi64(dst + (s * cic->ratio + p) * nch + c, cic_normalize_epi64(cic, x));
+            }
+        }
+
+        for (size_t i = 0; i < cic->order; ++i) {
+            _mm256_storeu_si256((__m256i*) (cic->integrators + i * nch + c), integ[i]);
+        }
+    }
+    return c;
+}
+
+static size_t cic_compensate_avx2(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    const size_t  nch = cic->n_channels;
+    const __m256i max = _mm256_set1_epi64x(INT32_MAX);
+    const __m256i min = _mm256_set1_epi64x(INT32_MIN);
+
+    size_t c = 0;
+    for (; c + 4 <= nch; c += 4) {
+        size_t position = cic->fir_index;
+        for (size_t s = 0; s < n; ++s) {
+            memcpy(cic->fir_history + position * nch + c, src + s * nch + c, 4 * sizeof(fixed16_t));
+
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t t = 0; t < cic->n_taps; ++t) {
+                const size_t  slot = cic_fir_slot(cic, position, t);
+                const __m256i x    = cic_load_epi64(cic->fir_history + slot * nch + c);
+                const __m256i tap  = _mm256_set1_epi64x(cic->taps[t]);
+                acc                = _mm256_add_epi64(acc, _mm256_mul_epi32(x, tap));
+            }
+
+            __m256i y = cic_srai_epi64(_mm256_add_epi64(acc, _mm256_set1_epi64x(1 << 14)), 15);
+            y         = _mm256_blendv_epi8(y, max, _mm256_cmpgt_epi64(y, max));
+            y         = _mm256_blendv_epi8(y, min, _mm256_cmpgt_epi64(min, y));
+            cic_store_epi64(dst + s * nch + c, y);
+            position = position + 1 == cic->n_taps ? 0 : position + 1;
+        }
+    }
+    return c;
+}
+
+#endif
+
+/*
+ * Drivers
+ */
+
+static void cic_compensate(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    size_t c = 0;
+#if defined(__AVX2__)
+    c = cic_compensate_avx2(cic, src, n, dst);
+#endif
+    cic_compensate_channels(cic, src, n, dst, c, cic->n_channels);
+    cic->fir_index = (cic->fir_index + n) % cic->n_taps;
+}
+
+static size_t cic_decimate(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    size_t c = 0;
+#if defined(__AVX2__)
+    c = cic_decimate_avx2(cic, src, n, dst);
+#endif
+    cic_decimate_channels(cic, src, n, dst, c, cic->n_channels);
+
+    const size_t out = (cic->phase + n) / cic->ratio;
+    cic->phase       = (cic->phase + n) % cic->ratio;
+    cic->comb_index  = (cic->comb_index + out) % cic->delay;
+    return out;
+}
+
+static size_t cic_interpolate(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    size_t c = 0;
+#if defined(__AVX2__)
+    c = cic_interpolate_avx2(cic, src, n, dst);
+#endif
+    cic_interpolate_channels(cic, src, n, dst, c, cic->n_channels);
+
+    cic->comb_index = (cic->comb_index + n) % cic->delay;
+    return n * cic->ratio;
+}
+
+size_t cic_process(cic_t* cic, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    PROFILE_BEGIN(sample);
+
+    size_t out = 0;
+    if (CIC_DECIMATE == cic->mode) {
+        out = cic_decimate(cic, src, n, dst);
+        if (cic->taps) {
+            cic_compensate(cic, dst, out, dst);
+        }
+    } else if (!cic->taps) {
+        out = cic_interpolate(cic, src, n, dst);
+    } else {
+        for (size_t s = 0; s < n; s += CIC_BLOCK) {
+            const size_t block = n - s < CIC_BLOCK ? n - s : CIC_BLOCK;
+            cic_compensate(cic, src + s * cic->n_channels, block, cic->scratch);
+            out += cic_interpolate(cic, cic->scratch, block, dst + out * cic->n_channels);
+        }
+    }
+
+    PROFILE_END(
+        sample, PROFILE_CIC, n * cic->n_channels, (n + out) * cic->n_channels * sizeof(fixed16_t)
+    );
+    return out;
+}
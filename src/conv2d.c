@@ -0,0 +1,536 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/conv2d.c
+ *
+ * @brief im2col and depthwise integer convolution with fused requantization.
+ *
+ * Patch rows and weights are both widened to int16 so that one
+ * _mm256_madd_epi16 multiplies a broadcast pair of patch values against a
+ * pair of taps for all CONV2D_NR channels of a panel. A panel step is 16
+ * int16 values: channel j's taps k and k + 1 sit at positions 2j and 2j + 1.
+ * The int8 input zero point is subtracted while lowering, so padding is
+ * plain zeros and the GEMM needs no correction terms.
+ *
+ * The int32 accumulators are protected by a pre-shift chosen per call from
+ * the patch length and the largest possible term: every madd pair (or
+ * depthwise product) is rounded down by that many bits before it is summed,
+ * and the epilogue's shifts and biases are adjusted to match. Layers within
+ * the lossless range use a pre-shift of 0 and the plain kernels.
+ *
+ * Work is split over tiles of CONV2D_TILE_M output pixels. Each worker owns
+ * one patch buffer and one accumulator tile, and the epilogue runs on the
+ * tile while it is still in cache.
+ */
+
+#include "conv2d.h"
+#include "parallel.h"
+#include "profile.h"
+#include "requantize_kernel.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+typedef struct {
+    const conv2d_shape_t*    shape;
+    conv2d_type_t            src_type;
+    const void*              src;
+    const conv2d_weights_t*  weights;
+    const int8_t*            w;
+    const conv2d_epilogue_t* epilogue;
+    conv2d_type_t            dst_type;
+    void*                    dst;
+    size_t                   out_h;
+    size_t                   out_w;
+    size_t                   n_pad;
+    int                      pre_shift; // Bits dropped from each term before it is summed
+    const int32_t*           bias;      // Epilogue bias and shifts adjusted for pre_shift
+    const int32_t*           shift;
+    int16_t*                 patches;
+    int32_t*                 acc;
+} conv2d_task_t;
+
+static inline size_t conv2d_step(size_t x) {
+    return x ? x : 1;
+}
+
+// Input row of output row oy and kernel row ky; padding wraps around to out-of-range values
+static inline size_t conv2d_input_y(const conv2d_shape_t* s, size_t oy, size_t ky) {
+    return oy * conv2d_step(s->stride_h) + ky * conv2d_step(s->dilation_h) - s->pad_h;
+}
+
+// Input column of output column ox and kernel column kx, like conv2d_input_y()
+static inline size_t conv2d_input_x(const conv2d_shape_t* s, size_t ox, size_t kx) {
+    return ox * conv2d_step(s->stride_w) + kx * conv2d_step(s->dilation_w) - s->pad_w;
+}
+
+size_t conv2d_out_height(const conv2d_shape_t* shape) {
+    const size_t span = conv2d_step(shape->dilation_h) * (shape->kernel_h - 1) + 1;
+    const size_t full = shape->height + 2 * shape->pad_h;
+    return full < span ? 0 : (full - span) / conv2d_step(shape->stride_h) + 1;
+}
+
+size_t conv2d_out_width(const conv2d_shape_t* shape) {
+    const size_t span = conv2d_step(shape->dilation_w) * (shape->kernel_w - 1) + 1;
+    const size_t full = shape->width + 2 * shape->pad_w;
+    return full < span ? 0 : (full - span) / conv2d_step(shape->stride_w) + 1;
+}
+
+quant_multiplier_t conv2d_multiplier(
+    fixed16_t input_scale, fixed16_t weight_scale, fixed16_t output_scale
+) {
+    quant_multiplier_t m = {0, 0};
+    if (input_scale <= 0 || weight_scale <= 0 || output_scale <= 0) {
+        return m;
+    }
+
+    // real = num / den * 2^-16 with num in Q32; normalizing num first keeps 31 quotient bits
+    const int      up  = __builtin_clzll((uint64_t) input_scale * (uint64_t) weight_scale) - 1;
+    const uint64_t num = ((uint64_t) input_scale * (uint64_t) weight_scale) << up;
+    uint64_t       q   = num / (uint64_t) output_scale;
+
+    // Round q to 31 bits: real = q * 2^exponent
+    const int down     = 63 - __builtin_clzll(q) - 30;
+    int       exponent = down - FIXED_SIZE - up;
+    q                  = (q + (UINT64_C(1) << (down - 1))) >> down;
+    if (q >> 31) {
+        q >>= 1;
+        exponent++;
+    }
+
+    // Multipliers too small for a 31-bit shift round to zero
+    if (-(exponent + Q31_SIZE) > 31) {
+        return m;
+    }
+
+    // fixed_mul_shift() shifts left by at most 31; larger reals saturate any nonzero input anyway
+    if (exponent + Q31_SIZE > 31) {
+        m.multiplier = INT32_MAX;
+        m.shift      = -31;
+        return m;
+    }
+
+    m.multiplier = (int32_t) q;
+    m.shift      = -(exponent + Q31_SIZE);
+    return m;
+}
+
+conv2d_weights_t* malloc_conv2d_weights(const conv2d_shape_t* shape, const int8_t* w) {
+    conv2d_weights_t* weights = (conv2d_weights_t*) calloc(1, sizeof(conv2d_weights_t));
+    if (!weights) {
+        return NULL;
+    }
+
+    const size_t n_panels = (shape->out_channels + CONV2D_NR - 1) / CONV2D_NR;
+    weights->out_channels = shape->out_channels;
+    weights->k            = shape->kernel_h * shape->kernel_w * shape->in_channels;
+    weights->k_pad        = (weights->k + 1) & ~(size_t) 1;
+    const size_t n_values = n_panels * weights->k_pad * CONV2D_NR;
+    weights->panels       = (int16_t*) calloc(n_values, sizeof(int16_t));
+    if (!weights->panels) {
+        free(weights);
+        return NULL;
+    }
+
+    for (size_t o = 0; o < shape->out_channels; ++o) {
+        int16_t* panel = weights->panels + (o / CONV2D_NR) * weights->k_pad * CONV2D_NR;
+        for (size_t k = 0; k < weights->k; ++k) {
+            panel[(k / 2) * 2 * CONV2D_NR + (o % CONV2D_NR) * 2 + (k & 1)] = w[o * weights->k + k];
+        }
+    }
+    return weights;
+}
+
+void free_conv2d_weights(conv2d_weights_t* weights) {
+    if (weights) {
+        free(weights->panels);
+        free(weights);
+    }
+}
+
+/*
+ * Lowering
+ */
+
+// Input pixel (b, y, x) as int16 with the zero point removed; channels [0, n)
+static inline void conv2d_load_pixel(
+    const conv2d_task_t* task, size_t b, size_t y, size_t x, int16_t* out
+) {
+    const conv2d_shape_t* s      = task->shape;
+    const size_t          offset = ((b * s->height + y) * s->width + x) * s->in_channels;
+
+    if (CONV2D_Q15 == task->src_type) {
+        memcpy(out, (const int16_t*) task->src + offset, s->in_channels * sizeof(int16_t));
+        return;
+    }
+
+    const int8_t* in = (const int8_t*) task->src + offset;
+    const int16_t zp = (int16_t) task->epilogue->input_zero_point;
+    size_t        c  = 0;
+#if defined(__AVX2__)
+    const __m256i vz = _mm256_set1_epi16(zp);
+    for (; c + 16 <= s->in_channels; c += 16) {
+        const __m256i v = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (in + c)));
+        _mm256_storeu_si256((__m256i*) (out + c), _mm256_sub_epi16(v, vz));
+    }
+#endif
+    for (; c < s->in_channels; ++c) {
+        out[c] = (int16_t) (in[c] - zp);
+    }
+}
+
+// Patch row of output pixel m: kernel_h x kernel_w x in_channels values, zero padded to k_pad
+static void conv2d_lower(const conv2d_task_t* task, size_t m, int16_t* row) {
+    const conv2d_shape_t* s  = task->shape;
+    const size_t          ox = m % task->out_w;
+    const size_t          oy = (m / task->out_w) % task->out_h;
+    const size_t          b  = m / (task->out_w * task->out_h);
+    const size_t          c  = s->in_channels;
+
+    for (size_t ky = 0; ky < s->kernel_h; ++ky) {
+        // Unsigned wrap-around turns negative padded coordinates into out-of-range ones
+        const size_t y = conv2d_input_y(s, oy, ky);
+        for (size_t kx = 0; kx < s->kernel_w; ++kx) {
+            const size_t x   = conv2d_input_x(s, ox, kx);
+            int16_t*     out = row + (ky * s->kernel_w + kx) * c;
+            if (y < s->height && x < s->width) {
+                conv2d_load_pixel(task, b, y, x, out);
+            } else {
+                memset(out, 0, c * sizeof(int16_t));
+            }
+        }
+    }
+
+    if (task->weights->k_pad > task->weights->k) {
+        row[task->weights->k] = 0;
+    }
+}
+
+/*
+ * GEMM micro-kernels
+ */
+
+// Term rounded down by pre_shift bits, half up
+static inline int32_t conv2d_term(int32_t x, int pre_shift) {
+    return pre_shift ? (x + (1 << (pre_shift - 1))) >> pre_shift : x;
+}
+
+// acc[r][j] = patches[r] . panel channel j, for rows patch rows and one panel
+static void conv2d_panel(
+    const int16_t* patches,
+    size_t         rows,
+    size_t         k_pad,
+    const int16_t* panel,
+    int32_t*       acc,
+    size_t         ldc,
+    int            pre_shift
+) {
+    size_t r = 0;
+
+#if defined(__AVX2__)
+    const __m256i round = _mm256_set1_epi32(pre_shift ? 1 << (pre_shift - 1) : 0);
+    const __m128i count = _mm_cvtsi32_si128(pre_shift);
+
+    for (; r + CONV2D_MR <= rows; r += CONV2D_MR) {
+        __m256i sum[CONV2D_MR];
+        for (int i = 0; i < CONV2D_MR; ++i) {
+            sum[i] = _mm256_setzero_si256();
+        }
+
+        for (size_t kk = 0; kk < k_pad / 2; ++kk) {
+            const __m256i w = _mm256_loadu_si256((const __m256i*) (panel + kk * 2 * CONV2D_NR));
+            for (int i = 0; i < CONV2D_MR; ++i) {
+                int32_t pair;
+                memcpy(&pair, patches + (r + i) * k_pad + 2 * kk, sizeof(pair));
+                __m256i term = _mm256_madd_epi16(_mm256_set1_epi32(pair), w);
+                if (pre_shift) {
+                    term = _mm256_sra_epi32(_mm256_add_epi32(term, round), count);
+                }
+                sum[i] = _mm256_add_epi32(sum[i], term);
+            }
+        }
+
+        for (int i = 0; i < CONV2D_MR; ++i) {
+            _mm256_storeu_si256((__m256i*) (acc + (r + i) * ldc), sum[i]);
+        }
+    }
+#endif
+
+    for (; r < rows; ++r) {
+        const int16_t* a = patches + r * k_pad;
+        for (size_t j = 0; j < CONV2D_NR; ++j) {
+            int32_t sum = 0;
+            for (size_t kk = 0; kk < k_pad / 2; ++kk) {
+                const int16_t* w = panel + kk * 2 * CONV2D_NR + 2 * j;
+                sum += conv2d_term(a[2 * kk] * w[0] + a[2 * kk + 1] * w[1], pre_shift);
+            }
+            acc[r * ldc + j] = sum;
+        }
+    }
+}
+
+/*
+ * Epilogue
+ */
+
+// Bias, ReLU and requantization of rows x channels accumulators with row stride ldc
+static void conv2d_epilogue(
+    const conv2d_task_t* task, int32_t* acc, size_t rows, size_t ldc, size_t first_row
+) {
+    const conv2d_epilogue_t* e = task->epilogue;
+    const size_t             n = task->shape->out_channels;
+
+    for (size_t r = 0; r < rows; ++r) {
+        int32_t* row = acc + r * ldc;
+
+        // Requantization is monotonic and maps 0 to the zero point: ReLU can act on the accumulator
+        if (task->bias || e->relu) {
+            for (size_t c = 0; c < n; ++c) {
+                int64_t v = (int64_t) row[c] + (task->bias ? task->bias[c] : 0);
+                v         = v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : v);
+                row[c]    = e->relu && v < 0 ? 0 : (int32_t) v;
+            }
+        }
+
+        if (CONV2D_I8 == task->dst_type) {
+            int8_t* out = (int8_t*) task->dst + (first_row + r) * n;
+            requantize_rows_kernel(
+                row, out, 1, n, NULL, e->multiplier, task->shift, e->output_zero_point
+            );
+        } else {
+            int16_t* out = (int16_t*) task->dst + (first_row + r) * n;
+            for (size_t c = 0; c < n; ++c) {
+                int32_t v = fixed_mul_shift(row[c], e->multiplier[c], task->shift[c]);
+                v         = v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v);
+                out[c]    = (int16_t) v;
+            }
+        }
+    }
+}
+
+/*
+ * Drivers
+ */
+
+static void conv2d_tiles(void* ctx, size_t begin, size_t end, size_t thread) {
+    const conv2d_task_t*    task    = (const conv2d_task_t*) ctx;
+    const conv2d_weights_t* weights = task->weights;
+    const size_t            m_total = task->shape->batch * task->out_h * task->out_w;
+    int16_t*                patches = task->patches + thread * CONV2D_TILE_M * weights->k_pad;
+    int32_t*                acc     = task->acc + thread * CONV2D_TILE_M * task->n_pad;
+
+    for (size_t tile = begin; tile < end; ++tile) {
+        const size_t first = tile * CONV2D_TILE_M;
+        const size_t rows  = m_total - first < CONV2D_TILE_M ? m_total - first : CONV2D_TILE_M;
+
+        for (size_t r = 0; r < rows; ++r) {
+            conv2d_lower(task, first + r, patches + r * weights->k_pad);
+        }
+
+        for (size_t p = 0; p < task->n_pad / CONV2D_NR; ++p) {
+            conv2d_panel(
+                patches,
+                rows,
+                weights->k_pad,
+                weights->panels + p * weights->k_pad * CONV2D_NR,
+                acc + p * CONV2D_NR,
+                task->n_pad,
+                task->pre_shift
+            );
+        }
+
+        conv2d_epilogue(task, acc, rows, task->n_pad, first);
+    }
+}
+
+static void conv2d_depthwise_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const conv2d_task_t*  task = (const conv2d_task_t*) ctx;
+    const conv2d_shape_t* s    = task->shape;
+    const size_t          c    = s->in_channels;
+    int16_t*              in   = task->patches + thread * 2 * task->n_pad;
+    int32_t*              acc  = task->acc + thread * task->n_pad;
+
+#if defined(__AVX2__)
+    const __m256i round = _mm256_set1_epi32(task->pre_shift ? 1 << (task->pre_shift - 1) : 0);
+    const __m128i count = _mm_cvtsi32_si128(task->pre_shift);
+#endif
+
+    // One task is one output row of one image
+    for (size_t row = begin; row < end; ++row) {
+        const size_t b  = row / task->out_h;
+        const size_t oy = row % task->out_h;
+
+        for (size_t ox = 0; ox < task->out_w; ++ox) {
+            memset(acc, 0, c * sizeof(int32_t));
+
+            for (size_t ky = 0; ky < s->kernel_h; ++ky) {
+                const size_t y = conv2d_input_y(s, oy, ky);
+                if (y >= s->height) {
+                    continue;
+                }
+                for (size_t kx = 0; kx < s->kernel_w; ++kx) {
+                    const size_t x = conv2d_input_x(s, ox, kx);
+                    if (x >= s->width) {
+                        continue;
+                    }
+
+                    conv2d_load_pixel(task, b, y, x, in);
+                    const int8_t* w = task->w + (ky * s->kernel_w + kx) * c;
+                    size_t        i = 0;
+#if defined(__AVX2__)
+                    for (; i + 8 <= c; i += 8) {
+                        const __m128i x8 = _mm_loadu_si128((const __m128i*) (in + i));
+                        const __m128i w8 = _mm_loadl_epi64((const __m128i*) (w + i));
+                        const __m256i v  = _mm256_cvtepi16_epi32(x8);
+                        const __m256i wv = _mm256_cvtepi8_epi32(w8);
+                        const __m256i a  = _mm256_loadu_si256((const __m256i*) (acc + i));
+                        __m256i       t  = _mm256_mullo_epi32(v, wv);
+                        if (task->pre_shift) {
+                            t = _mm256_sra_epi32(_mm256_add_epi32(t, round), count);
+                        }
+                        _mm256_storeu_si256((__m256i*) (acc + i), _mm256_add_epi32(a, t));
+                    }
+#endif
+                    for (; i < c; ++i) {
+                        acc[i] += conv2d_term(in[i] * w[i], task->pre_shift);
+                    }
+                }
+            }
+
+            conv2d_epilogue(task, acc, 1, task->n_pad, row * task->out_w + ox);
+        }
+    }
+}
+
+// Smallest pre-shift for which terms sums of magnitude up to 2^term_bits fit in int32
+static int conv2d_pre_shift(size_t terms, int term_bits) {
+    int shift = 0;
+    while (shift < term_bits && terms >= (size_t) 1 << (31 - term_bits + shift)) {
+        shift++;
+    }
+    return shift;
+}
+
+static bool conv2d_run(conv2d_task_t* task, bool depthwise, size_t n_threads) {
+    const conv2d_shape_t*    s = task->shape;
+    const conv2d_epilogue_t* e = task->epilogue;
+    task->out_h                = conv2d_out_height(s);
+    task->out_w                = conv2d_out_width(s);
+    task->n_pad                = (s->out_channels + CONV2D_NR - 1) / CONV2D_NR * CONV2D_NR;
+
+    // Largest term: |x| <= 2^15 for Q15 or 255 for zero-point shifted int8, times |w| <= 2^7,
+    // doubled for the madd pairs of the im2col kernel
+    const int term_bits = (CONV2D_Q15 == task->src_type ? 22 : 15) + (depthwise ? 0 : 1);
+    const size_t terms  = depthwise ? s->kernel_h * s->kernel_w : task->weights->k_pad / 2;
+    task->pre_shift     = conv2d_pre_shift(terms, term_bits);
+    task->bias          = e->bias;
+    task->shift         = e->shift;
+
+    // Accumulators are 2^-pre_shift of the true sums: scale the bias and shift right by less
+    int32_t* adjusted = NULL;
+    if (task->pre_shift) {
+        adjusted = (int32_t*) malloc(2 * s->out_channels * sizeof(int32_t));
+        if (!adjusted) {
+            return false;
+        }
+        for (size_t c = 0; c < s->out_channels; ++c) {
+            const int32_t shift           = e->shift[c] - task->pre_shift;
+            adjusted[c]                   = shift < -31 ? -31 : shift;
+            adjusted[s->out_channels + c] = e->bias ? conv2d_term(e->bias[c], task->pre_shift) : 0;
+        }
+        task->shift = adjusted;
+        task->bias  = e->bias ? adjusted + s->out_channels : NULL;
+    }
+
+    const size_t m_total   = s->batch * task->out_h * task->out_w;
+    const size_t n_tiles   = (m_total + CONV2D_TILE_M - 1) / CONV2D_TILE_M;
+    const size_t n_tasks   = depthwise ? s->batch * task->out_h : n_tiles;
+    const size_t n_workers = 0 == n_threads ? parallel_thread_count() : n_threads;
+    const size_t n_patches = depthwise ? 2 * task->n_pad : CONV2D_TILE_M * task->weights->k_pad;
+    const size_t n_acc     = depthwise ? task->n_pad : CONV2D_TILE_M * task->n_pad;
+
+    task->patches = (int16_t*) malloc(n_workers * n_patches * sizeof(int16_t));
+    task->acc     = (int32_t*) malloc(n_workers * n_acc * sizeof(int32_t));
+    if (!task->patches || !task->acc) {
+        free(task->patches);
+        free(task->acc);
+        free(adjusted);
+        return false;
+    }
+
+    PROFILE_BEGIN(sample);
+
+    parallel_fn_t fn = depthwise ? conv2d_depthwise_rows : conv2d_tiles;
+    if (1 == n_workers) {
+        fn(task, 0, n_tasks, 0);
+    } else {
+        parallel_for(n_tasks, 0, n_workers, fn, task);
+    }
+
+    PROFILE_END(
+        sample,
+        PROFILE_CONV2D,
+        m_total * s->out_channels * s->kernel_h * s->kernel_w * (depthwise ? 1 : s->in_channels),
+        s->batch * s->height * s->width * s->in_channels * (CONV2D_Q15 == task->src_type ? 2 : 1)
+            + m_total * s->out_channels * (CONV2D_Q15 == task->dst_type ? 2 : 1)
+    );
+
+    free(task->patches);
+    free(task->acc);
+    free(adjusted);
+    return true;
+}
+
+bool conv2d(
+    const conv2d_shape_t*    shape,
+    conv2d_type_t            src_type,
+    const void*              src,
+    const conv2d_weights_t*  weights,
+    const conv2d_epilogue_t* epilogue,
+    conv2d_type_t            dst_type,
+    void*                    dst,
+    size_t                   n_threads
+) {
+    assert(weights->out_channels == shape->out_channels);
+    assert(weights->k == shape->kernel_h * shape->kernel_w * shape->in_channels);
+
+    conv2d_task_t task = {
+        .shape    = shape,
+        .src_type = src_type,
+        .src      = src,
+        .weights  = weights,
+        .epilogue = epilogue,
+        .dst_type = dst_type,
+        .dst      = dst,
+    };
+    return conv2d_run(&task, false, n_threads);
+}
+
+bool conv2d_depthwise(
+    const conv2d_shape_t*    shape,
+    conv2d_type_t            src_type,
+    const void*              src,
+    const int8_t*            w,
+    const conv2d_epilogue_t* epilogue,
+    conv2d_type_t            dst_type,
+    void*                    dst,
+    size_t                   n_threads
+) {
+    assert(shape->out_channels == shape->in_channels);
+
+    conv2d_task_t task = {
+        .shape    = shape,
+        .src_type = src_type,
+        .src      = src,
+        .w        = w,
+        .epilogue = epilogue,
+        .dst_type = dst_type,
+        .dst      = dst,
+    };
+    return conv2d_run(&task, true, n_threads);
+}
@@ -0,0 +1,300 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/fixed_math.c
+ *
+ * @brief Integer-only log2, exp2, pow and rsqrt for fixed16_t.
+ *
+ * Every function has the same shape. The argument's most significant bit
+ * splits off a power of two, which is exact, and leaves a reduced argument in
+ * Q28. A minimax polynomial of that reduced argument is then evaluated with
+ * fixed_poly_eval(). All values stay within 32 bits between steps, so the
+ * AVX2 path can run the identical arithmetic on eight lanes and produce the
+ * same bits.
+ *
+ * Coefficients are the minimax fits below, rounded to Q28:
+ *
+ * - log2(1 + t),    t in [0, 1),    degree 6, absolute error 1.8e-6
+ * - 2^t,            t in [0, 1),    degree 5, relative error 7.5e-8
+ * - 0.5 / sqrt(u),  u in [1/4, 1),  degree 3, relative error 7.0e-3 before Newton
+ *
+ * The rsqrt fit takes u = m / 4 rather than m in [1, 4), so that the x^2 of
+ * the Estrin scheme stays below 1 in Q28.
+ */
+
+#include "fixed_math.h"
+#include "fixed_poly.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#define FIXED_MATH_ONE (INT32_C(1) << FIXED_MATH_Q)
+
+static const int32_t fixed_log2_coeffs[] = {
+    FIXED_POLY_COEFF(1.845686687e-06, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(1.442495316, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(-0.7177910762, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.4565216601, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(-0.2765407399, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.1210022375, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(-0.02569108882, FIXED_MATH_Q),
+};
+
+static const int32_t fixed_exp2_coeffs[] = {
+    FIXED_POLY_COEFF(0.9999999251, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.6931530732, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.240153617, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.05582631805, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.00898934009, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(0.001877576675, FIXED_MATH_Q),
+};
+
+static const int32_t fixed_rsqrt_coeffs[] = {
+    FIXED_POLY_COEFF(1.556187102, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(-2.955452196, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(3.114971258, FIXED_MATH_Q),
+    FIXED_POLY_COEFF(-1.219226493, FIXED_MATH_Q),
+};
+
+static const fixed_poly_t fixed_log2_poly  = FIXED_POLY_INIT(fixed_log2_coeffs, FIXED_MATH_Q);
+static const fixed_poly_t fixed_exp2_poly  = FIXED_POLY_INIT(fixed_exp2_coeffs, FIXED_MATH_Q);
+static const fixed_poly_t fixed_rsqrt_poly = FIXED_POLY_INIT(fixed_rsqrt_coeffs, FIXED_MATH_Q);
+
+/*
+ * Scalar kernels
+ */
+
+static inline int msb(fixed16_t x) {
+    return 31 - __builtin_clz((uint32_t) x);
+}
+
+// Normalizes x > 0 to [1, 2) in Q28; the exponent of the leading bit is returned in e
+static inline int32_t log2_mantissa(fixed16_t x, int* e) {
+    const int top = msb(x);
+    *e            = top - FIXED_SIZE;
+    return (top > FIXED_MATH_Q ? x >> (top - FIXED_MATH_Q) : x << (FIXED_MATH_Q - top));
+}
+
+// log2(x) for x > 0 with FIXED_MATH_Q fractional bits, as an exponent and a fraction
+static inline int32_t log2_fraction(fixed16_t x, int* e) {
+    const int32_t m = log2_mantissa(x, e);
+    return fixed_poly_eval(&fixed_log2_poly, m - FIXED_MATH_ONE);
+}
+
+// 2^(i + f) for a Q28 fraction f in [0, 1), rounded to fixed16_t
+static inline fixed16_t exp2_scale(int32_t i, int32_t f) {
+    if (i >= 15) {
+        return INT32_MAX;
+    }
+
+    const int32_t p     = fixed_poly_eval(&fixed_exp2_poly, f);
+    const int32_t shift = FIXED_MATH_Q - FIXED_SIZE - i;
+    if (shift <= 0) {
+        return p << -shift;
+    }
+    if (shift >= 32) {
+        return 0;
+    }
+    return (fixed16_t) (((int64_t) p + (INT64_C(1) << (shift - 1))) >> shift);
+}
+
+fixed16_t fixed_log2(fixed16_t x) {
+    if (x <= 0) {
+        return INT32_MIN;
+    }
+
+    int           e;
+    const int32_t p     = log2_fraction(x, &e);
+    const int     shift = FIXED_MATH_Q - FIXED_SIZE;
+    // e is negative below 1.0, so it is scaled by multiplication rather than a left shift
+    return e * FIXED_VAL + ((p + (1 << (shift - 1))) >> shift);
+}
+
+fixed16_t fixed_exp2(fixed16_t x) {
+    const int32_t i = x >> FIXED_SIZE;
+    const int32_t f = (x & (FIXED_VAL - 1)) << (FIXED_MATH_Q - FIXED_SIZE);
+    return exp2_scale(i, f);
+}
+
+fixed16_t fixed_pow(fixed16_t x, fixed16_t y) {
+    if (x <= 0) {
+        if (x < 0) {
+            return 0;
+        }
+        return y > 0 ? 0 : (0 == y ? FIXED_VAL : INT32_MAX);
+    }
+
+    // log2(x) in Q26 is below 2^30 in magnitude, so the product with y fits 62 bits
+    int           e;
+    const int32_t p     = log2_fraction(x, &e);
+    const int64_t l     = (int64_t) e * (INT64_C(1) << 26) + (p >> (FIXED_MATH_Q - 26));
+    const int64_t z     = (l * y) >> (26 + FIXED_SIZE - FIXED_MATH_Q); // Q28
+    const int64_t i     = z >> FIXED_MATH_Q;
+    const int32_t f     = (int32_t) (z & (FIXED_MATH_ONE - 1));
+    const int32_t clamp = i < -64 ? -64 : (i > 15 ? 15 : (int32_t) i);
+    return exp2_scale(clamp, f);
+}
+
+fixed16_t fixed_rsqrt(fixed16_t x) {
+    if (x <= 0) {
+        return INT32_MAX;
+    }
+
+    // x = m * 4^k with m in [1, 4), so rsqrt(x) = rsqrt(m) * 2^-k
+    const int     k     = (msb(x) - FIXED_SIZE) >> 1;
+    const int     shift = FIXED_MATH_Q - FIXED_SIZE - 2 * k;
+    const int32_t m     = shift >= 0 ? x << shift : x >> -shift;
+
+    int32_t y = fixed_poly_eval(&fixed_rsqrt_poly, m >> 2);
+    for (int step = 0; step < 2; ++step) {
+        // y = y * (3 - m * y^2) / 2
+        const int32_t my2 = fixed_poly_mul(m, fixed_poly_mul(y, y, FIXED_MATH_Q), FIXED_MATH_Q);
+        y                 = fixed_poly_mul(y, 3 * FIXED_MATH_ONE - my2, FIXED_MATH_Q + 1);
+    }
+
+    const int down = FIXED_MATH_Q - FIXED_SIZE + k;
+    return (y + (1 << (down - 1))) >> down;
+}
+
+/*
+ * AVX2 kernels
+ */
+
+#if defined(__AVX2__)
+
+// Index of the leading bit of positive lanes, from the exponent of the rounded float
+static inline __m256i msb_epi32(__m256i x) {
+    const __m256i exponent = _mm256_sub_epi32(
+        _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(x)), 23), _mm256_set1_epi32(127)
+    );
+
+    // Rounding to 24 bits may carry into the next power of two; compare unsigned
+    const __m256i bias  = _mm256_set1_epi32(INT32_MIN);
+    const __m256i power = _mm256_sllv_epi32(_mm256_set1_epi32(1), exponent);
+    const __m256i over  = _mm256_cmpgt_epi32(
+        _mm256_xor_si256(power, bias), _mm256_xor_si256(x, bias)
+    );
+    return _mm256_add_epi32(exponent, over);
+}
+
+// Shifts left by s, or right by -s, per lane
+static inline __m256i shift_epi32(__m256i x, __m256i s) {
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i left  = _mm256_max_epi32(s, zero);
+    const __m256i right = _mm256_max_epi32(_mm256_sub_epi32(zero, s), zero);
+    return _mm256_srlv_epi32(_mm256_sllv_epi32(x, left), right);
+}
+
+// Rounded right shift of non-negative lanes; counts of 32 or more give 0
+static inline __m256i round_shift_epi32(__m256i x, __m256i s) {
+    const __m256i one  = _mm256_set1_epi32(1);
+    const __m256i half = _mm256_sllv_epi32(one, _mm256_sub_epi32(s, one));
+    return _mm256_srlv_epi32(_mm256_add_epi32(x, half), s);
+}
+
+static inline __m256i log2_epi32(__m256i x) {
+    const __m256i top = msb_epi32(x);
+    const __m256i m   = shift_epi32(x, _mm256_sub_epi32(_mm256_set1_epi32(FIXED_MATH_Q), top));
+    const __m256i p   = fixed_poly_eval_epi32(
+        &fixed_log2_poly, _mm256_sub_epi32(m, _mm256_set1_epi32(FIXED_MATH_ONE))
+    );
+
+    const __m256i e      = _mm256_sub_epi32(top, _mm256_set1_epi32(FIXED_SIZE));
+    const __m256i result = _mm256_add_epi32(
+        _mm256_slli_epi32(e, FIXED_SIZE),
+        _mm256_srai_epi32(
+            _mm256_add_epi32(p, _mm256_set1_epi32(1 << (FIXED_MATH_Q - FIXED_SIZE - 1))),
+            FIXED_MATH_Q - FIXED_SIZE
+        )
+    );
+
+    const __m256i invalid = _mm256_cmpgt_epi32(_mm256_set1_epi32(1), x);
+    return _mm256_blendv_epi8(result, _mm256_set1_epi32(INT32_MIN), invalid);
+}
+
+static inline __m256i exp2_epi32(__m256i x) {
+    const __m256i i = _mm256_srai_epi32(x, FIXED_SIZE);
+    const __m256i f = _mm256_slli_epi32(
+        _mm256_and_si256(x, _mm256_set1_epi32(FIXED_VAL - 1)), FIXED_MATH_Q - FIXED_SIZE
+    );
+    const __m256i p = fixed_poly_eval_epi32(&fixed_exp2_poly, f);
+
+    // Right shifts of 32 or more flush to zero, as in exp2_scale()
+    const __m256i shift = _mm256_sub_epi32(_mm256_set1_epi32(FIXED_MATH_Q - FIXED_SIZE), i);
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i count = _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero);
+    const __m256i left  = _mm256_sllv_epi32(p, count);
+    const __m256i right = round_shift_epi32(p, shift);
+    const __m256i up    = _mm256_cmpgt_epi32(_mm256_set1_epi32(1), shift);
+    const __m256i value = _mm256_blendv_epi8(right, left, up);
+
+    const __m256i saturate = _mm256_cmpgt_epi32(i, _mm256_set1_epi32(14));
+    return _mm256_blendv_epi8(value, _mm256_set1_epi32(INT32_MAX), saturate);
+}
+
+static inline __m256i rsqrt_epi32(__m256i x) {
+    const __m256i e = _mm256_sub_epi32(msb_epi32(x), _mm256_set1_epi32(FIXED_SIZE));
+    const __m256i k = _mm256_srai_epi32(e, 1);
+    const __m256i m = shift_epi32(
+        x, _mm256_sub_epi32(_mm256_set1_epi32(FIXED_MATH_Q - FIXED_SIZE), _mm256_slli_epi32(k, 1))
+    );
+
+    const __m256i three = _mm256_set1_epi32(3 * FIXED_MATH_ONE);
+    __m256i       y     = fixed_poly_eval_epi32(&fixed_rsqrt_poly, _mm256_srai_epi32(m, 2));
+    for (int step = 0; step < 2; ++step) {
+        const __m256i y2  = fixed_poly_mul_epi32(y, y, FIXED_MATH_Q);
+        const __m256i my2 = fixed_poly_mul_epi32(m, y2, FIXED_MATH_Q);
+        y                 = fixed_poly_mul_epi32(y, _mm256_sub_epi32(three, my2), FIXED_MATH_Q + 1);
+    }
+
+    const __m256i down    = _mm256_add_epi32(k, _mm256_set1_epi32(FIXED_MATH_Q - FIXED_SIZE));
+    const __m256i result  = round_shift_epi32(y, down);
+    const __m256i invalid = _mm256_cmpgt_epi32(_mm256_set1_epi32(1), x);
+    return _mm256_blendv_epi8(result, _mm256_set1_epi32(INT32_MAX), invalid);
+}
+
+#endif
+
+/*
+ * Array forms
+ */
+
+void fixed_log2_array(const fixed16_t* x, fixed16_t* y, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+        _mm256_storeu_si256((__m256i*) (y + i), log2_epi32(v));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = fixed_log2(x[i]);
+    }
+}
+
+void fixed_exp2_array(const fixed16_t* x, fixed16_t* y, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+        _mm256_storeu_si256((__m256i*) (y + i), exp2_epi32(v));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = fixed_exp2(x[i]);
+    }
+}
+
+void fixed_rsqrt_array(const fixed16_t* x, fixed16_t* y, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+        _mm256_storeu_si256((__m256i*) (y + i), rsqrt_epi32(v));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = fixed_rsqrt(x[i]);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/fixed_poly.c
+ *
+ * @brief Array and rational forms of the Estrin polynomial evaluator.
+ */
+
+#include "fixed_poly.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+// Saturated (n << q) / d; integer division has no vector form, so this stays scalar
+static inline int32_t rational_divide(int32_t n, int32_t d, int q) {
+    if (0 == d) {
+        return n < 0 ? INT32_MIN : INT32_MAX;
+    }
+
+    const int64_t quotient = ((int64_t) n * (INT64_C(1) << q)) / d;
+    if (quotient > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (quotient < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t) quotient;
+}
+
+void fixed_poly_eval_array(const fixed_poly_t* p, const int32_t* x, int32_t* y, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+        _mm256_storeu_si256((__m256i*) (y + i), fixed_poly_eval_epi32(p, v));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = fixed_poly_eval(p, x[i]);
+    }
+}
+
+int32_t fixed_rational_eval(const fixed_poly_t* num, const fixed_poly_t* den, int32_t x) {
+    return rational_divide(fixed_poly_eval(num, x), fixed_poly_eval(den, x), num->q);
+}
+
+void fixed_rational_eval_array(
+    const fixed_poly_t* num, const fixed_poly_t* den, const int32_t* x, int32_t* y, size_t n
+) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    int32_t n_lanes[8];
+    int32_t d_lanes[8];
+    for (; i + 8 <= n; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+        _mm256_storeu_si256((__m256i*) n_lanes, fixed_poly_eval_epi32(num, v));
+        _mm256_storeu_si256((__m256i*) d_lanes, fixed_poly_eval_epi32(den, v));
+        for (size_t lane = 0; lane < 8; ++lane) {
+            y[i + lane] = rational_divide(n_lanes[lane], d_lanes[lane], num->q);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = fixed_rational_eval(num, den, x[i]);
+    }
+}
@@ -0,0 +1,410 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/float_compare.c
+ *
+ * @brief Bulk approximate-equality and ULP-distance kernels.
+ *
+ * Each chunk is scanned eight elements at a time and produces a count or a
+ * maximum, which is folded into a shared atomic. Counts and maxima do not
+ * depend on the order in which they are combined, so results are identical
+ * for every thread count.
+ */
+
+#include "float_compare.h"
+#include "parallel.h"
+#include "profile.h"
+#include "quantization.h"
+#include "simd_convert.h"
+
+#include <stdatomic.h>
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+typedef enum {
+    COMPARE_ALL,   // stop at the first mismatch
+    COMPARE_COUNT, // count mismatches
+    COMPARE_REL,   // maximum relative error
+} compare_mode_t;
+
+typedef struct {
+    compare_mode_t   mode;
+    data_type_t      type;
+    const uint8_t*   a;
+    const float*     ref;
+    size_t           n;
+    float            tolerance;
+    _Atomic bool     failed;
+    _Atomic size_t   count;
+    _Atomic uint32_t max_bits; // non-negative float maxima order like their bits
+} compare_task_t;
+
+static inline float compare_load(data_type_t type, const uint8_t* x, size_t i) {
+    switch (type) {
+        case TYPE_FLOAT_F16:
+            return decode_float16(((const float16_t*) x)[i]);
+        case TYPE_FLOAT_BF16:
+            return decode_bfloat16(((const bfloat16_t*) x)[i]);
+        default:
+            return ((const float*) x)[i];
+    }
+}
+
+static inline bool compare_close(float a, float ref, float tolerance) {
+    const float diff  = fabsf(a - ref);
+    const float scale = fmaxf(1.0f, fmaxf(fabsf(a), fabsf(ref)));
+    return a == ref || (isfinite(diff) && diff <= tolerance * scale);
+}
+
+static inline float compare_relative(float a, float ref) {
+    if (a == ref) {
+        return 0.0f;
+    }
+    const float rel = fabsf(a - ref) / fabsf(ref);
+    return isnan(rel) ? INFINITY : rel;
+}
+
+static inline void compare_store_max(_Atomic uint32_t* target, float value) {
+    const uint32_t bits    = encode_float32(value);
+    uint32_t       current = atomic_load(target);
+    while (bits > current && !atomic_compare_exchange_weak(target, &current, bits)) {}
+}
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+
+static inline __m256 compare_load_ps(data_type_t type, const uint8_t* x, size_t i) {
+    switch (type) {
+        case TYPE_FLOAT_F16:
+            return simd_load_f16_ps((const float16_t*) x + i);
+        case TYPE_FLOAT_BF16:
+            return simd_load_bf16_ps((const bfloat16_t*) x + i);
+        default:
+            return _mm256_loadu_ps((const float*) x + i);
+    }
+}
+
+// Lane mask of close pairs, matching compare_close()
+static inline __m256 compare_close_ps(__m256 a, __m256 ref, __m256 tolerance) {
+    const __m256 sign  = _mm256_set1_ps(-0.0f);
+    const __m256 diff  = _mm256_andnot_ps(sign, _mm256_sub_ps(a, ref));
+    const __m256 scale = _mm256_max_ps(
+        _mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, ref))
+    );
+    const __m256 within = _mm256_and_ps(
+        _mm256_cmp_ps(diff, _mm256_mul_ps(tolerance, scale), _CMP_LE_OQ),
+        _mm256_cmp_ps(diff, _mm256_set1_ps(INFINITY), _CMP_LT_OQ)
+    );
+    return _mm256_or_ps(_mm256_cmp_ps(a, ref, _CMP_EQ_OQ), within);
+}
+
+// Relative errors, matching compare_relative()
+static inline __m256 compare_relative_ps(__m256 a, __m256 ref) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 rel  = _mm256_div_ps(
+        _mm256_andnot_ps(sign, _mm256_sub_ps(a, ref)), _mm256_andnot_ps(sign, ref)
+    );
+    const __m256 fixed = _mm256_blendv_ps(
+        rel, _mm256_set1_ps(INFINITY), _mm256_cmp_ps(rel, rel, _CMP_UNORD_Q)
+    );
+    return _mm256_blendv_ps(fixed, _mm256_setzero_ps(), _mm256_cmp_ps(a, ref, _CMP_EQ_OQ));
+}
+
+#endif
+
+static inline __attribute__((always_inline)) void compare_range(
+    compare_task_t* task, compare_mode_t mode, data_type_t type, size_t begin, size_t end
+) {
+    size_t count = 0;
+    float  worst = 0.0f;
+    size_t i     = begin;
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    const __m256 tolerance = _mm256_set1_ps(task->tolerance);
+    __m256       vworst    = _mm256_setzero_ps();
+
+    for (; i + 8 <= end; i += 8) {
+        const __m256 a   = compare_load_ps(type, task->a, i);
+        const __m256 ref = _mm256_loadu_ps(task->ref + i);
+
+        if (COMPARE_REL == mode) {
+            vworst = _mm256_max_ps(vworst, compare_relative_ps(a, ref));
+            continue;
+        }
+
+        const int close = _mm256_movemask_ps(compare_close_ps(a, ref, tolerance));
+        if (0xFF != close) {
+            if (COMPARE_ALL == mode) {
+                atomic_store(&task->failed, true);
+                return;
+            }
+            count += 8 - (size_t) __builtin_popcount((unsigned) close);
+        }
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vworst);
+    for (size_t l = 0; l < 8; ++l) {
+        worst = fmaxf(worst, lanes[l]);
+    }
+#endif
+
+    for (; i < end; ++i) {
+        const float a = compare_load(type, task->a, i);
+        if (COMPARE_REL == mode) {
+            worst = fmaxf(worst, compare_relative(a, task->ref[i]));
+        } else if (!compare_close(a, task->ref[i], task->tolerance)) {
+            if (COMPARE_ALL == mode) {
+                atomic_store(&task->failed, true);
+                return;
+            }
+            count++;
+        }
+    }
+
+    if (COMPARE_COUNT == mode && count) {
+        atomic_fetch_add(&task->count, count);
+    }
+    if (COMPARE_REL == mode) {
+        compare_store_max(&task->max_bits, worst);
+    }
+}
+
+static void compare_chunks(void* ctx, size_t begin, size_t end, size_t thread) {
+    compare_task_t* task = (compare_task_t*) ctx;
+    (void) thread;
+
+    for (size_t c = begin; c < end; ++c) {
+        if (COMPARE_ALL == task->mode
+            && atomic_load_explicit(&task->failed, memory_order_relaxed)) {
+            return;
+        }
+
+        const size_t first = c * COMPARE_CHUNK;
+        const size_t last  = task->n - first < COMPARE_CHUNK ? task->n : first + COMPARE_CHUNK;
+
+        switch (task->type) {
+            case TYPE_FLOAT_F16:
+                compare_range(task, task->mode, TYPE_FLOAT_F16, first, last);
+                break;
+            case TYPE_FLOAT_BF16:
+                compare_range(task, task->mode, TYPE_FLOAT_BF16, first, last);
+                break;
+            default:
+                compare_range(task, task->mode, TYPE_FLOAT_F32, first, last);
+                break;
+        }
+    }
+}
+
+static void compare(
+    compare_task_t* task,
+    compare_mode_t  mode,
+    data_type_t     type,
+    const void*     a,
+    const float*    ref,
+    size_t          n,
+    int64_t         significand,
+    size_t          n_threads
+) {
+    assert(TYPE_FLOAT_F32 == type || TYPE_FLOAT_F16 == type || TYPE_FLOAT_BF16 == type);
+
+    task->mode      = mode;
+    task->type      = type;
+    task->a         = (const uint8_t*) a;
+    task->ref       = ref;
+    task->n         = n;
+    task->tolerance = powf(10.0f, (float) -significand);
+    atomic_init(&task->failed, false);
+    atomic_init(&task->count, 0);
+    atomic_init(&task->max_bits, 0);
+
+    PROFILE_BEGIN(sample);
+
+    parallel_for((n + COMPARE_CHUNK - 1) / COMPARE_CHUNK, 1, n_threads, compare_chunks, task);
+
+    PROFILE_END(sample, PROFILE_COMPARE, n, n * (quant_type_size(type) + sizeof(float)));
+}
+
+bool all_close(
+    data_type_t  type,
+    const void*  a,
+    const float* ref,
+    size_t       n,
+    int64_t      significand,
+    size_t       n_threads
+) {
+    compare_task_t task;
+    compare(&task, COMPARE_ALL, type, a, ref, n, significand, n_threads);
+    return !atomic_load(&task.failed);
+}
+
+size_t count_not_close(
+    data_type_t  type,
+    const void*  a,
+    const float* ref,
+    size_t       n,
+    int64_t      significand,
+    size_t       n_threads
+) {
+    compare_task_t task;
+    compare(&task, COMPARE_COUNT, type, a, ref, n, significand, n_threads);
+    return atomic_load(&task.count);
+}
+
+float max_relative_error(
+    data_type_t type, const void* a, const float* ref, size_t n, size_t n_threads
+) {
+    compare_task_t task;
+    compare(&task, COMPARE_REL, type, a, ref, n, 0, n_threads);
+    return decode_float32(atomic_load(&task.max_bits));
+}
+
+/*
+ * ULP distance
+ */
+
+typedef struct {
+    data_type_t      type;
+    const uint8_t*   a;
+    const uint8_t*   b;
+    size_t           n;
+    _Atomic uint32_t max_ulp;
+} ulp_task_t;
+
+// Maps a code onto a monotonic signed integer line, or reports NaN
+static inline bool ulp_ordinal(data_type_t type, const uint8_t* x, size_t i, int64_t* ordinal) {
+    uint32_t bits;
+    uint32_t sign;
+    uint32_t inf;
+    switch (type) {
+        case TYPE_FLOAT_F16:
+            bits = ((const float16_t*) x)[i];
+            sign = 0x8000;
+            inf  = 0x7C00;
+            break;
+        case TYPE_FLOAT_BF16:
+            bits = ((const bfloat16_t*) x)[i];
+            sign = 0x8000;
+            inf  = 0x7F80;
+            break;
+        default:
+            bits = ((const uint32_t*) x)[i];
+            sign = UINT32_C(0x80000000);
+            inf  = UINT32_C(0x7F800000);
+            break;
+    }
+
+    const uint32_t magnitude = bits & ~sign;
+    *ordinal                 = bits & sign ? -(int64_t) magnitude : (int64_t) magnitude;
+    return magnitude <= inf;
+}
+
+#if defined(__AVX2__)
+
+// Loads eight codes aligned to the top of 32-bit lanes, so every type shares fp32 sign handling
+static inline __m256i ulp_load_epi32(data_type_t type, const uint8_t* x, size_t i) {
+    if (TYPE_FLOAT_F32 == type) {
+        return _mm256_loadu_si256((const __m256i*) ((const uint32_t*) x + i));
+    }
+    const __m128i h = _mm_loadu_si128((const __m128i*) ((const uint16_t*) x + i));
+    return _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+}
+
+// Biased ordinal: 2^31 + magnitude for positive codes, 2^31 - magnitude for negative ones
+static inline __m256i ulp_ordinal_epi32(__m256i bits) {
+    const __m256i sign      = _mm256_set1_epi32((int) 0x80000000);
+    const __m256i negative  = _mm256_srai_epi32(bits, 31);
+    const __m256i magnitude = _mm256_andnot_si256(sign, bits);
+    return _mm256_add_epi32(
+        sign, _mm256_sub_epi32(_mm256_xor_si256(magnitude, negative), negative)
+    );
+}
+
+#endif
+
+static void ulp_chunks(void* ctx, size_t begin, size_t end, size_t thread) {
+    ulp_task_t* task = (ulp_task_t*) ctx;
+    (void) thread;
+
+    for (size_t c = begin; c < end; ++c) {
+        const size_t first = c * COMPARE_CHUNK;
+        const size_t last  = task->n - first < COMPARE_CHUNK ? task->n : first + COMPARE_CHUNK;
+
+        uint32_t worst = 0;
+        size_t   i     = first;
+
+#if defined(__AVX2__)
+        // Infinity in the top-aligned lane layout
+        const int shift = TYPE_FLOAT_F32 == task->type ? 0 : 16;
+        const int inf   = TYPE_FLOAT_F16 == task->type ? 0x7C000000 : 0x7F800000;
+
+        const __m256i sign = _mm256_set1_epi32((int) 0x80000000);
+        const __m256i vinf = _mm256_set1_epi32(inf);
+        __m256i       vmax = _mm256_setzero_si256();
+        __m256i       nan  = _mm256_setzero_si256();
+
+        for (; i + 8 <= last; i += 8) {
+            const __m256i a = ulp_load_epi32(task->type, task->a, i);
+            const __m256i b = ulp_load_epi32(task->type, task->b, i);
+
+            nan = _mm256_or_si256(nan, _mm256_cmpgt_epi32(_mm256_andnot_si256(sign, a), vinf));
+            nan = _mm256_or_si256(nan, _mm256_cmpgt_epi32(_mm256_andnot_si256(sign, b), vinf));
+
+            // Ordinals differ by at most 2 * inf, which fits in 32 unsigned bits
+            const __m256i oa = ulp_ordinal_epi32(a);
+            const __m256i ob = ulp_ordinal_epi32(b);
+            vmax             = _mm256_max_epu32(
+                vmax, _mm256_sub_epi32(_mm256_max_epu32(oa, ob), _mm256_min_epu32(oa, ob))
+            );
+        }
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*) lanes, _mm256_srli_epi32(vmax, shift));
+        for (size_t l = 0; l < 8; ++l) {
+            worst = lanes[l] > worst ? lanes[l] : worst;
+        }
+        if (!_mm256_testz_si256(nan, nan)) {
+            worst = UINT32_MAX;
+            i     = last;
+        }
+#endif
+
+        for (; i < last; ++i) {
+            int64_t    oa;
+            int64_t    ob;
+            const bool valid_a = ulp_ordinal(task->type, task->a, i, &oa);
+            const bool valid_b = ulp_ordinal(task->type, task->b, i, &ob);
+            if (!valid_a || !valid_b) {
+                worst = UINT32_MAX;
+                break;
+            }
+            const uint64_t distance = (uint64_t) (oa > ob ? oa - ob : ob - oa);
+            worst                   = distance > worst ? (uint32_t) distance : worst;
+        }
+
+        uint32_t current = atomic_load(&task->max_ulp);
+        while (worst > current && !atomic_compare_exchange_weak(&task->max_ulp, &current, worst)) {}
+    }
+}
+
+uint32_t max_ulp_distance(
+    data_type_t type, const void* a, const void* b, size_t n, size_t n_threads
+) {
+    assert(TYPE_FLOAT_F32 == type || TYPE_FLOAT_F16 == type || TYPE_FLOAT_BF16 == type);
+
+    ulp_task_t task;
+    task.type = type;
+    task.a    = (const uint8_t*) a;
+    task.b    = (const uint8_t*) b;
+    task.n    = n;
+    atomic_init(&task.max_ulp, 0);
+
+    PROFILE_BEGIN(sample);
+
+    parallel_for((n + COMPARE_CHUNK - 1) / COMPARE_CHUNK, 1, n_threads, ulp_chunks, &task);
+
+    PROFILE_END(sample, PROFILE_COMPARE, n, 2 * n * quant_type_size(type));
+    return atomic_load(&task.max_ulp);
+}
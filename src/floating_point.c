@@ -111,10 +111,8 @@ bfloat16_t encode_bfloat16(float value) {
         return (bits >> 16) & 0x8000;
     }
 
-    // Rounding: round to nearest even
-    uint32_t rounding_bias = (bits & 0x0000ffff) > 0x00007fff    ? 1
-                             : (bits & 0x00018000) == 0x00018000 ? 1
-                                                                 : 0;
+    // Rounding: round to nearest even, ties go to the even upper half
+    uint32_t rounding_bias = 0x00007fff + ((bits >> 16) & 1);
     return (bits + rounding_bias) >> 16;
 }
 
@@ -127,6 +125,54 @@ float decode_bfloat16(bfloat16_t bf16) {
     return data.value;
 }
 
+/*
+ * 8-bit floating point representation (OCP E4M3FN)
+ *
+ * 1 sign bit, 4 exponent bits (bias 7) and 3 mantissa bits. There are no
+ * infinities; S.1111.111 is NaN and out of range values saturate to ±448.
+ */
+float8_t encode_float8(float value) {
+    const uint32_t bits = encode_float32(value);
+    const uint8_t  sign = (bits >> 24) & 0x80;
+    const uint32_t abs  = bits & UINT32_C(0x7FFFFFFF);
+
+    // NaN
+    if (abs > UINT32_C(0x7F800000)) {
+        return sign | 0x7F;
+    }
+
+    // Saturate at 448 (infinity included)
+    if (abs >= UINT32_C(0x43E00000)) {
+        return sign | 0x7E;
+    }
+
+    // Subnormals below 2^-6 are multiples of 2^-9; rounding up to 8 lands on the smallest normal
+    if (abs < UINT32_C(0x3C800000)) {
+        return sign | (uint8_t) nearbyintf(decode_float32(abs) * 512.0f);
+    }
+
+    // Round to nearest even at mantissa bit 20, then rebias from 127 to 7
+    const uint32_t rounded = abs + UINT32_C(0x0007FFFF) + ((abs >> 20) & 1);
+    return sign | (uint8_t) ((((rounded >> 23) - 120) << 3) | ((rounded >> 20) & 0x07));
+}
+
+float decode_float8(float8_t bits) {
+    const uint32_t sign     = (uint32_t) (bits & 0x80) << 24;
+    const uint32_t exponent = (bits >> 3) & 0x0F;
+    const uint32_t mantissa = bits & 0x07;
+
+    if (0x0F == exponent && 0x07 == mantissa) {
+        return decode_float32(sign | UINT32_C(0x7FC00000));
+    }
+
+    if (0 == exponent) {
+        const float subnormal = (float) mantissa / 512.0f;
+        return decode_float32(sign | encode_float32(subnormal));
+    }
+
+    return decode_float32(sign | ((exponent + 120) << 23) | (mantissa << 20));
+}
+
 // Helper function to encode a float based on its data type
 // float_flex_t encode_float32(float value, data_t type) {
 //     float_flex_t encoded;
@@ -179,41 +225,48 @@ float decode_bfloat16(bfloat16_t bf16) {
 
 // Function to print the binary representation of a 32-bit number
 void print_32bit_raw(float32_t bits, size_t bit_width) {
+    // Up to 32 digits, 7 separators and the newline; one write per call
+    char  line[48];
+    char* p = line;
     for (int i = bit_width - 1; i >= 0; i--) {
-        printf("%d", (bits >> i) & 1);
+        *p++ = '0' + ((bits >> i) & 1);
         if (0 == i % 4 && 0 != i) {
-            printf(" ");
+            *p++ = ' ';
         }
     }
-    printf("\n");
+    *p++ = '\n';
+    fwrite(line, 1, (size_t) (p - line), stdout);
 }
 
 void print_32bit_formatted(float32_t bits) {
-    printf("%f -> ", decode_float32(bits));
+    char  line[64];
+    char* p = line;
 
     // Extract the sign bit (1 bit)
-    uint32_t sign = (bits >> 31) & 0x1;
-    printf("%d ", sign);
+    *p++ = '0' + ((bits >> 31) & 0x1);
+    *p++ = ' ';
 
     // Extract the exponent bits (8 bits)
     uint32_t exponent = (bits >> 23) & 0xFF;
     for (int i = 7; i >= 0; i--) {
-        printf("%d", (exponent >> i) & 0x1);
+        *p++ = '0' + ((exponent >> i) & 0x1);
         if (i == 4) {
-            printf(" ");
+            *p++ = ' ';
         }
     }
-    printf(" ");
+    *p++ = ' ';
 
     // Extract the mantissa bits (23 bits)
     uint32_t mantissa = bits & 0x7FFFFF;
     for (int i = 22; i >= 0; i--) {
-        printf("%d", (mantissa >> i) & 0x1);
+        *p++ = '0' + ((mantissa >> i) & 0x1);
         if (i % 4 == 0) {
-            printf(" ");
+            *p++ = ' ';
         }
     }
-    printf("\n");
+    *p++ = '\n';
+
+    printf("%f -> %.*s", decode_float32(bits), (int) (p - line), line);
 }
 
 void print_32bit_metadata(float value, const size_t bit_width) {
@@ -0,0 +1,235 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/gemm_bf16.c
+ *
+ * @brief bfloat16 dot product, GEMV and GEMM kernels.
+ *
+ * Every kernel is built on three primitives: load a vector of bfloat16
+ * pairs, multiply-accumulate two such vectors into fp32 lanes, and reduce
+ * the lanes. GEMM tiles the output into GEMM_BF16_MR x GEMM_BF16_NR blocks
+ * so each load is reused across a whole row or column of the tile; GEMV is
+ * the m = 1 case. Elements past the last full vector are summed in scalar.
+ */
+
+#include "gemm_bf16.h"
+#include "parallel.h"
+#include "profile.h"
+
+#if (defined(__AVX512BF16__) && defined(__AVX512BW__)) || (defined(__AVX2__) && defined(__FMA__))
+    #include <immintrin.h>
+#endif
+
+#if defined(__AVX512BF16__) && defined(__AVX512BW__)
+
+    // Elements consumed per primitive step.
+    #define BF16_STEP 32
+
+typedef __m512  bf16_acc_t;
+typedef __m512i bf16_vec_t;
+
+static inline bf16_acc_t bf16_zero(void) {
+    return _mm512_setzero_ps();
+}
+
+static inline bf16_vec_t bf16_load(const bfloat16_t* p) {
+    return _mm512_loadu_si512((const void*) p);
+}
+
+// Sixteen fp32 lanes each accumulate one product pair
+static inline bf16_acc_t bf16_fma(bf16_acc_t acc, bf16_vec_t a, bf16_vec_t b) {
+    return _mm512_dpbf16_ps(acc, (__m512bh) a, (__m512bh) b);
+}
+
+static inline float bf16_hsum(bf16_acc_t acc) {
+    return _mm512_reduce_add_ps(acc);
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+    #define BF16_STEP 16
+
+typedef __m256  bf16_acc_t;
+typedef __m256i bf16_vec_t;
+
+static inline bf16_acc_t bf16_zero(void) {
+    return _mm256_setzero_ps();
+}
+
+static inline bf16_vec_t bf16_load(const bfloat16_t* p) {
+    return _mm256_loadu_si256((const __m256i*) p);
+}
+
+// Odd elements already sit in the high half of each 32-bit lane and only need
+// masking; even elements are shifted up, the same widening as decode_bfloat16().
+static inline bf16_acc_t bf16_fma(bf16_acc_t acc, bf16_vec_t a, bf16_vec_t b) {
+    const __m256i high = _mm256_set1_epi32((int) 0xFFFF0000);
+
+    acc = _mm256_fmadd_ps(
+        _mm256_castsi256_ps(_mm256_slli_epi32(a, 16)),
+        _mm256_castsi256_ps(_mm256_slli_epi32(b, 16)),
+        acc
+    );
+    return _mm256_fmadd_ps(
+        _mm256_castsi256_ps(_mm256_and_si256(a, high)),
+        _mm256_castsi256_ps(_mm256_and_si256(b, high)),
+        acc
+    );
+}
+
+static inline float bf16_hsum(bf16_acc_t acc) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s        = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s        = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+#endif
+
+// Scalar sum over [begin, end), used for tails and non-SIMD builds
+static inline float
+bf16_dot_tail(const bfloat16_t* a, const bfloat16_t* b, size_t begin, size_t end) {
+    float sum = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+        sum += decode_bfloat16(a[i]) * decode_bfloat16(b[i]);
+    }
+    return sum;
+}
+
+float dot_bf16(const bfloat16_t* a, const bfloat16_t* b, size_t n) {
+#if defined(BF16_STEP)
+    const size_t n_vec = n - n % BF16_STEP;
+
+    bf16_acc_t acc = bf16_zero();
+    for (size_t i = 0; i < n_vec; i += BF16_STEP) {
+        acc = bf16_fma(acc, bf16_load(a + i), bf16_load(b + i));
+    }
+    return bf16_hsum(acc) + bf16_dot_tail(a, b, n_vec, n);
+#else
+    return bf16_dot_tail(a, b, 0, n);
+#endif
+}
+
+/*
+ * Tiled matrix multiplication
+ */
+
+typedef struct {
+    const bfloat16_t* a;
+    const bfloat16_t* w;
+    float*            c;
+    size_t            m;
+    size_t            n;
+    size_t            k;
+} gemm_bf16_task_t;
+
+static inline __attribute__((always_inline)) void
+gemm_bf16_tile(const gemm_bf16_task_t* task, size_t i0, size_t j0, size_t mr, size_t nr) {
+    const size_t k = task->k;
+
+    float out[GEMM_BF16_MR][GEMM_BF16_NR] = {{0.0f}};
+
+#if defined(BF16_STEP)
+    const size_t k_vec = k - k % BF16_STEP;
+
+    bf16_acc_t acc[GEMM_BF16_MR][GEMM_BF16_NR];
+    for (size_t i = 0; i < GEMM_BF16_MR; ++i) {
+        for (size_t j = 0; j < GEMM_BF16_NR; ++j) {
+            acc[i][j] = bf16_zero();
+        }
+    }
+
+    for (size_t p = 0; p < k_vec; p += BF16_STEP) {
+        bf16_vec_t wv[GEMM_BF16_NR];
+        for (size_t j = 0; j < GEMM_BF16_NR && j < nr; ++j) {
+            wv[j] = bf16_load(task->w + (j0 + j) * k + p);
+        }
+
+        for (size_t i = 0; i < GEMM_BF16_MR && i < mr; ++i) {
+            const bf16_vec_t av = bf16_load(task->a + (i0 + i) * k + p);
+            for (size_t j = 0; j < GEMM_BF16_NR && j < nr; ++j) {
+                acc[i][j] = bf16_fma(acc[i][j], av, wv[j]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < GEMM_BF16_MR && i < mr; ++i) {
+        for (size_t j = 0; j < GEMM_BF16_NR && j < nr; ++j) {
+            out[i][j] = bf16_hsum(acc[i][j]);
+        }
+    }
+#else
+    const size_t k_vec = 0;
+#endif
+
+    for (size_t i = 0; i < GEMM_BF16_MR && i < mr; ++i) {
+        for (size_t j = 0; j < GEMM_BF16_NR && j < nr; ++j) {
+            const bfloat16_t* a = task->a + (i0 + i) * k;
+            const bfloat16_t* w = task->w + (j0 + j) * k;
+
+            task->c[(i0 + i) * task->n + j0 + j] = out[i][j] + bf16_dot_tail(a, w, k_vec, k);
+        }
+    }
+}
+
+// Computes every activation row against weight row tiles [begin, end) * GEMM_BF16_NR
+static void gemm_bf16_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const gemm_bf16_task_t* task = (const gemm_bf16_task_t*) ctx;
+    (void) thread;
+
+    for (size_t i0 = 0; i0 < task->m; i0 += GEMM_BF16_MR) {
+        const size_t mr = task->m - i0 < GEMM_BF16_MR ? task->m - i0 : GEMM_BF16_MR;
+
+        for (size_t tile = begin; tile < end; ++tile) {
+            const size_t j0 = tile * GEMM_BF16_NR;
+            const size_t nr = task->n - j0 < GEMM_BF16_NR ? task->n - j0 : GEMM_BF16_NR;
+
+            if (GEMM_BF16_MR == mr && GEMM_BF16_NR == nr) {
+                gemm_bf16_tile(task, i0, j0, GEMM_BF16_MR, GEMM_BF16_NR);
+            } else {
+                gemm_bf16_tile(task, i0, j0, mr, nr);
+            }
+        }
+    }
+}
+
+void gemm_bf16(
+    const bfloat16_t* a,
+    const bfloat16_t* w,
+    float*            c,
+    size_t            m,
+    size_t            n,
+    size_t            k,
+    size_t            n_threads
+) {
+    gemm_bf16_task_t task;
+    task.a = a;
+    task.w = w;
+    task.c = c;
+    task.m = m;
+    task.n = n;
+    task.k = k;
+
+    PROFILE_BEGIN(sample);
+
+    parallel_for((n + GEMM_BF16_NR - 1) / GEMM_BF16_NR, 0, n_threads, gemm_bf16_rows, &task);
+
+    PROFILE_END(
+        sample,
+        PROFILE_GEMM_BF16,
+        m * n * k,
+        (m + n) * k * sizeof(bfloat16_t) + m * n * sizeof(float)
+    );
+}
+
+void gemv_bf16(
+    const bfloat16_t* w,
+    const bfloat16_t* x,
+    float*            y,
+    size_t            rows,
+    size_t            cols,
+    size_t            n_threads
+) {
+    // A single activation row; y is laid out as the 1 x rows output matrix
+    gemm_bf16(x, w, y, 1, rows, cols, n_threads);
+}
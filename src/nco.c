@@ -0,0 +1,278 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/nco.c
+ *
+ * @brief Table-driven numerically controlled oscillator bank.
+ *
+ * Odd quadrants mirror the phase (x -> 2^30 - x) rather than the index, so
+ * both interpolators always step forward through the table. The guard entry
+ * after the quarter-wave endpoint lets the AVX2 path fetch table[i] and
+ * table[i + 1] with a single 32-bit gather.
+ */
+
+#include "nco.h"
+#include "profile.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+/// Full scale of the Q1.15 table; 1.0 itself is not representable.
+#define NCO_FULL_SCALE   32767
+
+/// pi in Q13, scaling the phase fraction to radians for the Taylor step.
+#define NCO_PI_Q13       25736
+
+/// Fraction bits kept for interpolation.
+#define NCO_WEIGHT_BITS  15
+
+/// The Taylor step is cos(x) in Q15 times the angle in units of 2^-(NCO_TABLE_BITS + 14).
+#define NCO_TAYLOR_SHIFT (NCO_TABLE_BITS + 14)
+
+#define NCO_QUARTER      (UINT32_C(1) << 30)
+#define NCO_FRAC_MASK    ((UINT32_C(1) << NCO_FRAC_BITS) - 1)
+
+nco_bank_t* malloc_nco_bank(size_t n_channels, nco_interp_t interp, int dither_bits) {
+    nco_bank_t* bank = (nco_bank_t*) calloc(1, sizeof(nco_bank_t));
+    if (!bank) {
+        return NULL;
+    }
+
+    bank->n_channels  = n_channels;
+    bank->interp      = interp;
+    bank->dither_bits = dither_bits < 0 ? 0 : (dither_bits > 32 ? 32 : dither_bits);
+    bank->phase       = (uint32_t*) calloc(n_channels ? n_channels : 1, sizeof(uint32_t));
+    bank->increment   = (uint32_t*) calloc(n_channels ? n_channels : 1, sizeof(uint32_t));
+    bank->seed        = (uint32_t*) malloc((n_channels ? n_channels : 1) * sizeof(uint32_t));
+    bank->table       = (int16_t*) malloc((NCO_TABLE_SIZE + 2) * sizeof(int16_t));
+    if (!bank->phase || !bank->increment || !bank->seed || !bank->table) {
+        free_nco_bank(bank);
+        return NULL;
+    }
+
+    for (size_t i = 0; i <= NCO_TABLE_SIZE; ++i) {
+        const double angle = M_PI / 2.0 * (double) i / NCO_TABLE_SIZE;
+        bank->table[i]     = (int16_t) lround(NCO_FULL_SCALE * sin(angle));
+    }
+    bank->table[NCO_TABLE_SIZE + 1] = bank->table[NCO_TABLE_SIZE - 1];
+
+    // An odd multiplier maps distinct channels to distinct nonzero seeds
+    for (size_t c = 0; c < n_channels; ++c) {
+        bank->seed[c] = (uint32_t) (c + 1) * UINT32_C(0x9E3779B9);
+    }
+    return bank;
+}
+
+void free_nco_bank(nco_bank_t* bank) {
+    if (bank) {
+        free(bank->phase);
+        free(bank->increment);
+        free(bank->seed);
+        free(bank->table);
+        free(bank);
+    }
+}
+
+uint32_t nco_increment(uint32_t frequency, uint32_t sample_rate) {
+    return (uint32_t) (((uint64_t) frequency << 32) / sample_rate);
+}
+
+uint32_t nco_increment_from_float(double frequency, double sample_rate) {
+    const double cycles = frequency / sample_rate;
+    return (uint32_t) (int64_t) llround((cycles - floor(cycles)) * 4294967296.0);
+}
+
+void nco_set(nco_bank_t* bank, size_t channel, uint32_t increment, uint32_t phase) {
+    bank->increment[channel] = increment;
+    bank->phase[channel]     = phase;
+}
+
+/*
+ * Scalar kernels
+ */
+
+static inline uint32_t xorshift32(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline int32_t nco_sample(const int16_t* table, nco_interp_t interp, uint32_t phase) {
+    const uint32_t quadrant = phase >> 30;
+    uint32_t       x        = phase & (NCO_QUARTER - 1);
+    if (quadrant & 1) {
+        x = NCO_QUARTER - x;
+    }
+
+    const uint32_t index  = x >> NCO_FRAC_BITS;
+    const int32_t  weight = (int32_t) ((x & NCO_FRAC_MASK) >> (NCO_FRAC_BITS - NCO_WEIGHT_BITS));
+    int32_t        v      = table[index];
+    if (NCO_INTERP_LINEAR == interp) {
+        v += ((table[index + 1] - v) * weight + (1 << (NCO_WEIGHT_BITS - 1))) >> NCO_WEIGHT_BITS;
+    } else if (NCO_INTERP_TAYLOR == interp) {
+        const int32_t angle = (weight * NCO_PI_Q13) >> NCO_WEIGHT_BITS;
+        const int32_t step  = table[NCO_TABLE_SIZE - index] * angle;
+        v += (step + (1 << (NCO_TAYLOR_SHIFT - 1))) >> NCO_TAYLOR_SHIFT;
+    }
+
+    return quadrant & 2 ? -v : v;
+}
+
+// Low dither_bits bits set
+static inline uint32_t nco_dither_mask(const nco_bank_t* bank) {
+    return bank->dither_bits >= 32 ? UINT32_MAX : (UINT32_C(1) << bank->dither_bits) - 1;
+}
+
+// Channels [begin, end) one at a time; dst is the interleaved output of sample 0
+static void nco_channels(
+    nco_bank_t* bank, void* dst, bool i16, size_t begin, size_t end, size_t n_samples
+) {
+    const uint32_t mask = nco_dither_mask(bank);
+    const size_t   n    = bank->n_channels;
+
+    for (size_t c = begin; c < end; ++c) {
+        uint32_t phase = bank->phase[c];
+        uint32_t seed  = bank->seed[c];
+        for (size_t s = 0; s < n_samples; ++s) {
+            uint32_t p = phase;
+            if (mask) {
+                seed = xorshift32(seed);
+                p += seed & mask;
+            }
+
+            const int32_t v = nco_sample(bank->table, bank->interp, p);
+            if (i16) {
+                ((int16_t*) dst)[s * n + c] = (int16_t) v;
+            } else {
+                ((fixed16_t*) dst)[s * n + c] = v * (FIXED_VAL >> 15);
+            }
+            phase += bank->increment[c];
+        }
+        bank->phase[c] = phase;
+        bank->seed[c]  = seed;
+    }
+}
+
+/*
+ * AVX2 kernels
+ */
+
+#if defined(__AVX2__)
+
+static inline __m256i xorshift32_epi32(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+static inline __m256i nco_sample_epi32(const int16_t* table, nco_interp_t interp, __m256i phase) {
+    const __m256i quadrant = _mm256_srli_epi32(phase, 30);
+    const __m256i one      = _mm256_set1_epi32(1);
+    const __m256i two      = _mm256_set1_epi32(2);
+
+    __m256i       x    = _mm256_and_si256(phase, _mm256_set1_epi32(NCO_QUARTER - 1));
+    const __m256i odd  = _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one);
+    const __m256i flip = _mm256_sub_epi32(_mm256_set1_epi32(NCO_QUARTER), x);
+    x                  = _mm256_blendv_epi8(x, flip, odd);
+
+    // One 32-bit gather at index i returns table[i] in the low half and table[i + 1] in the high
+    const __m256i index  = _mm256_srli_epi32(x, NCO_FRAC_BITS);
+    const __m256i weight = _mm256_srli_epi32(
+        _mm256_and_si256(x, _mm256_set1_epi32(NCO_FRAC_MASK)), NCO_FRAC_BITS - NCO_WEIGHT_BITS
+    );
+    const __m256i pair = _mm256_i32gather_epi32((const int*) table, index, 2);
+    __m256i       v    = _mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16);
+
+    if (NCO_INTERP_LINEAR == interp) {
+        const __m256i next  = _mm256_srai_epi32(pair, 16);
+        const __m256i delta = _mm256_mullo_epi32(_mm256_sub_epi32(next, v), weight);
+        const __m256i round = _mm256_set1_epi32(1 << (NCO_WEIGHT_BITS - 1));
+        const __m256i term  = _mm256_srai_epi32(_mm256_add_epi32(delta, round), NCO_WEIGHT_BITS);
+        v                   = _mm256_add_epi32(v, term);
+    } else if (NCO_INTERP_TAYLOR == interp) {
+        const __m256i mirror = _mm256_sub_epi32(_mm256_set1_epi32(NCO_TABLE_SIZE), index);
+        const __m256i cosine = _mm256_srai_epi32(
+            _mm256_slli_epi32(_mm256_i32gather_epi32((const int*) table, mirror, 2), 16), 16
+        );
+        const __m256i angle = _mm256_srli_epi32(
+            _mm256_mullo_epi32(weight, _mm256_set1_epi32(NCO_PI_Q13)), NCO_WEIGHT_BITS
+        );
+        const __m256i step  = _mm256_mullo_epi32(cosine, angle);
+        const __m256i round = _mm256_set1_epi32(1 << (NCO_TAYLOR_SHIFT - 1));
+        const __m256i term  = _mm256_srai_epi32(_mm256_add_epi32(step, round), NCO_TAYLOR_SHIFT);
+        v                   = _mm256_add_epi32(v, term);
+    }
+
+    const __m256i negative = _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, two), two);
+    return _mm256_sub_epi32(_mm256_xor_si256(v, negative), negative);
+}
+
+// Eight channels per step, held in registers across the whole sample loop
+static size_t nco_channels_avx2(nco_bank_t* bank, void* dst, bool i16, size_t n_samples) {
+    const uint32_t mask = nco_dither_mask(bank);
+    const __m256i  vm   = _mm256_set1_epi32((int32_t) mask);
+    const size_t   n    = bank->n_channels;
+
+    size_t c = 0;
+    for (; c + 8 <= n; c += 8) {
+        __m256i       phase     = _mm256_loadu_si256((const __m256i*) (bank->phase + c));
+        __m256i       seed      = _mm256_loadu_si256((const __m256i*) (bank->seed + c));
+        const __m256i increment = _mm256_loadu_si256((const __m256i*) (bank->increment + c));
+
+        for (size_t s = 0; s < n_samples; ++s) {
+            __m256i p = phase;
+            if (mask) {
+                seed = xorshift32_epi32(seed);
+                p    = _mm256_add_epi32(p, _mm256_and_si256(seed, vm));
+            }
+
+            const __m256i v = nco_sample_epi32(bank->table, bank->interp, p);
+            if (i16) {
+                const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08);
+                __m128i*      out    = (__m128i*) ((int16_t*) dst + s * n + c);
+                _mm_storeu_si128(out, _mm256_castsi256_si128(packed));
+            } else {
+                __m256i* out = (__m256i*) ((fixed16_t*) dst + s * n + c);
+                _mm256_storeu_si256(out, _mm256_slli_epi32(v, FIXED_SIZE - 15));
+            }
+            phase = _mm256_add_epi32(phase, increment);
+        }
+
+        _mm256_storeu_si256((__m256i*) (bank->phase + c), phase);
+        _mm256_storeu_si256((__m256i*) (bank->seed + c), seed);
+    }
+    return c;
+}
+
+#endif
+
+static void nco_generate(nco_bank_t* bank, void* dst, bool i16, size_t n_samples) {
+    PROFILE_BEGIN(sample);
+
+    size_t c = 0;
+#if defined(__AVX2__)
+    c = nco_channels_avx2(bank, dst, i16, n_samples);
+#endif
+    nco_channels(bank, dst, i16, c, bank->n_channels, n_samples);
+
+    PROFILE_END(
+        sample,
+        PROFILE_NCO,
+        n_samples * bank->n_channels,
+        n_samples * bank->n_channels * (i16 ? sizeof(int16_t) : sizeof(fixed16_t))
+    );
+}
+
+void nco_generate_fixed16(nco_bank_t* bank, fixed16_t* dst, size_t n_samples) {
+    nco_generate(bank, dst, false, n_samples);
+}
+
+void nco_generate_i16(nco_bank_t* bank, int16_t* dst, size_t n_samples) {
+    nco_generate(bank, dst, true, n_samples);
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/parallel.c
+ *
+ * @brief Work-stealing parallel loop.
+ *
+ * Each worker owns a range of task indices packed into a single 64-bit word
+ * (begin in the low half, end in the high half). The owner pops from the
+ * front and thieves split off the back half, both with a compare-and-swap on
+ * the packed word, so no locks are taken on the hot path.
+ */
+
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t range; // Packed [begin, end) task indices
+} parallel_deque_t;
+
+typedef struct {
+    size_t            n;
+    size_t            grain;
+    size_t            n_threads;
+    parallel_fn_t     fn;
+    void*             ctx;
+    parallel_deque_t* deques;
+} parallel_pool_t;
+
+typedef struct {
+    parallel_pool_t* pool;
+    size_t           thread;
+} parallel_worker_t;
+
+static inline uint64_t range_pack(uint32_t begin, uint32_t end) {
+    return (uint64_t) begin | ((uint64_t) end << 32);
+}
+
+static inline uint32_t range_begin(uint64_t range) {
+    return (uint32_t) range;
+}
+
+static inline uint32_t range_end(uint64_t range) {
+    return (uint32_t) (range >> 32);
+}
+
+// Pops the front task of the worker's own range
+static bool deque_pop(parallel_deque_t* deque, uint32_t* task) {
+    uint64_t range = atomic_load(&deque->range);
+    while (range_begin(range) < range_end(range)) {
+        const uint64_t next = range_pack(range_begin(range) + 1, range_end(range));
+        if (atomic_compare_exchange_weak(&deque->range, &range, next)) {
+            *task = range_begin(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the back half of the fullest victim range into the thief's own range
+static bool deque_steal(parallel_pool_t* pool, size_t thief) {
+    for (;;) {
+        size_t   victim = pool->n_threads;
+        uint32_t most   = 0;
+        for (size_t i = 0; i < pool->n_threads; ++i) {
+            const uint64_t range = atomic_load(&pool->deques[i].range);
+            const uint32_t left  = range_end(range) > range_begin(range)
+                                       ? range_end(range) - range_begin(range)
+                                       : 0;
+            if (i != thief && left > most) {
+                most   = left;
+                victim = i;
+            }
+        }
+        if (victim == pool->n_threads) {
+            return false;
+        }
+
+        parallel_deque_t* deque = &pool->deques[victim];
+        uint64_t          range = atomic_load(&deque->range);
+        const uint32_t    begin = range_begin(range);
+        const uint32_t    end   = range_end(range);
+        if (begin >= end) {
+            continue;
+        }
+
+        // Take the back half, rounding up so a lone remaining task can move too
+        const uint32_t split = end - (end - begin + 1) / 2;
+        if (atomic_compare_exchange_strong(&deque->range, &range, range_pack(begin, split))) {
+            atomic_store(&pool->deques[thief].range, range_pack(split, end));
+            return true;
+        }
+    }
+}
+
+// Set on threads spawned by parallel_for(); the caller running as worker 0 is not one
+static _Thread_local bool parallel_spawned = false;
+
+static void* parallel_worker(void* arg) {
+    parallel_worker_t* worker = (parallel_worker_t*) arg;
+    parallel_pool_t*   pool   = worker->pool;
+    parallel_deque_t*  deque  = &pool->deques[worker->thread];
+
+    if (worker->thread > 0) {
+        parallel_spawned = true;
+    }
+
+    do {
+        uint32_t task;
+        while (deque_pop(deque, &task)) {
+            const size_t begin = (size_t) task * pool->grain;
+            const size_t end   = begin + pool->grain < pool->n ? begin + pool->grain : pool->n;
+            pool->fn(pool->ctx, begin, end, worker->thread);
+        }
+    } while (deque_steal(pool, worker->thread));
+
+    return NULL;
+}
+
+bool parallel_is_worker(void) {
+    return parallel_spawned;
+}
+
+size_t parallel_thread_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t) count : 1;
+}
+
+void parallel_for(size_t n, size_t grain, size_t n_threads, parallel_fn_t fn, void* ctx) {
+    if (0 == n) {
+        return;
+    }
+
+    if (0 == n_threads) {
+        n_threads = parallel_thread_count();
+    }
+    if (n_threads > PARALLEL_MAX_THREADS) {
+        n_threads = PARALLEL_MAX_THREADS;
+    }
+    if (0 == grain) {
+        grain = n / (8 * n_threads);
+    }
+    if (0 == grain) {
+        grain = 1;
+    }
+
+    // Task indices are 32-bit; coarsen the grain for very large index spaces
+    while ((n + grain - 1) / grain > UINT32_MAX) {
+        grain *= 2;
+    }
+
+    const size_t n_tasks = (n + grain - 1) / grain;
+    if (n_threads > n_tasks) {
+        n_threads = n_tasks;
+    }
+
+    if (1 == n_threads) {
+        for (size_t begin = 0; begin < n; begin += grain) {
+            fn(ctx, begin, begin + grain < n ? begin + grain : n, 0);
+        }
+        return;
+    }
+
+    parallel_deque_t  deques[PARALLEL_MAX_THREADS];
+    parallel_worker_t workers[PARALLEL_MAX_THREADS];
+    pthread_t         threads[PARALLEL_MAX_THREADS];
+    bool              started[PARALLEL_MAX_THREADS];
+
+    parallel_pool_t pool = {n, grain, n_threads, fn, ctx, deques};
+
+    // Deal out contiguous task ranges so neighbouring tasks share a worker
+    for (size_t i = 0; i < n_threads; ++i) {
+        const uint32_t begin = (uint32_t) (n_tasks * i / n_threads);
+        const uint32_t end   = (uint32_t) (n_tasks * (i + 1) / n_threads);
+        atomic_init(&deques[i].range, range_pack(begin, end));
+        workers[i].pool   = &pool;
+        workers[i].thread = i;
+    }
+
+    // A worker that fails to start simply has its range stolen by worker 0
+    for (size_t i = 1; i < n_threads; ++i) {
+        started[i] = 0 == pthread_create(&threads[i], NULL, parallel_worker, &workers[i]);
+    }
+
+    parallel_worker(&workers[0]);
+
+    for (size_t i = 1; i < n_threads; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
@@ -0,0 +1,365 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/profile.c
+ *
+ * @brief Per-kernel counters, perf_event_open() sampling and periodic dumps.
+ *
+ * Totals are relaxed atomics indexed by kernel, so recording a call costs a
+ * handful of uncontended adds plus one clock read at each end. Only the
+ * outermost sample on a thread reads the hardware counters, three read()
+ * calls at each end.
+ */
+
+#include "profile.h"
+#include "parallel.h"
+
+#if defined(FIXED_POINT_PROFILE)
+    #include <linux/perf_event.h>
+    #include <pthread.h>
+    #include <stdatomic.h>
+    #include <string.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+static const char* const profile_kernel_names[PROFILE_MAX_KERNEL] = {
+    [PROFILE_QUANTIZE_ROW]      = "quantize_row",
+    [PROFILE_DEQUANTIZE_ROW]    = "dequantize_row",
+    [PROFILE_QUANTIZE_TENSOR]   = "quantize_tensor",
+    [PROFILE_QUANTIZE_ACT]      = "quantize_act",
+    [PROFILE_GEMM_QUANT]        = "gemm_quant",
+    [PROFILE_GEMM_BF16]         = "gemm_bf16",
+    [PROFILE_GEMV_LUT]          = "gemv_lut",
+    [PROFILE_BLAS_HALF]         = "blas_half",
+    [PROFILE_REDUCE]            = "reduce",
+    [PROFILE_COMPARE]           = "compare",
+    [PROFILE_NORM]              = "norm",
+    [PROFILE_CONV2D]            = "conv2d",
+    [PROFILE_RESAMPLE]          = "resample",
+    [PROFILE_NCO]               = "nco",
+    [PROFILE_CIC]               = "cic",
+    [PROFILE_QUANTIZE_AFFINE]   = "quantize_affine",
+    [PROFILE_DEQUANTIZE_AFFINE] = "dequantize_affine",
+    [PROFILE_REQUANTIZE]        = "requantize",
+};
+
+const char* profile_kernel_name(profile_kernel_t kernel) {
+    return kernel < PROFILE_MAX_KERNEL ? profile_kernel_names[kernel] : NULL;
+}
+
+#if defined(FIXED_POINT_PROFILE)
+
+/// Hardware events sampled per thread: cycles, instructions, cache misses.
+    #define PROFILE_N_EVENTS 3
+
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t elements;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t nanoseconds;
+    _Atomic uint64_t hardware[PROFILE_N_EVENTS];
+} profile_totals_t;
+
+typedef struct {
+    int  fds[PROFILE_N_EVENTS];
+    bool opened; // open attempted, successfully or not
+    bool active; // an owner sample is running
+} profile_thread_t;
+
+static profile_totals_t profile_totals[PROFILE_MAX_KERNEL];
+
+static _Thread_local profile_thread_t profile_thread = {{-1, -1, -1}, false, false};
+
+static pthread_once_t profile_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  profile_key;
+
+/*
+ * Hardware counters
+ */
+
+static void profile_thread_close(void* arg) {
+    profile_thread_t* thread = (profile_thread_t*) arg;
+    for (size_t e = 0; e < PROFILE_N_EVENTS; ++e) {
+        if (thread->fds[e] >= 0) {
+            close(thread->fds[e]);
+            thread->fds[e] = -1;
+        }
+    }
+}
+
+static void profile_key_create(void) {
+    pthread_key_create(&profile_key, profile_thread_close);
+}
+
+static int profile_open_event(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.inherit        = 1; // threads spawned later add their counts on exit
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void profile_thread_open(void) {
+    static const uint64_t events[PROFILE_N_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+    };
+
+    profile_thread.opened = true;
+    for (size_t e = 0; e < PROFILE_N_EVENTS; ++e) {
+        profile_thread.fds[e] = profile_open_event(events[e]);
+    }
+
+    pthread_once(&profile_key_once, profile_key_create);
+    pthread_setspecific(profile_key, &profile_thread);
+}
+
+static void profile_read(uint64_t values[PROFILE_N_EVENTS]) {
+    for (size_t e = 0; e < PROFILE_N_EVENTS; ++e) {
+        const int fd    = profile_thread.fds[e];
+        uint64_t  value = 0;
+        if (fd < 0 || sizeof(value) != read(fd, &value, sizeof(value))) {
+            value = 0;
+        }
+        values[e] = value;
+    }
+}
+
+static uint64_t profile_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * UINT64_C(1000000000) + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Sampling
+ */
+
+bool profile_enabled(void) {
+    return true;
+}
+
+void profile_begin(profile_sample_t* sample) {
+    sample->owner = false;
+
+    if (!profile_thread.active && !parallel_is_worker()) {
+        if (!profile_thread.opened) {
+            profile_thread_open();
+        }
+        sample->owner         = true;
+        profile_thread.active = true;
+        profile_read(sample->hardware);
+    }
+
+    sample->start_ns = profile_now();
+}
+
+void profile_end(
+    profile_sample_t* sample, profile_kernel_t kernel, uint64_t elements, uint64_t bytes
+) {
+    const uint64_t    elapsed = profile_now() - sample->start_ns;
+    profile_totals_t* totals  = &profile_totals[kernel];
+
+    atomic_fetch_add_explicit(&totals->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&totals->elements, elements, memory_order_relaxed);
+    atomic_fetch_add_explicit(&totals->bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&totals->nanoseconds, elapsed, memory_order_relaxed);
+
+    if (sample->owner) {
+        uint64_t stop[PROFILE_N_EVENTS];
+        profile_read(stop);
+        for (size_t e = 0; e < PROFILE_N_EVENTS; ++e) {
+            const uint64_t delta = stop[e] - sample->hardware[e];
+            atomic_fetch_add_explicit(&totals->hardware[e], delta, memory_order_relaxed);
+        }
+        profile_thread.active = false;
+    }
+}
+
+bool profile_query(profile_kernel_t kernel, profile_counters_t* counters) {
+    if (kernel >= PROFILE_MAX_KERNEL) {
+        return false;
+    }
+
+    const profile_totals_t* totals = &profile_totals[kernel];
+    counters->calls                = atomic_load_explicit(&totals->calls, memory_order_relaxed);
+    counters->elements             = atomic_load_explicit(&totals->elements, memory_order_relaxed);
+    counters->bytes                = atomic_load_explicit(&totals->bytes, memory_order_relaxed);
+    counters->nanoseconds  = atomic_load_explicit(&totals->nanoseconds, memory_order_relaxed);
+    counters->cycles       = atomic_load_explicit(&totals->hardware[0], memory_order_relaxed);
+    counters->instructions = atomic_load_explicit(&totals->hardware[1], memory_order_relaxed);
+    counters->cache_misses = atomic_load_explicit(&totals->hardware[2], memory_order_relaxed);
+    return true;
+}
+
+void profile_reset(void) {
+    for (size_t k = 0; k < PROFILE_MAX_KERNEL; ++k) {
+        profile_totals_t* totals = &profile_totals[k];
+        atomic_store_explicit(&totals->calls, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals->elements, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals->bytes, 0, memory_order_relaxed);
+        atomic_store_explicit(&totals->nanoseconds, 0, memory_order_relaxed);
+        for (size_t e = 0; e < PROFILE_N_EVENTS; ++e) {
+            atomic_store_explicit(&totals->hardware[e], 0, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * Reporting
+ */
+
+void profile_dump(FILE* stream) {
+    fprintf(
+        stream,
+        "%-16s %10s %14s %10s %10s %8s %14s %6s %12s\n",
+        "kernel",
+        "calls",
+        "elements",
+        "MiB",
+        "ms",
+        "GiB/s",
+        "cycles",
+        "IPC",
+        "cache-miss"
+    );
+
+    for (size_t k = 0; k < PROFILE_MAX_KERNEL; ++k) {
+        profile_counters_t c;
+        profile_query((profile_kernel_t) k, &c);
+        if (0 == c.calls) {
+            continue;
+        }
+
+        const double seconds = (double) c.nanoseconds * 1e-9;
+        fprintf(
+            stream,
+            "%-16s %10llu %14llu %10.1f %10.2f %8.2f %14llu %6.2f %12llu\n",
+            profile_kernel_names[k],
+            (unsigned long long) c.calls,
+            (unsigned long long) c.elements,
+            (double) c.bytes / (1 << 20),
+            seconds * 1e3,
+            seconds > 0 ? (double) c.bytes / (1 << 30) / seconds : 0.0,
+            (unsigned long long) c.cycles,
+            c.cycles ? (double) c.instructions / (double) c.cycles : 0.0,
+            (unsigned long long) c.cache_misses
+        );
+    }
+    fflush(stream);
+}
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_t       thread;
+    bool            running;
+    bool            stop;
+    FILE*           stream;
+    uint32_t        interval_ms;
+} profile_dumper = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+static void* profile_dump_loop(void* arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&profile_dumper.lock);
+    while (!profile_dumper.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        const uint64_t interval = (uint64_t) profile_dumper.interval_ms * 1000000;
+        const uint64_t ns       = (uint64_t) deadline.tv_nsec + interval;
+        deadline.tv_sec += (time_t) (ns / 1000000000);
+        deadline.tv_nsec = (long) (ns % 1000000000);
+
+        // Sleep until the deadline; an early wake-up only happens on stop
+        pthread_cond_t*  wake = &profile_dumper.wake;
+        pthread_mutex_t* lock = &profile_dumper.lock;
+        while (!profile_dumper.stop && 0 == pthread_cond_timedwait(wake, lock, &deadline)) {}
+
+        profile_dump(profile_dumper.stream);
+    }
+    pthread_mutex_unlock(&profile_dumper.lock);
+
+    return NULL;
+}
+
+bool profile_dump_start(FILE* stream, uint32_t interval_ms) {
+    pthread_mutex_lock(&profile_dumper.lock);
+    if (profile_dumper.running) {
+        pthread_mutex_unlock(&profile_dumper.lock);
+        return false;
+    }
+
+    pthread_t* thread          = &profile_dumper.thread;
+    profile_dumper.stream      = stream;
+    profile_dumper.interval_ms = interval_ms;
+    profile_dumper.stop        = false;
+    profile_dumper.running     = 0 == pthread_create(thread, NULL, profile_dump_loop, NULL);
+
+    const bool running = profile_dumper.running;
+    pthread_mutex_unlock(&profile_dumper.lock);
+    return running;
+}
+
+void profile_dump_stop(void) {
+    pthread_mutex_lock(&profile_dumper.lock);
+    if (!profile_dumper.running) {
+        pthread_mutex_unlock(&profile_dumper.lock);
+        return;
+    }
+    profile_dumper.stop = true;
+    pthread_cond_signal(&profile_dumper.wake);
+    pthread_mutex_unlock(&profile_dumper.lock);
+
+    pthread_join(profile_dumper.thread, NULL);
+    profile_dumper.running = false;
+}
+
+#else
+
+bool profile_enabled(void) {
+    return false;
+}
+
+void profile_begin(profile_sample_t* sample) {
+    (void) sample;
+}
+
+void profile_end(
+    profile_sample_t* sample, profile_kernel_t kernel, uint64_t elements, uint64_t bytes
+) {
+    (void) sample;
+    (void) kernel;
+    (void) elements;
+    (void) bytes;
+}
+
+bool profile_query(profile_kernel_t kernel, profile_counters_t* counters) {
+    (void) kernel;
+    (void) counters;
+    return false;
+}
+
+void profile_reset(void) {}
+
+void profile_dump(FILE* stream) {
+    (void) stream;
+}
+
+bool profile_dump_start(FILE* stream, uint32_t interval_ms) {
+    (void) stream;
+    (void) interval_ms;
+    return false;
+}
+
+void profile_dump_stop(void) {}
+
+#endif
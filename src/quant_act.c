@@ -0,0 +1,150 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_act.c
+ *
+ * @brief Single-pass absmax and int8 quantization of activation rows.
+ */
+
+#include "quant_act.h"
+#include "parallel.h"
+#include "profile.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+typedef struct {
+    const void* src;
+    bool        bf16;
+    quant_k8_t* dst;
+    size_t      cols;
+} quant_act_task_t;
+
+// Portable rounding of one scaled value; the AVX2 kernel reproduces it lane by lane
+static inline int8_t act_quant(float q) {
+    return (int8_t) (isnan(q) ? 0.0f : nearbyintf(fminf(127.0f, fmaxf(-127.0f, q))));
+}
+
+#if defined(__AVX2__)
+
+static inline __m256 act_load(const void* src, bool bf16, size_t offset) {
+    if (bf16) {
+        const __m128i h = _mm_loadu_si128((const __m128i*) ((const bfloat16_t*) src + offset));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    }
+    return _mm256_loadu_ps((const float*) src + offset);
+}
+
+static void quantize_act_block(const void* src, bool bf16, size_t offset, quant_k8_t* dst) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    __m256 v[4];
+    __m256 amax = _mm256_setzero_ps();
+    for (int t = 0; t < 4; ++t) {
+        v[t] = act_load(src, bf16, offset + 8 * t);
+        // maxps returns its second operand for NaN, so NaN lanes are skipped like fmaxf()
+        amax = _mm256_max_ps(_mm256_andnot_ps(sign, v[t]), amax);
+    }
+
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(amax), _mm256_extractf128_ps(amax, 1));
+    m        = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m        = _mm_max_ss(m, _mm_movehdup_ps(m));
+
+    const float delta     = _mm_cvtss_f32(m) / 127.0f;
+    const float inv_delta = delta ? 1.0f / delta : 0.0f;
+    const __m256 id       = _mm256_set1_ps(inv_delta);
+
+    dst->scale = encode_float16(delta);
+
+    // NaN quantizes to 0 and everything else clamps to [-127, 127], as in act_quant()
+    const __m256 lo = _mm256_set1_ps(-127.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    __m256i      i[4];
+    for (int t = 0; t < 4; ++t) {
+        const __m256 q = _mm256_mul_ps(v[t], id);
+        const __m256 c = _mm256_min_ps(_mm256_max_ps(q, lo), hi);
+        // cvtps rounds to nearest even under the default MXCSR mode
+        i[t] = _mm256_cvtps_epi32(_mm256_and_ps(c, _mm256_cmp_ps(q, q, _CMP_ORD_Q)));
+    }
+
+    // Packs interleave 128-bit lanes; the final permute restores element order
+    __m256i p = _mm256_packs_epi16(_mm256_packs_epi32(i[0], i[1]), _mm256_packs_epi32(i[2], i[3]));
+    p         = _mm256_permutevar8x32_epi32(p, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+    _mm256_storeu_si256((__m256i*) dst->quants, p);
+}
+
+#else
+
+static void quantize_act_block(const void* src, bool bf16, size_t offset, quant_k8_t* dst) {
+    float v[QUANT_BLOCK_SIZE];
+    float amax = 0.0f;
+    for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+        v[i] = bf16 ? decode_bfloat16(((const bfloat16_t*) src)[offset + i])
+                    : ((const float*) src)[offset + i];
+        amax = fmaxf(amax, fabsf(v[i]));
+    }
+
+    const float delta     = amax / 127.0f;
+    const float inv_delta = delta ? 1.0f / delta : 0.0f;
+
+    dst->scale = encode_float16(delta);
+    for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+        dst->quants[i] = act_quant(v[i] * inv_delta);
+    }
+}
+
+#endif
+
+static void quantize_act_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const quant_act_task_t* task     = (const quant_act_task_t*) ctx;
+    const size_t            n_blocks = task->cols / QUANT_BLOCK_SIZE;
+    (void) thread;
+
+    for (size_t row = begin; row < end; ++row) {
+        for (size_t b = 0; b < n_blocks; ++b) {
+            quantize_act_block(
+                task->src,
+                task->bf16,
+                row * task->cols + b * QUANT_BLOCK_SIZE,
+                task->dst + row * n_blocks + b
+            );
+        }
+    }
+}
+
+static void quantize_act_k8(
+    const void* src, bool bf16, quant_k8_t* dst, size_t rows, size_t cols, size_t n_threads
+) {
+    assert(cols % QUANT_BLOCK_SIZE == 0);
+
+    PROFILE_BEGIN(sample);
+
+    quant_act_task_t task = {src, bf16, dst, cols};
+    if (1 == n_threads) {
+        quantize_act_rows(&task, 0, rows, 0);
+    } else {
+        parallel_for(rows, 0, n_threads, quantize_act_rows, &task);
+    }
+
+    PROFILE_END(
+        sample,
+        PROFILE_QUANTIZE_ACT,
+        rows * cols,
+        rows * (cols * (bf16 ? sizeof(bfloat16_t) : sizeof(float))
+                + quant_row_size(TYPE_QUANT_K8, cols))
+    );
+}
+
+void quantize_act_k8_f32(
+    const float* src, quant_k8_t* dst, size_t rows, size_t cols, size_t n_threads
+) {
+    quantize_act_k8(src, false, dst, rows, cols, n_threads);
+}
+
+void quantize_act_k8_bf16(
+    const bfloat16_t* src, quant_k8_t* dst, size_t rows, size_t cols, size_t n_threads
+) {
+    quantize_act_k8(src, true, dst, rows, cols, n_threads);
+}
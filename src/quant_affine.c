@@ -0,0 +1,240 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_affine.c
+ *
+ * @brief Affine int8 quantization and integer-only requantization kernels.
+ *
+ * The AVX2 requantizer mirrors fixed_mul_shift() lane for lane: a left
+ * shift that saturates when shifting back does not restore the input, 64-bit
+ * products of the even and odd lanes formed separately, nudged, shifted down
+ * by 31 and blended back together, then rounding by a per-lane variable
+ * shift. Its output is bit-identical to the scalar path.
+ */
+
+#include "quant_affine.h"
+#include "profile.h"
+#include "requantize_kernel.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+quant_affine_t quant_affine_params(float min, float max) {
+    quant_affine_t params;
+
+    // Real zero must be exactly representable so zero padding stays exact
+    min = fminf(min, 0.0f);
+    max = fmaxf(max, 0.0f);
+
+    params.scale = (max - min) / 255.0f;
+    if (0.0f == params.scale) {
+        params.scale      = 1.0f;
+        params.zero_point = 0;
+        return params;
+    }
+
+    const float zero_point = nearbyintf(-128.0f - min / params.scale);
+    params.zero_point      = (int32_t) fminf(127.0f, fmaxf(-128.0f, zero_point));
+    return params;
+}
+
+void quantize_affine_rows(
+    const float* src, int8_t* dst, size_t rows, size_t cols, const quant_affine_t* params
+) {
+    PROFILE_BEGIN(sample);
+
+    for (size_t r = 0; r < rows; ++r) {
+        const float inv_scale  = 1.0f / params[r].scale;
+        const float zero_point = (float) params[r].zero_point;
+
+        for (size_t c = 0; c < cols; ++c) {
+            const float q         = nearbyintf(src[r * cols + c] * inv_scale) + zero_point;
+            dst[r * cols + c] = (int8_t) fminf(127.0f, fmaxf(-128.0f, q));
+        }
+    }
+
+    PROFILE_END(sample, PROFILE_QUANTIZE_AFFINE, rows * cols, rows * cols * (sizeof(float) + 1));
+}
+
+void dequantize_affine_rows(
+    const int8_t* src, float* dst, size_t rows, size_t cols, const quant_affine_t* params
+) {
+    PROFILE_BEGIN(sample);
+
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            dst[r * cols + c] = params[r].scale * (src[r * cols + c] - params[r].zero_point);
+        }
+    }
+
+    PROFILE_END(sample, PROFILE_DEQUANTIZE_AFFINE, rows * cols, rows * cols * (1 + sizeof(float)));
+}
+
+quant_multiplier_t quant_multiplier_from_float(double real) {
+    quant_multiplier_t m = {0, 0};
+    if (!(real > 0.0)) {
+        return m;
+    }
+
+    int     exponent;
+    double  mantissa = frexp(real, &exponent); // real = mantissa * 2^exponent, mantissa in [0.5, 1)
+    int64_t q        = (int64_t) llround(mantissa * (double) ((int64_t) 1 << Q31_SIZE));
+    if (((int64_t) 1 << Q31_SIZE) == q) {
+        q /= 2;
+        exponent++;
+    }
+
+    // Multipliers too small for a 31-bit shift round to zero
+    if (-exponent > 31) {
+        return m;
+    }
+
+    // fixed_mul_shift() shifts left by at most 31; larger reals saturate any nonzero input anyway
+    if (exponent > 31) {
+        m.multiplier = INT32_MAX;
+        m.shift      = -31;
+        return m;
+    }
+
+    m.multiplier = (int32_t) q;
+    m.shift      = -exponent;
+    return m;
+}
+
+quant_multiplier_t quant_multiplier_from_fixed16(fixed16_t real) {
+    quant_multiplier_t m = {0, 0};
+    if (real <= 0) {
+        return m;
+    }
+
+    // Move the leading one to bit 30: real = (q / 2^31) * 2^(FIXED_SIZE - 1 - lz)
+    const int lz = __builtin_clz((uint32_t) real) - 1;
+    m.multiplier = real << lz;
+    m.shift      = lz - (Q31_SIZE - FIXED_SIZE);
+    return m;
+}
+
+int8_t requantize(int32_t acc, quant_multiplier_t m, int32_t zero_point) {
+    const int32_t q = fixed_mul_shift(acc, m.multiplier, m.shift) + zero_point;
+    return (int8_t) (q < -128 ? -128 : (q > 127 ? 127 : q));
+}
+
+// Accumulator plus bias, saturated to int32 instead of overflowing
+static inline int32_t add_bias(int32_t acc, int32_t bias) {
+    const int64_t sum = (int64_t) acc + bias;
+    return (int32_t) (sum < INT32_MIN ? INT32_MIN : (sum > INT32_MAX ? INT32_MAX : sum));
+}
+
+#if defined(__AVX2__)
+
+// Eight-lane add_bias(): on overflow, both operands share a sign the wrapped sum lacks
+static inline __m256i add_bias_lanes(__m256i acc, __m256i bias) {
+    const __m256i sum       = _mm256_add_epi32(acc, bias);
+    const __m256i overflow  = _mm256_andnot_si256(
+        _mm256_xor_si256(acc, bias), _mm256_xor_si256(acc, sum)
+    );
+    const __m256i saturated = _mm256_xor_si256(
+        _mm256_srai_epi32(acc, 31), _mm256_set1_epi32(INT32_MAX)
+    );
+    return _mm256_blendv_epi8(sum, saturated, _mm256_srai_epi32(overflow, 31));
+}
+
+// Eight-lane fixed_mul_shift() with per-lane multipliers and shifts
+static inline __m256i requantize_lanes(__m256i x, __m256i multiplier, __m256i shift) {
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i one   = _mm256_set1_epi32(1);
+    const __m256i max   = _mm256_set1_epi32(INT32_MAX);
+    const __m256i nudge = _mm256_set1_epi64x((int64_t) 1 << (Q31_SIZE - 1));
+    const __m256i left  = _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero);
+    const __m256i right = _mm256_max_epi32(shift, zero);
+
+    // Saturate lanes whose left shift drops significant bits, as the int64 scalar path does
+    const __m256i shifted   = _mm256_sllv_epi32(x, left);
+    const __m256i exact     = _mm256_cmpeq_epi32(_mm256_srav_epi32(shifted, left), x);
+    const __m256i saturated = _mm256_xor_si256(_mm256_srai_epi32(x, 31), max);
+    x                       = _mm256_blendv_epi8(saturated, shifted, exact);
+
+    // Rounding doubling high multiply; bits 31..62 of each product are the result
+    __m256i even = _mm256_mul_epi32(x, multiplier);
+    __m256i odd  = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(multiplier, 32));
+    even         = _mm256_srli_epi64(_mm256_add_epi64(even, nudge), Q31_SIZE);
+    odd          = _mm256_slli_epi64(_mm256_add_epi64(odd, nudge), 32 - Q31_SIZE);
+    x            = _mm256_blend_epi32(even, odd, 0xAA);
+
+    // Round to nearest, ties away from zero
+    const __m256i mask      = _mm256_sub_epi32(_mm256_sllv_epi32(one, right), one);
+    const __m256i remainder = _mm256_and_si256(x, mask);
+    const __m256i half      = _mm256_srai_epi32(mask, 1);
+    const __m256i threshold = _mm256_add_epi32(half, _mm256_srli_epi32(x, 31));
+    const __m256i round     = _mm256_cmpgt_epi32(remainder, threshold);
+    return _mm256_sub_epi32(_mm256_srav_epi32(x, right), round);
+}
+
+#endif
+
+void requantize_rows_kernel(
+    const int32_t* acc,
+    int8_t*        dst,
+    size_t         rows,
+    size_t         channels,
+    const int32_t* bias,
+    const int32_t* multiplier,
+    const int32_t* shift,
+    int32_t        zero_point
+) {
+    for (size_t r = 0; r < rows; ++r) {
+        const int32_t* x = acc + r * channels;
+        int8_t*        y = dst + r * channels;
+        size_t         c = 0;
+
+#if defined(__AVX2__)
+        const __m256i zp = _mm256_set1_epi32(zero_point);
+        for (; c + 8 <= channels; c += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (x + c));
+            if (bias) {
+                v = add_bias_lanes(v, _mm256_loadu_si256((const __m256i*) (bias + c)));
+            }
+
+            v = requantize_lanes(
+                v,
+                _mm256_loadu_si256((const __m256i*) (multiplier + c)),
+                _mm256_loadu_si256((const __m256i*) (shift + c))
+            );
+            v = _mm256_add_epi32(v, zp);
+
+            // Saturating packs clamp to [-128, 127]
+            const __m128i lo = _mm256_castsi256_si128(v);
+            const __m128i w  = _mm_packs_epi32(lo, _mm256_extracti128_si256(v, 1));
+            _mm_storel_epi64((__m128i*) (y + c), _mm_packs_epi16(w, w));
+        }
+#endif
+
+        for (; c < channels; ++c) {
+            const quant_multiplier_t m = {multiplier[c], shift[c]};
+            y[c] = requantize(bias ? add_bias(x[c], bias[c]) : x[c], m, zero_point);
+        }
+    }
+}
+
+void requantize_rows(
+    const int32_t* acc,
+    int8_t*        dst,
+    size_t         rows,
+    size_t         channels,
+    const int32_t* bias,
+    const int32_t* multiplier,
+    const int32_t* shift,
+    int32_t        zero_point
+) {
+    PROFILE_BEGIN(sample);
+
+    requantize_rows_kernel(acc, dst, rows, channels, bias, multiplier, shift, zero_point);
+
+    PROFILE_END(
+        sample,
+        PROFILE_REQUANTIZE,
+        rows * channels,
+        rows * channels * (sizeof(int32_t) + 1) + (bias ? 3 : 2) * channels * sizeof(int32_t)
+    );
+}
@@ -0,0 +1,236 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_calib.c
+ *
+ * @brief Per-channel min/max, mean square and |x| histograms over calibration data.
+ *
+ * Rows are consumed channel-contiguous, so min, max and the sum of squares
+ * update eight channels per vector without any horizontal work. Histogram
+ * bin indices come from the same vector with an integer shift of the
+ * magnitude bits; only the final increments are scalar.
+ *
+ * The parallel update splits channels rather than rows: every task owns a
+ * disjoint column range of the shared state, so no partial histograms are
+ * allocated and each channel sees its rows in the same order as a serial pass.
+ */
+
+#include "quant_calib.h"
+#include "parallel.h"
+
+#include <float.h>
+#include <string.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+    #include <immintrin.h>
+#endif
+
+/// Magnitude bits of 2^CALIB_EXP_MIN shifted down to bin resolution.
+#define CALIB_BIN_OFFSET ((127 + CALIB_EXP_MIN) << CALIB_SUB_BITS)
+
+/// Channels per parallel task are rounded up to whole vectors.
+#define CALIB_CHANNEL_GRAIN 8
+
+static inline size_t calib_bin(float value) {
+    const int32_t bin = (int32_t) ((encode_float32(value) & 0x7FFFFFFF) >> (23 - CALIB_SUB_BITS))
+                        - CALIB_BIN_OFFSET;
+    return bin < 0 ? 0 : (bin >= CALIB_BINS ? CALIB_BINS - 1 : (size_t) bin);
+}
+
+calib_stats_t* malloc_calib(size_t n_channels) {
+    calib_stats_t* stats = (calib_stats_t*) calloc(1, sizeof(calib_stats_t));
+    if (!stats) {
+        return NULL;
+    }
+
+    stats->n_channels = n_channels;
+    stats->min        = (float*) malloc(n_channels * sizeof(float));
+    stats->max        = (float*) malloc(n_channels * sizeof(float));
+    stats->sum_sq     = (double*) malloc(n_channels * sizeof(double));
+    stats->histogram  = (uint64_t*) malloc(n_channels * CALIB_BINS * sizeof(uint64_t));
+    if (!stats->min || !stats->max || !stats->sum_sq || !stats->histogram) {
+        free_calib(stats);
+        return NULL;
+    }
+
+    calib_reset(stats);
+    return stats;
+}
+
+void free_calib(calib_stats_t* stats) {
+    if (stats) {
+        free(stats->min);
+        free(stats->max);
+        free(stats->sum_sq);
+        free(stats->histogram);
+        free(stats);
+    }
+}
+
+void calib_reset(calib_stats_t* stats) {
+    stats->n_rows = 0;
+    for (size_t c = 0; c < stats->n_channels; ++c) {
+        stats->min[c]    = FLT_MAX;
+        stats->max[c]    = -FLT_MAX;
+        stats->sum_sq[c] = 0.0;
+    }
+    memset(stats->histogram, 0, stats->n_channels * CALIB_BINS * sizeof(uint64_t));
+}
+
+// Accumulates channels [begin, end) of every row; leaves n_rows to the caller
+static void calib_update_channels(
+    calib_stats_t* stats, const float* x, size_t rows, size_t begin, size_t end
+) {
+    const size_t n_channels = stats->n_channels;
+
+    for (size_t r = 0; r < rows; ++r) {
+        const float* row = x + r * n_channels;
+        size_t       c   = begin;
+
+#if defined(__AVX2__) && defined(__FMA__)
+        const __m256i magnitude = _mm256_set1_epi32(0x7FFFFFFF);
+        const __m256i offset    = _mm256_set1_epi32(CALIB_BIN_OFFSET);
+        const __m256i last      = _mm256_set1_epi32(CALIB_BINS - 1);
+
+        for (; c + 8 <= end; c += 8) {
+            const __m256 v = _mm256_loadu_ps(row + c);
+
+            // min/max return their second operand on NaN, so NaNs never stick
+            _mm256_storeu_ps(stats->min + c, _mm256_min_ps(v, _mm256_loadu_ps(stats->min + c)));
+            _mm256_storeu_ps(stats->max + c, _mm256_max_ps(v, _mm256_loadu_ps(stats->max + c)));
+
+            const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+            const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+            _mm256_storeu_pd(
+                stats->sum_sq + c, _mm256_fmadd_pd(lo, lo, _mm256_loadu_pd(stats->sum_sq + c))
+            );
+            _mm256_storeu_pd(
+                stats->sum_sq + c + 4,
+                _mm256_fmadd_pd(hi, hi, _mm256_loadu_pd(stats->sum_sq + c + 4))
+            );
+
+            __m256i bin = _mm256_and_si256(_mm256_castps_si256(v), magnitude);
+            bin         = _mm256_sub_epi32(_mm256_srli_epi32(bin, 23 - CALIB_SUB_BITS), offset);
+            bin         = _mm256_min_epi32(_mm256_max_epi32(bin, _mm256_setzero_si256()), last);
+
+            int32_t bins[8];
+            _mm256_storeu_si256((__m256i*) bins, bin);
+            for (size_t i = 0; i < 8; ++i) {
+                stats->histogram[(c + i) * CALIB_BINS + bins[i]]++;
+            }
+        }
+#endif
+
+        for (; c < end; ++c) {
+            const float v     = row[c];
+            stats->min[c]     = fminf(stats->min[c], v);
+            stats->max[c]     = fmaxf(stats->max[c], v);
+            stats->sum_sq[c] += (double) v * v;
+            stats->histogram[c * CALIB_BINS + calib_bin(v)]++;
+        }
+    }
+}
+
+void calib_update(calib_stats_t* stats, const float* x, size_t rows) {
+    calib_update_channels(stats, x, rows, 0, stats->n_channels);
+    stats->n_rows += rows;
+}
+
+bool calib_merge(calib_stats_t* dst, const calib_stats_t* src) {
+    if (dst->n_channels != src->n_channels) {
+        return false;
+    }
+
+    for (size_t c = 0; c < dst->n_channels; ++c) {
+        dst->min[c]     = fminf(dst->min[c], src->min[c]);
+        dst->max[c]     = fmaxf(dst->max[c], src->max[c]);
+        dst->sum_sq[c] += src->sum_sq[c];
+    }
+    for (size_t i = 0; i < dst->n_channels * CALIB_BINS; ++i) {
+        dst->histogram[i] += src->histogram[i];
+    }
+    dst->n_rows += src->n_rows;
+
+    return true;
+}
+
+typedef struct {
+    calib_stats_t* stats;
+    const float*   x;
+    size_t         rows;
+} calib_task_t;
+
+static void calib_update_task(void* ctx, size_t begin, size_t end, size_t thread) {
+    const calib_task_t* task = (const calib_task_t*) ctx;
+    (void) thread;
+
+    calib_update_channels(task->stats, task->x, task->rows, begin, end);
+}
+
+bool calib_update_parallel(calib_stats_t* stats, const float* x, size_t rows, size_t n_threads) {
+    if (0 == n_threads) {
+        n_threads = parallel_thread_count();
+    }
+    if (0 == rows || 0 == stats->n_channels) {
+        return true;
+    }
+
+    const size_t per_thread = (stats->n_channels + n_threads - 1) / n_threads;
+    const size_t vectors    = (per_thread + CALIB_CHANNEL_GRAIN - 1) / CALIB_CHANNEL_GRAIN;
+    const size_t grain      = vectors * CALIB_CHANNEL_GRAIN;
+
+    calib_task_t task = {stats, x, rows};
+    parallel_for(stats->n_channels, grain, n_threads, calib_update_task, &task);
+    stats->n_rows += rows;
+
+    return true;
+}
+
+float calib_absmax(const calib_stats_t* stats, size_t channel) {
+    if (0 == stats->n_rows) {
+        return 0.0f;
+    }
+    return fmaxf(fabsf(stats->min[channel]), fabsf(stats->max[channel]));
+}
+
+void calib_bin_bounds(size_t bin, float* lower, float* upper) {
+    const uint32_t first = (uint32_t) (bin + CALIB_BIN_OFFSET) << (23 - CALIB_SUB_BITS);
+    const uint32_t next  = (uint32_t) (bin + 1 + CALIB_BIN_OFFSET) << (23 - CALIB_SUB_BITS);
+    *lower               = 0 == bin ? 0.0f : decode_float32(first);
+    *upper               = CALIB_BINS - 1 == bin ? INFINITY : decode_float32(next);
+}
+
+float calib_percentile(const calib_stats_t* stats, size_t channel, float p) {
+    const float absmax = calib_absmax(stats, channel);
+    if (p >= 100.0f || 0 == stats->n_rows) {
+        return absmax;
+    }
+
+    const uint64_t* histogram = stats->histogram + channel * CALIB_BINS;
+    const double    target    = (p > 0.0f ? p : 0.0f) / 100.0 * (double) stats->n_rows;
+
+    uint64_t cumulative = 0;
+    for (size_t bin = 0; bin < CALIB_BINS; ++bin) {
+        cumulative += histogram[bin];
+        if ((double) cumulative > target) {
+            float lower, upper;
+            calib_bin_bounds(bin, &lower, &upper);
+            const float mid = isinf(upper) ? lower : 0.5f * (lower + upper);
+            return fminf(mid, absmax);
+        }
+    }
+
+    return absmax;
+}
+
+void calib_clip(const calib_stats_t* stats, float p, float* clip) {
+    for (size_t c = 0; c < stats->n_channels; ++c) {
+        clip[c] = calib_percentile(stats, c, p);
+    }
+}
+
+void calib_importance(const calib_stats_t* stats, float* importance) {
+    for (size_t c = 0; c < stats->n_channels; ++c) {
+        importance[c] = stats->n_rows ? (float) (stats->sum_sq[c] / (double) stats->n_rows) : 1.0f;
+    }
+}
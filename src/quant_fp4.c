@@ -0,0 +1,174 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_fp4.c
+ *
+ * @brief 4-bit codebook block formats: E2M1 floating point and NormalFloat4.
+ */
+
+#include "quant_fp4.h"
+#include "quant_mx.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+// E2M1 values indexed by code: sign in bit 3
+static const float fp4_codebook[FP4_CODEBOOK_SIZE] = {
+    0.0f, 0.5f, 1.0f, 1.5f, 2.0f, 3.0f, 4.0f, 6.0f,
+    -0.0f, -0.5f, -1.0f, -1.5f, -2.0f, -3.0f, -4.0f, -6.0f,
+};
+
+// NormalFloat4 quantiles, ascending
+static const float nf4_codebook[FP4_CODEBOOK_SIZE] = {
+    -1.0f,
+    -0.6961928009986877f,
+    -0.5250730514526367f,
+    -0.39491748809814453f,
+    -0.28444138169288635f,
+    -0.18477343022823334f,
+    -0.09105003625154495f,
+    0.0f,
+    0.07958029955625534f,
+    0.16093020141124725f,
+    0.24611230194568634f,
+    0.33791524171829224f,
+    0.44070982933044434f,
+    0.5626170039176941f,
+    0.7229568362236023f,
+    1.0f,
+};
+
+/*
+ * Element codecs
+ */
+
+uint8_t encode_nf4(float value) {
+    // The nearest entry is the number of midpoints below the value
+    uint8_t index = 0;
+    for (size_t i = 0; i < FP4_CODEBOOK_SIZE - 1; ++i) {
+        index += value > 0.5f * (nf4_codebook[i] + nf4_codebook[i + 1]);
+    }
+    return index;
+}
+
+float decode_nf4(uint8_t bits) {
+    return nf4_codebook[bits & 0x0F];
+}
+
+/*
+ * Codebook decode
+ */
+
+// Expands one split-layout block of nibbles through a 16-entry codebook
+static inline void decode_codebook_block(
+    const uint8_t* quants, const float* codebook, float scale, float* y
+) {
+#if defined(__AVX2__)
+    // Two 8-entry halves; bit 3 of the index selects between them
+    const __m256 lower = _mm256_mul_ps(_mm256_loadu_ps(codebook), _mm256_set1_ps(scale));
+    const __m256 upper = _mm256_mul_ps(_mm256_loadu_ps(codebook + 8), _mm256_set1_ps(scale));
+
+    const __m128i bytes = _mm_loadu_si128((const __m128i*) quants);
+    const __m128i mask  = _mm_set1_epi8(0x0F);
+    const __m128i lo    = _mm_and_si128(bytes, mask);
+    const __m128i hi    = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+
+    // Byte shifts need immediates, so the upper eight nibbles are unpacked instead
+    const __m128i groups[4] = {lo, _mm_unpackhi_epi64(lo, lo), hi, _mm_unpackhi_epi64(hi, hi)};
+    for (size_t g = 0; g < 4; ++g) {
+        const __m256i index  = _mm256_cvtepu8_epi32(groups[g]);
+        const __m256  select = _mm256_castsi256_ps(_mm256_slli_epi32(index, 28));
+        const __m256  value  = _mm256_blendv_ps(
+            _mm256_permutevar8x32_ps(lower, index), _mm256_permutevar8x32_ps(upper, index), select
+        );
+        _mm256_storeu_ps(y + 8 * g, value);
+    }
+#else
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+    for (size_t i = 0; i < half; ++i) {
+        y[i]        = codebook[quants[i] & 0x0F] * scale;
+        y[i + half] = codebook[quants[i] >> 4] * scale;
+    }
+#endif
+}
+
+/*
+ * 4-bit E2M1 blocks
+ */
+
+void quantize_row_fp4(const float* src, quant_fp4_t* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float* x = src + b * QUANT_BLOCK_SIZE;
+
+        float amax = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            amax = fmaxf(amax, fabsf(x[i]));
+        }
+
+        // Map the largest magnitude onto 6, the largest E2M1 value
+        const float scale     = amax / 6.0f;
+        const float inv_scale = scale ? 1.0f / scale : 0.0f;
+
+        dst[b].scale = encode_float16(scale);
+        for (size_t i = 0; i < half; ++i) {
+            const uint8_t lo = encode_fp4_e2m1(x[i] * inv_scale);
+            const uint8_t hi = encode_fp4_e2m1(x[i + half] * inv_scale);
+
+            dst[b].quants[i] = (uint8_t) (lo | (hi << 4));
+        }
+    }
+}
+
+void dequantize_row_fp4(const quant_fp4_t* src, float* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        decode_codebook_block(
+            src[b].quants, fp4_codebook, decode_float16(src[b].scale), dst + b * QUANT_BLOCK_SIZE
+        );
+    }
+}
+
+/*
+ * 4-bit NormalFloat blocks
+ */
+
+void quantize_row_nf4(const float* src, quant_nf4_t* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float* x = src + b * QUANT_BLOCK_SIZE;
+
+        float amax = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            amax = fmaxf(amax, fabsf(x[i]));
+        }
+
+        const float inv_amax = amax ? 1.0f / amax : 0.0f;
+
+        dst[b].scale = encode_float16(amax);
+        for (size_t i = 0; i < half; ++i) {
+            const uint8_t lo = encode_nf4(x[i] * inv_amax);
+            const uint8_t hi = encode_nf4(x[i + half] * inv_amax);
+
+            dst[b].quants[i] = (uint8_t) (lo | (hi << 4));
+        }
+    }
+}
+
+void dequantize_row_nf4(const quant_nf4_t* src, float* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        decode_codebook_block(
+            src[b].quants, nf4_codebook, decode_float16(src[b].scale), dst + b * QUANT_BLOCK_SIZE
+        );
+    }
+}
@@ -0,0 +1,241 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_gemm.c
+ *
+ * @brief Fused dequantize-and-multiply kernels for quantized weights.
+ *
+ * The output is tiled into GEMM_MR x GEMM_NR blocks. For every weight block
+ * along k the tile expands GEMM_NR weight blocks once and reuses them across
+ * GEMM_MR activation rows, while each activation load is reused across the
+ * GEMM_NR weight rows. Work is split over weight rows with parallel_for().
+ */
+
+#include "quant_gemm.h"
+#include "parallel.h"
+#include "profile.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+    #include <immintrin.h>
+#endif
+
+typedef struct {
+    data_type_t    wtype;
+    const uint8_t* w;
+    size_t         row_size;
+    const void*    a;
+    bool           a_bf16;
+    float*         c;
+    size_t         m;
+    size_t         n;
+    size_t         k;
+} gemm_task_t;
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// Expands one weight block into four vectors of eight scaled floats
+static inline void gemm_load_block(data_type_t wtype, const uint8_t* block, __m256 out[4]) {
+    if (TYPE_QUANT_K8 == wtype) {
+        const quant_k8_t* q = (const quant_k8_t*) block;
+        const __m256      d = _mm256_set1_ps(decode_float16(q->scale));
+        for (int t = 0; t < 4; ++t) {
+            const __m128i v = _mm_loadl_epi64((const __m128i*) (q->quants + 8 * t));
+            out[t]          = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)), d);
+        }
+    } else {
+        const quant_k4_t* q    = (const quant_k4_t*) block;
+        const __m256      d    = _mm256_set1_ps(decode_float16(q->scale));
+        const __m128i     mask = _mm_set1_epi8(0x0F);
+        const __m128i     bias = _mm_set1_epi8(8);
+        const __m128i     v    = _mm_loadu_si128((const __m128i*) q->quants);
+        const __m128i     lo   = _mm_sub_epi8(_mm_and_si128(v, mask), bias);
+        const __m128i     hi   = _mm_sub_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), bias);
+
+        out[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(lo)), d);
+        out[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(lo, 8))), d);
+        out[2] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(hi)), d);
+        out[3] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(hi, 8))), d);
+    }
+}
+
+// Loads eight activations, widening bfloat16 by a 16-bit shift like decode_bfloat16()
+static inline __m256 gemm_load_act(const void* a, bool a_bf16, size_t offset) {
+    if (a_bf16) {
+        const __m128i h = _mm_loadu_si128((const __m128i*) ((const bfloat16_t*) a + offset));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    }
+    return _mm256_loadu_ps((const float*) a + offset);
+}
+
+static inline float gemm_hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s        = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s        = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+static inline __attribute__((always_inline)) void
+gemm_tile(const gemm_task_t* task, size_t i0, size_t j0, size_t mr, size_t nr) {
+    const size_t block_bytes = quant_type_size(task->wtype);
+    const size_t n_blocks    = task->k / QUANT_BLOCK_SIZE;
+
+    __m256 acc[GEMM_MR][GEMM_NR];
+    for (size_t i = 0; i < GEMM_MR; ++i) {
+        for (size_t j = 0; j < GEMM_NR; ++j) {
+            acc[i][j] = _mm256_setzero_ps();
+        }
+    }
+
+    for (size_t b = 0; b < n_blocks; ++b) {
+        __m256 wv[GEMM_NR][4];
+        for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+            const uint8_t* row = task->w + (j0 + j) * task->row_size;
+            gemm_load_block(task->wtype, row + b * block_bytes, wv[j]);
+        }
+
+        for (size_t i = 0; i < GEMM_MR && i < mr; ++i) {
+            const size_t base = (i0 + i) * task->k + b * QUANT_BLOCK_SIZE;
+            for (size_t t = 0; t < 4; ++t) {
+                const __m256 av = gemm_load_act(task->a, task->a_bf16, base + 8 * t);
+                for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+                    acc[i][j] = _mm256_fmadd_ps(av, wv[j][t], acc[i][j]);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < GEMM_MR && i < mr; ++i) {
+        for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+            task->c[(i0 + i) * task->n + j0 + j] = gemm_hsum(acc[i][j]);
+        }
+    }
+}
+
+#else
+
+static inline __attribute__((always_inline)) void
+gemm_tile(const gemm_task_t* task, size_t i0, size_t j0, size_t mr, size_t nr) {
+    const size_t block_bytes = quant_type_size(task->wtype);
+    const size_t n_blocks    = task->k / QUANT_BLOCK_SIZE;
+
+    float acc[GEMM_MR][GEMM_NR] = {{0.0f}};
+
+    for (size_t b = 0; b < n_blocks; ++b) {
+        // One block per weight row; stays resident in L1 for the whole tile. The block
+        // kernels are called directly so gemm_quant() remains the only profiled span.
+        float panel[GEMM_NR][QUANT_BLOCK_SIZE];
+        for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+            const uint8_t* block = task->w + (j0 + j) * task->row_size + b * block_bytes;
+            if (TYPE_QUANT_K8 == task->wtype) {
+                dequantize_row_k8((const quant_k8_t*) block, panel[j], QUANT_BLOCK_SIZE);
+            } else {
+                dequantize_row_k4((const quant_k4_t*) block, panel[j], QUANT_BLOCK_SIZE);
+            }
+        }
+
+        for (size_t i = 0; i < GEMM_MR && i < mr; ++i) {
+            const size_t base = (i0 + i) * task->k + b * QUANT_BLOCK_SIZE;
+            for (size_t t = 0; t < QUANT_BLOCK_SIZE; ++t) {
+                const float av = task->a_bf16
+                                     ? decode_bfloat16(((const bfloat16_t*) task->a)[base + t])
+                                     : ((const float*) task->a)[base + t];
+                for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+                    acc[i][j] += av * panel[j][t];
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < GEMM_MR && i < mr; ++i) {
+        for (size_t j = 0; j < GEMM_NR && j < nr; ++j) {
+            task->c[(i0 + i) * task->n + j0 + j] = acc[i][j];
+        }
+    }
+}
+
+#endif
+
+// Computes every activation row against weight row tiles [begin, end) * GEMM_NR
+static void gemm_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const gemm_task_t* task = (const gemm_task_t*) ctx;
+    (void) thread;
+
+    for (size_t i0 = 0; i0 < task->m; i0 += GEMM_MR) {
+        const size_t mr = task->m - i0 < GEMM_MR ? task->m - i0 : GEMM_MR;
+
+        for (size_t tile = begin; tile < end; ++tile) {
+            const size_t j0 = tile * GEMM_NR;
+            const size_t nr = task->n - j0 < GEMM_NR ? task->n - j0 : GEMM_NR;
+
+            if (GEMM_MR == mr && GEMM_NR == nr) {
+                gemm_tile(task, i0, j0, GEMM_MR, GEMM_NR);
+            } else {
+                gemm_tile(task, i0, j0, mr, nr);
+            }
+        }
+    }
+}
+
+static void gemm_quant(
+    data_type_t wtype,
+    const void* w,
+    const void* a,
+    bool        a_bf16,
+    float*      c,
+    size_t      m,
+    size_t      n,
+    size_t      k,
+    size_t      n_threads
+) {
+    assert(TYPE_QUANT_K8 == wtype || TYPE_QUANT_K4 == wtype);
+    assert(k % QUANT_BLOCK_SIZE == 0);
+
+    gemm_task_t task;
+    task.wtype    = wtype;
+    task.w        = (const uint8_t*) w;
+    task.row_size = quant_row_size(wtype, k);
+    task.a        = a;
+    task.a_bf16   = a_bf16;
+    task.c        = c;
+    task.m        = m;
+    task.n        = n;
+    task.k        = k;
+
+    PROFILE_BEGIN(sample);
+
+    parallel_for((n + GEMM_NR - 1) / GEMM_NR, 0, n_threads, gemm_rows, &task);
+
+    PROFILE_END(
+        sample,
+        PROFILE_GEMM_QUANT,
+        m * n * k,
+        n * task.row_size + m * k * (a_bf16 ? sizeof(bfloat16_t) : sizeof(float))
+            + m * n * sizeof(float)
+    );
+}
+
+void gemm_quant_f32(
+    data_type_t  wtype,
+    const void*  w,
+    const float* a,
+    float*       c,
+    size_t       m,
+    size_t       n,
+    size_t       k,
+    size_t       n_threads
+) {
+    gemm_quant(wtype, w, a, false, c, m, n, k, n_threads);
+}
+
+void gemm_quant_bf16(
+    data_type_t       wtype,
+    const void*       w,
+    const bfloat16_t* a,
+    float*            c,
+    size_t            m,
+    size_t            n,
+    size_t            k,
+    size_t            n_threads
+) {
+    gemm_quant(wtype, w, a, true, c, m, n, k, n_threads);
+}
@@ -0,0 +1,336 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_lut.c
+ *
+ * @brief Bit-plane table-lookup GEMV for low-bit block weights.
+ *
+ * For block b the activation tables hold T_g[p] = sum(x[4g + i] for each set
+ * bit i of p), quantized to int8 with one scale per block. A weight level is
+ * q = sum(2^k * plane_k), so
+ *
+ *     sum(q[i] * x[i]) = sum_k 2^k * sum_g T_g[plane_k nibble of group g]
+ *
+ * and the weight's offset is removed afterwards with the block's sum of x.
+ * The per-plane sums fit int16: at most LUT_GROUPS * 127 per plane and
+ * (2^bits - 1) times that across planes.
+ */
+
+#include "quant_lut.h"
+#include "parallel.h"
+#include "profile.h"
+
+#include <string.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+    #include <immintrin.h>
+#endif
+
+/// Runs of LUT_TILE_ROWS index bytes per bit plane (two groups per byte).
+#define LUT_RUNS (LUT_GROUPS / 2)
+
+// Unsigned level of element i within a k4 or k2 block
+static inline int lut_level(data_type_t type, const uint8_t* block, size_t i) {
+    if (TYPE_QUANT_K4 == type) {
+        const quant_k4_t* q = (const quant_k4_t*) block;
+        return i < QUANT_BLOCK_SIZE / 2 ? q->quants[i] & 0x0F
+                                        : q->quants[i - QUANT_BLOCK_SIZE / 2] >> 4;
+    }
+    const quant_k2_t* q = (const quant_k2_t*) block;
+    return (q->quants[i % (QUANT_BLOCK_SIZE / 4)] >> (2 * (i / (QUANT_BLOCK_SIZE / 4)))) & 0x03;
+}
+
+static inline float lut_scale(const uint8_t* block) {
+    // Both block types lead with their half precision scale
+    return decode_float16(((const quant_k4_t*) block)->scale);
+}
+
+lut_matrix_t* malloc_lut_matrix(data_type_t type, const void* w, size_t rows, size_t cols) {
+    if ((TYPE_QUANT_K4 != type && TYPE_QUANT_K2 != type) || cols % QUANT_BLOCK_SIZE != 0) {
+        return NULL;
+    }
+
+    lut_matrix_t* matrix = (lut_matrix_t*) calloc(1, sizeof(lut_matrix_t));
+    if (!matrix) {
+        return NULL;
+    }
+
+    const size_t n_tiles  = (rows + LUT_TILE_ROWS - 1) / LUT_TILE_ROWS;
+    const size_t n_blocks = cols / QUANT_BLOCK_SIZE;
+
+    matrix->type    = type;
+    matrix->rows    = rows;
+    matrix->cols    = cols;
+    matrix->bits    = TYPE_QUANT_K4 == type ? 4 : 2;
+    matrix->offset  = TYPE_QUANT_K4 == type ? 8 : 2;
+    matrix->indices = (uint8_t*) calloc(
+        n_tiles * n_blocks * matrix->bits * LUT_RUNS * LUT_TILE_ROWS, sizeof(uint8_t)
+    );
+    matrix->scales = (float*) calloc(n_tiles * n_blocks * LUT_TILE_ROWS, sizeof(float));
+    if (!matrix->indices || !matrix->scales) {
+        free_lut_matrix(matrix);
+        return NULL;
+    }
+
+    const size_t   row_size    = quant_row_size(type, cols);
+    const size_t   block_bytes = quant_type_size(type);
+    const uint8_t* src         = (const uint8_t*) w;
+
+    // Padding rows of the last tile keep zero indices and a zero scale
+    for (size_t row = 0; row < rows; ++row) {
+        const size_t tile = row / LUT_TILE_ROWS;
+        const size_t r    = row % LUT_TILE_ROWS;
+
+        for (size_t b = 0; b < n_blocks; ++b) {
+            const uint8_t* block = src + row * row_size + b * block_bytes;
+            const size_t   base  = tile * n_blocks + b;
+
+            matrix->scales[base * LUT_TILE_ROWS + r] = lut_scale(block);
+
+            for (size_t g = 0; g < LUT_GROUPS; ++g) {
+                for (size_t k = 0; k < matrix->bits; ++k) {
+                    uint8_t nibble = 0;
+                    for (size_t i = 0; i < LUT_GROUP_SIZE; ++i) {
+                        const int level = lut_level(type, block, g * LUT_GROUP_SIZE + i);
+                        nibble |= (uint8_t) (((level >> k) & 1) << i);
+                    }
+
+                    const size_t run = (base * matrix->bits + k) * LUT_RUNS + g / 2;
+                    matrix->indices[run * LUT_TILE_ROWS + r] |= (uint8_t) (nibble << (4 * (g & 1)));
+                }
+            }
+        }
+    }
+
+    return matrix;
+}
+
+void free_lut_matrix(lut_matrix_t* matrix) {
+    if (matrix) {
+        free(matrix->indices);
+        free(matrix->scales);
+        free(matrix);
+    }
+}
+
+/*
+ * Activation tables
+ */
+
+typedef struct {
+    int8_t* tables; // [block][group][16]
+    float*  scale;  // [block]
+    float*  sum;    // [block]
+} lut_tables_t;
+
+static void lut_build_tables(const float* x, size_t n_blocks, lut_tables_t* t) {
+    for (size_t b = 0; b < n_blocks; ++b) {
+        float table[LUT_GROUPS][16];
+        float amax = 0.0f;
+        float sum  = 0.0f;
+
+        for (size_t g = 0; g < LUT_GROUPS; ++g) {
+            const float* xg = x + b * QUANT_BLOCK_SIZE + g * LUT_GROUP_SIZE;
+
+            // Each subset adds its lowest element to the subset without it
+            table[g][0] = 0.0f;
+            for (int p = 1; p < 16; ++p) {
+                table[g][p] = table[g][p & (p - 1)] + xg[__builtin_ctz(p)];
+                amax        = fmaxf(amax, fabsf(table[g][p]));
+            }
+            sum += table[g][15];
+        }
+
+        const float scale     = amax / 127.0f;
+        const float inv_scale = scale ? 1.0f / scale : 0.0f;
+
+        for (size_t g = 0; g < LUT_GROUPS; ++g) {
+            int8_t* out = t->tables + (b * LUT_GROUPS + g) * 16;
+            for (size_t p = 0; p < 16; ++p) {
+                out[p] = (int8_t) nearbyintf(table[g][p] * inv_scale);
+            }
+        }
+        t->scale[b] = scale;
+        t->sum[b]   = sum;
+    }
+}
+
+/*
+ * Row tile kernels
+ */
+
+typedef struct {
+    const lut_matrix_t* w;
+    const lut_tables_t* t;
+    float*              y;
+} lut_task_t;
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+static void lut_tile(const lut_matrix_t* w, const lut_tables_t* t, size_t tile, float* out) {
+    const size_t  n_blocks = w->cols / QUANT_BLOCK_SIZE;
+    const __m256i low      = _mm256_set1_epi8(0x0F);
+
+    __m256 acc[4];
+    for (int v = 0; v < 4; ++v) {
+        acc[v] = _mm256_setzero_ps();
+    }
+
+    for (size_t b = 0; b < n_blocks; ++b) {
+        const size_t   base  = tile * n_blocks + b;
+        const int8_t*  table = t->tables + b * LUT_GROUPS * 16;
+        const uint8_t* idx   = w->indices + base * w->bits * LUT_RUNS * LUT_TILE_ROWS;
+
+        // Rows 0-15 and 16-31 as int16 lanes
+        __m256i sum_lo = _mm256_setzero_si256();
+        __m256i sum_hi = _mm256_setzero_si256();
+
+        for (size_t k = 0; k < w->bits; ++k) {
+            __m256i plane_lo = _mm256_setzero_si256();
+            __m256i plane_hi = _mm256_setzero_si256();
+
+            for (size_t p = 0; p < LUT_RUNS; ++p) {
+                const __m256i v = _mm256_loadu_si256(
+                    (const __m256i*) (idx + (k * LUT_RUNS + p) * LUT_TILE_ROWS)
+                );
+                const __m256i t0 = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i*) (table + (2 * p) * 16))
+                );
+                const __m256i t1 = _mm256_broadcastsi128_si256(
+                    _mm_loadu_si128((const __m128i*) (table + (2 * p + 1) * 16))
+                );
+
+                const __m256i r0 = _mm256_shuffle_epi8(t0, _mm256_and_si256(v, low));
+                const __m256i r1
+                    = _mm256_shuffle_epi8(t1, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+
+                plane_lo = _mm256_add_epi16(
+                    plane_lo,
+                    _mm256_add_epi16(
+                        _mm256_cvtepi8_epi16(_mm256_castsi256_si128(r0)),
+                        _mm256_cvtepi8_epi16(_mm256_castsi256_si128(r1))
+                    )
+                );
+                plane_hi = _mm256_add_epi16(
+                    plane_hi,
+                    _mm256_add_epi16(
+                        _mm256_cvtepi8_epi16(_mm256_extracti128_si256(r0, 1)),
+                        _mm256_cvtepi8_epi16(_mm256_extracti128_si256(r1, 1))
+                    )
+                );
+            }
+
+            const __m128i shift = _mm_cvtsi32_si128((int) k);
+            sum_lo              = _mm256_add_epi16(sum_lo, _mm256_sll_epi16(plane_lo, shift));
+            sum_hi              = _mm256_add_epi16(sum_hi, _mm256_sll_epi16(plane_hi, shift));
+        }
+
+        const __m256 ts     = _mm256_set1_ps(t->scale[b]);
+        const __m256 offset = _mm256_set1_ps((float) w->offset * t->sum[b]);
+        const __m128i parts[4] = {
+            _mm256_castsi256_si128(sum_lo),
+            _mm256_extracti128_si256(sum_lo, 1),
+            _mm256_castsi256_si128(sum_hi),
+            _mm256_extracti128_si256(sum_hi, 1),
+        };
+
+        for (int v = 0; v < 4; ++v) {
+            const __m256 dot = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(parts[v]));
+            const __m256 d   = _mm256_loadu_ps(w->scales + base * LUT_TILE_ROWS + 8 * v);
+            acc[v] = _mm256_fmadd_ps(d, _mm256_fmsub_ps(ts, dot, offset), acc[v]);
+        }
+    }
+
+    for (int v = 0; v < 4; ++v) {
+        _mm256_storeu_ps(out + 8 * v, acc[v]);
+    }
+}
+
+#else
+
+static void lut_tile(const lut_matrix_t* w, const lut_tables_t* t, size_t tile, float* out) {
+    const size_t n_blocks = w->cols / QUANT_BLOCK_SIZE;
+
+    for (size_t r = 0; r < LUT_TILE_ROWS; ++r) {
+        out[r] = 0.0f;
+    }
+
+    for (size_t b = 0; b < n_blocks; ++b) {
+        const size_t   base  = tile * n_blocks + b;
+        const int8_t*  table = t->tables + b * LUT_GROUPS * 16;
+        const uint8_t* idx   = w->indices + base * w->bits * LUT_RUNS * LUT_TILE_ROWS;
+
+        int32_t sum[LUT_TILE_ROWS] = {0};
+        for (size_t k = 0; k < w->bits; ++k) {
+            for (size_t p = 0; p < LUT_RUNS; ++p) {
+                const uint8_t* run = idx + (k * LUT_RUNS + p) * LUT_TILE_ROWS;
+                for (size_t r = 0; r < LUT_TILE_ROWS; ++r) {
+                    const int lookup = table[(2 * p) * 16 + (run[r] & 0x0F)]
+                                       + table[(2 * p + 1) * 16 + (run[r] >> 4)];
+                    sum[r] += lookup << k;
+                }
+            }
+        }
+
+        const float offset = (float) w->offset * t->sum[b];
+        for (size_t r = 0; r < LUT_TILE_ROWS; ++r) {
+            out[r] += w->scales[base * LUT_TILE_ROWS + r] * (t->scale[b] * (float) sum[r] - offset);
+        }
+    }
+}
+
+#endif
+
+static void lut_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const lut_task_t* task = (const lut_task_t*) ctx;
+    (void) thread;
+
+    for (size_t tile = begin; tile < end; ++tile) {
+        float        out[LUT_TILE_ROWS];
+        const size_t row0 = tile * LUT_TILE_ROWS;
+        const size_t n    = task->w->rows - row0 < LUT_TILE_ROWS ? task->w->rows - row0
+                                                                 : LUT_TILE_ROWS;
+
+        lut_tile(task->w, task->t, tile, out);
+        memcpy(task->y + row0, out, n * sizeof(float));
+    }
+}
+
+bool gemv_lut(const lut_matrix_t* w, const float* x, float* y, size_t n_threads) {
+    const size_t n_blocks = w->cols / QUANT_BLOCK_SIZE;
+    const size_t n_tiles  = (w->rows + LUT_TILE_ROWS - 1) / LUT_TILE_ROWS;
+
+    lut_tables_t t;
+    t.tables = (int8_t*) malloc(n_blocks * LUT_GROUPS * 16 * sizeof(int8_t));
+    t.scale  = (float*) malloc(n_blocks * sizeof(float));
+    t.sum    = (float*) malloc(n_blocks * sizeof(float));
+    if (!t.tables || !t.scale || !t.sum) {
+        free(t.tables);
+        free(t.scale);
+        free(t.sum);
+        return false;
+    }
+
+    PROFILE_BEGIN(sample);
+
+    lut_build_tables(x, n_blocks, &t);
+
+    lut_task_t task = {w, &t, y};
+    if (1 == n_threads) {
+        lut_rows(&task, 0, n_tiles, 0);
+    } else {
+        parallel_for(n_tiles, 0, n_threads, lut_rows, &task);
+    }
+
+    PROFILE_END(
+        sample,
+        PROFILE_GEMV_LUT,
+        w->rows * w->cols,
+        w->rows * quant_row_size(w->type, w->cols) + (w->cols + w->rows) * sizeof(float)
+    );
+
+    free(t.tables);
+    free(t.scale);
+    free(t.sum);
+    return true;
+}
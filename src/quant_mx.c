@@ -0,0 +1,419 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_mx.c
+ *
+ * @brief OCP Microscaling block quantization and dot products.
+ *
+ * Dot products never decode elements to float when they can avoid it:
+ * INT8 elements are integers, and every FP4 or FP6 value is an integer
+ * multiple of 1/2 or 1/8, so their block sums run in 8-bit integer SIMD and
+ * the power-of-two scales are folded into a single exponent add per block.
+ * FP8 elements are rebased into half precision bit patterns and widened with
+ * F16C where available.
+ */
+
+#include "quant_mx.h"
+#include "simd_convert.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+/// Largest unbiased exponent of each element format, used to place the shared scale.
+#define MX_FP8_EMAX  8
+#define MX_FP6_EMAX  2
+#define MX_FP4_EMAX  2
+#define MX_INT8_EMAX 0
+
+/// Fractional bits of MXINT8 elements.
+#define MX_INT8_FRAC 6
+
+// FP4 (E2M1) codes as integer multiples of 1/2
+static const int8_t mx_fp4_int[16] = {
+    0, 1, 2, 3, 4, 6, 8, 12, 0, -1, -2, -3, -4, -6, -8, -12,
+};
+
+// FP6 (E2M3) codes as integer multiples of 1/8
+static const int8_t mx_fp6_int[64] = {
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,   10,  11,  12,  13,  14,  15,
+    16,  18,  20,  22,  24,  26,  28,  30,  32,  36,  40,  44,  48,  52,  56,  60,
+    0,   -1,  -2,  -3,  -4,  -5,  -6,  -7,  -8,  -9,  -10, -11, -12, -13, -14, -15,
+    -16, -18, -20, -22, -24, -26, -28, -30, -32, -36, -40, -44, -48, -52, -56, -60,
+};
+
+/*
+ * Element codecs
+ */
+
+float decode_e8m0(uint8_t bits) {
+    if (MX_SCALE_NAN == bits) {
+        return NAN;
+    }
+    return ldexpf(1.0f, (int) bits - 127);
+}
+
+// Saturating round-to-nearest-even encoder for formats without Inf or NaN
+static uint8_t encode_minifloat(float value, int mbits, int bias, int max_code) {
+    const int   sign = signbit(value) ? 1 : 0;
+    const float abs  = fabsf(value);
+    int         code;
+
+    if (isnan(abs)) {
+        return 0;
+    }
+
+    if (abs < ldexpf(1.0f, 1 - bias)) {
+        // Subnormals are multiples of 2^(1 - bias - mbits)
+        code = (int) nearbyintf(ldexpf(abs, bias - 1 + mbits));
+    } else {
+        int         exponent;
+        const float mantissa = frexpf(abs, &exponent); // abs = (2 * mantissa) * 2^(exponent - 1)
+        int         fraction = (int) nearbyintf((2.0f * mantissa - 1.0f) * (float) (1 << mbits));
+        exponent             = exponent - 1 + bias;
+        if ((1 << mbits) == fraction) {
+            fraction = 0;
+            exponent++;
+        }
+        code = (exponent << mbits) | fraction;
+    }
+
+    if (code > max_code) {
+        code = max_code;
+    }
+    return (uint8_t) ((sign << (2 + mbits)) | code);
+}
+
+static float decode_minifloat(uint8_t bits, int mbits, int bias) {
+    const int sign     = (bits >> (2 + mbits)) & 1;
+    const int exponent = (bits >> mbits) & 0x03;
+    const int fraction = bits & ((1 << mbits) - 1);
+
+    const float mantissa = 1.0f + (float) fraction / (float) (1 << mbits);
+    const float value    = 0 == exponent ? ldexpf((float) fraction, 1 - bias - mbits)
+                                         : ldexpf(mantissa, exponent - bias);
+    return sign ? -value : value;
+}
+
+uint8_t encode_fp6_e2m3(float value) {
+    return encode_minifloat(value, 3, 1, 0x1F);
+}
+
+float decode_fp6_e2m3(uint8_t bits) {
+    return decode_minifloat(bits & 0x3F, 3, 1);
+}
+
+uint8_t encode_fp4_e2m1(float value) {
+    return encode_minifloat(value, 1, 1, 0x07);
+}
+
+float decode_fp4_e2m1(uint8_t bits) {
+    return decode_minifloat(bits & 0x0F, 1, 1);
+}
+
+/*
+ * Block layout helpers
+ */
+
+static inline uint8_t mx_block_scale(const uint8_t* block) {
+    // Every MX block leads with its E8M0 scale
+    return block[0];
+}
+
+static inline void mx_fp6_unpack(const uint8_t* packed, uint8_t codes[MX_BLOCK_SIZE]) {
+    for (size_t i = 0; i < MX_BLOCK_SIZE; i += 4) {
+        const uint8_t* p    = packed + i / 4 * 3;
+        const uint32_t word = p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16);
+        for (size_t j = 0; j < 4; ++j) {
+            codes[i + j] = (word >> (6 * j)) & 0x3F;
+        }
+    }
+}
+
+static inline void mx_fp6_pack(const uint8_t codes[MX_BLOCK_SIZE], uint8_t* packed) {
+    for (size_t i = 0; i < MX_BLOCK_SIZE; i += 4) {
+        uint32_t word = 0;
+        for (size_t j = 0; j < 4; ++j) {
+            word |= (uint32_t) (codes[i + j] & 0x3F) << (6 * j);
+        }
+        packed[i / 4 * 3]     = word & 0xFF;
+        packed[i / 4 * 3 + 1] = (word >> 8) & 0xFF;
+        packed[i / 4 * 3 + 2] = (word >> 16) & 0xFF;
+    }
+}
+
+static int mx_emax(data_type_t type) {
+    switch (type) {
+        case TYPE_MX_FP8:
+            return MX_FP8_EMAX;
+        case TYPE_MX_FP6:
+            return MX_FP6_EMAX;
+        case TYPE_MX_FP4:
+            return MX_FP4_EMAX;
+        default:
+            return MX_INT8_EMAX;
+    }
+}
+
+/*
+ * Bulk conversion
+ */
+
+void quantize_row_mx(data_type_t type, const float* src, void* dst, size_t n) {
+    assert(n % MX_BLOCK_SIZE == 0);
+
+    const size_t block_bytes = quant_type_size(type);
+
+    for (size_t b = 0; b < n / MX_BLOCK_SIZE; ++b) {
+        const float* x     = src + b * MX_BLOCK_SIZE;
+        uint8_t*     block = (uint8_t*) dst + b * block_bytes;
+
+        float amax = 0.0f;
+        bool  nan  = false;
+        for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+            nan  = nan || isnan(x[i]);
+            amax = fmaxf(amax, fabsf(x[i]));
+        }
+
+        memset(block, 0, block_bytes);
+        if (nan || isinf(amax)) {
+            block[0] = MX_SCALE_NAN;
+            continue;
+        }
+
+        // Shared exponent: floor(log2(amax)) - emax, clamped to the E8M0 range
+        int shared = -127;
+        if (amax > 0.0f) {
+            int exponent;
+            frexpf(amax, &exponent);
+            shared = exponent - 1 - mx_emax(type);
+        }
+        shared   = shared < -127 ? -127 : (shared > 127 ? 127 : shared);
+        block[0] = (uint8_t) (shared + 127);
+
+        uint8_t codes[MX_BLOCK_SIZE];
+        for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+            const float v = ldexpf(x[i], -shared);
+            switch (type) {
+                case TYPE_MX_FP8:
+                    codes[i] = encode_float8(v);
+                    break;
+                case TYPE_MX_FP6:
+                    codes[i] = encode_fp6_e2m3(v);
+                    break;
+                case TYPE_MX_FP4:
+                    codes[i] = encode_fp4_e2m1(v);
+                    break;
+                default: {
+                    const float q = nearbyintf(ldexpf(v, MX_INT8_FRAC));
+                    codes[i]      = (uint8_t) (int8_t) fminf(127.0f, fmaxf(-127.0f, q));
+                    break;
+                }
+            }
+        }
+
+        switch (type) {
+            case TYPE_MX_FP6:
+                mx_fp6_pack(codes, block + 1);
+                break;
+            case TYPE_MX_FP4:
+                for (size_t i = 0; i < MX_BLOCK_SIZE / 2; ++i) {
+                    block[1 + i] = (uint8_t) (codes[2 * i] | (codes[2 * i + 1] << 4));
+                }
+                break;
+            default:
+                memcpy(block + 1, codes, MX_BLOCK_SIZE);
+                break;
+        }
+    }
+}
+
+void dequantize_row_mx(data_type_t type, const void* src, float* dst, size_t n) {
+    assert(n % MX_BLOCK_SIZE == 0);
+
+    const size_t block_bytes = quant_type_size(type);
+
+    for (size_t b = 0; b < n / MX_BLOCK_SIZE; ++b) {
+        const uint8_t* block = (const uint8_t*) src + b * block_bytes;
+        const float    scale = decode_e8m0(mx_block_scale(block));
+        float*         y     = dst + b * MX_BLOCK_SIZE;
+
+        uint8_t codes[MX_BLOCK_SIZE];
+        switch (type) {
+            case TYPE_MX_FP6:
+                mx_fp6_unpack(block + 1, codes);
+                break;
+            case TYPE_MX_FP4:
+                for (size_t i = 0; i < MX_BLOCK_SIZE / 2; ++i) {
+                    codes[2 * i]     = block[1 + i] & 0x0F;
+                    codes[2 * i + 1] = block[1 + i] >> 4;
+                }
+                break;
+            default:
+                memcpy(codes, block + 1, MX_BLOCK_SIZE);
+                break;
+        }
+
+        for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+            switch (type) {
+                case TYPE_MX_FP8:
+                    y[i] = decode_float8(codes[i]) * scale;
+                    break;
+                case TYPE_MX_FP6:
+                    y[i] = (float) mx_fp6_int[codes[i]] / 8.0f * scale;
+                    break;
+                case TYPE_MX_FP4:
+                    y[i] = (float) mx_fp4_int[codes[i]] / 2.0f * scale;
+                    break;
+                default:
+                    y[i] = ldexpf((float) (int8_t) codes[i], -MX_INT8_FRAC) * scale;
+                    break;
+            }
+        }
+    }
+}
+
+/*
+ * Dot products
+ */
+
+// Sum of products of two 32-element int8 vectors, exact for the full int8 range
+static inline int32_t mx_dot_i8(const int8_t* a, const int8_t* b) {
+#if defined(__AVX2__)
+    // Widen before multiplying: sign_epi8 cannot negate -128 and maddubs
+    // saturates 2 * 128 * 128, both legal for MXINT8 blocks from other producers
+    const __m128i a_lo = _mm_loadu_si128((const __m128i*) a);
+    const __m128i a_hi = _mm_loadu_si128((const __m128i*) (a + 16));
+    const __m128i b_lo = _mm_loadu_si128((const __m128i*) b);
+    const __m128i b_hi = _mm_loadu_si128((const __m128i*) (b + 16));
+
+    const __m256i sum = _mm256_add_epi32(
+        _mm256_madd_epi16(_mm256_cvtepi8_epi16(a_lo), _mm256_cvtepi8_epi16(b_lo)),
+        _mm256_madd_epi16(_mm256_cvtepi8_epi16(a_hi), _mm256_cvtepi8_epi16(b_hi))
+    );
+
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+#else
+    int32_t sum = 0;
+    for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+#endif
+}
+
+// Expands packed FP4 codes into integer multiples of 1/2
+static inline void mx_fp4_expand(const uint8_t* packed, int8_t out[MX_BLOCK_SIZE]) {
+#if defined(__AVX2__)
+    // Low nibbles then high nibbles: element order is irrelevant to a dot product
+    const __m128i table = _mm_loadu_si128((const __m128i*) mx_fp4_int);
+    const __m128i mask  = _mm_set1_epi8(0x0F);
+    const __m128i v     = _mm_loadu_si128((const __m128i*) packed);
+    _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(table, _mm_and_si128(v, mask)));
+    _mm_storeu_si128(
+        (__m128i*) (out + 16), _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), mask))
+    );
+#else
+    for (size_t i = 0; i < MX_BLOCK_SIZE / 2; ++i) {
+        out[i]      = mx_fp4_int[packed[i] & 0x0F];
+        out[i + 16] = mx_fp4_int[packed[i] >> 4];
+    }
+#endif
+}
+
+// Sum of products of two FP8 blocks, scaled by 2^-16
+static inline float mx_dot_fp8(const uint8_t* a, const uint8_t* b) {
+#if defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    // E4M3 -> binary16 bits, value scaled by 2^-8
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < MX_BLOCK_SIZE; i += 16) {
+        const __m256i ha = simd_load_f8_f16_epi16(a + i);
+        const __m256i hb = simd_load_f8_f16_epi16(b + i);
+
+        acc = _mm256_fmadd_ps(
+            _mm256_cvtph_ps(_mm256_castsi256_si128(ha)),
+            _mm256_cvtph_ps(_mm256_castsi256_si128(hb)),
+            acc
+        );
+        acc = _mm256_fmadd_ps(
+            _mm256_cvtph_ps(_mm256_extracti128_si256(ha, 1)),
+            _mm256_cvtph_ps(_mm256_extracti128_si256(hb, 1)),
+            acc
+        );
+    }
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s        = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s        = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+#else
+    float sum = 0.0f;
+    for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+        sum += decode_float8(a[i]) * decode_float8(b[i]);
+    }
+    return ldexpf(sum, -16);
+#endif
+}
+
+float dot_mx(data_type_t type, const void* a, const void* b, size_t n) {
+    assert(n % MX_BLOCK_SIZE == 0);
+
+    const size_t block_bytes = quant_type_size(type);
+    float        sum         = 0.0f;
+
+    for (size_t blk = 0; blk < n / MX_BLOCK_SIZE; ++blk) {
+        const uint8_t* ba = (const uint8_t*) a + blk * block_bytes;
+        const uint8_t* bb = (const uint8_t*) b + blk * block_bytes;
+        const uint8_t  sa = mx_block_scale(ba);
+        const uint8_t  sb = mx_block_scale(bb);
+
+        if (MX_SCALE_NAN == sa || MX_SCALE_NAN == sb) {
+            return NAN;
+        }
+
+        // Block value = partial * 2^(sa + sb - 254 - bias), bias undoing the integer scaling
+        const int exponent = (int) sa + (int) sb - 254;
+
+        switch (type) {
+            case TYPE_MX_FP8:
+                sum += ldexpf(mx_dot_fp8(ba + 1, bb + 1), exponent + 16);
+                break;
+            case TYPE_MX_FP6: {
+                uint8_t codes[MX_BLOCK_SIZE];
+                int8_t  ia[MX_BLOCK_SIZE];
+                int8_t  ib[MX_BLOCK_SIZE];
+                mx_fp6_unpack(ba + 1, codes);
+                for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+                    ia[i] = mx_fp6_int[codes[i]];
+                }
+                mx_fp6_unpack(bb + 1, codes);
+                for (size_t i = 0; i < MX_BLOCK_SIZE; ++i) {
+                    ib[i] = mx_fp6_int[codes[i]];
+                }
+                sum += ldexpf((float) mx_dot_i8(ia, ib), exponent - 6);
+                break;
+            }
+            case TYPE_MX_FP4: {
+                int8_t ia[MX_BLOCK_SIZE];
+                int8_t ib[MX_BLOCK_SIZE];
+                mx_fp4_expand(ba + 1, ia);
+                mx_fp4_expand(bb + 1, ib);
+                sum += ldexpf((float) mx_dot_i8(ia, ib), exponent - 2);
+                break;
+            }
+            default:
+                sum += ldexpf(
+                    (float) mx_dot_i8((const int8_t*) ba + 1, (const int8_t*) bb + 1),
+                    exponent - 2 * MX_INT8_FRAC
+                );
+                break;
+        }
+    }
+
+    return sum;
+}
@@ -0,0 +1,507 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_norm.c
+ *
+ * @brief Integer-only RMSNorm and LayerNorm.
+ *
+ * A row is held as int32 values v with s fractional bits: s = 16 for
+ * fixed16_t, and 25 minus the largest block exponent for decoded k8 rows.
+ * Deviations d = v * 2^-r - mean use the r that brings cols * d^2 just
+ * under 62 bits. Rows with small values get a negative r, which shifts them
+ * left. The mean then has fractional bits to spare, and its rounding no longer
+ * shows in the output. Both the variance V = sum(d^2) / cols and eps, rescaled
+ * to the same units, are then exact integers.
+ *
+ * The normalized value d / sqrt(V) in Q20 is (d * M) >> S. Here M is a Q31
+ * mantissa taken from fixed_rsqrt() of V normalized into [1, 4), and S
+ * restores the power of four. S is capped at 32 by shortening M, so the 64-bit
+ * products can be shifted logically in AVX2 and still match the scalar
+ * arithmetic shift in their low 32 bits.
+ */
+
+#include "quant_norm.h"
+#include "fixed_math.h"
+#include "parallel.h"
+#include "profile.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+typedef struct {
+    const void*       src;
+    bool              k8_in;
+    void*             dst;
+    bool              k8_out;
+    size_t            cols;
+    const fixed16_t*  gamma;
+    const fixed16_t*  beta;
+    fixed16_t         eps;
+    bool              center;
+    int32_t*          scratch;
+} norm_task_t;
+
+// Scale of a normalized row: z = (d * multiplier + 2^(shift - 1)) >> shift, in Q20
+typedef struct {
+    int32_t multiplier;
+    int     shift;
+} norm_scale_t;
+
+static inline int bit_width_u32(uint32_t x) {
+    return x ? 32 - __builtin_clz(x) : 0;
+}
+
+// x * 2^-r, shifting left for negative r
+static inline int32_t norm_shift(int32_t x, int r) {
+    return r >= 0 ? x >> r : (int32_t) ((uint32_t) x << -r);
+}
+
+#if defined(__AVX2__)
+static inline __m256i norm_shift_epi32(__m256i x, int r) {
+    return r >= 0 ? _mm256_sra_epi32(x, _mm_cvtsi32_si128(r))
+                  : _mm256_sll_epi32(x, _mm_cvtsi32_si128(-r));
+}
+#endif
+
+/*
+ * Scalar helpers
+ */
+
+// Decodes a k8 row to int32 values sharing the largest block exponent; returns their fraction bits
+static int norm_decode_k8(const quant_k8_t* src, size_t n_blocks, int32_t* v) {
+    int emax = 1;
+    for (size_t b = 0; b < n_blocks; ++b) {
+        const int e = (src[b].scale >> 10) & 0x1F;
+        emax        = e > emax ? e : emax;
+    }
+
+    for (size_t b = 0; b < n_blocks; ++b) {
+        // scale = mantissa * 2^(e - 25), with the implicit bit and subnormals folded in
+        const float16_t h        = src[b].scale;
+        const int       e        = (h >> 10) & 0x1F;
+        const int32_t   mantissa = (e ? 0x400 : 0) | (h & 0x3FF);
+        const int32_t   signed_m = (h & 0x8000) ? -mantissa : mantissa;
+        const int       down     = emax - (e ? e : 1);
+        const int       shift    = down > 31 ? 31 : down;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            v[b * QUANT_BLOCK_SIZE + i] = (src[b].quants[i] * signed_m) >> shift;
+        }
+    }
+
+    return 25 - emax;
+}
+
+// float16 bits of a / (127 * 2^16), rounded to nearest even, for a > 0
+static float16_t norm_k8_scale(uint32_t a) {
+    const uint64_t q = ((uint64_t) a << 32) / 127; // the scale in units of 2^-48
+    const int      t = 63 - __builtin_clzll(q);
+    const int      e = t - 33;                     // biased exponent
+
+    // Normal mantissas keep 11 bits; subnormals are units of 2^-24
+    const int      shift = e >= 1 ? t - 10 : 24;
+    const uint64_t half  = UINT64_C(1) << (shift - 1);
+    const uint64_t rem   = q & ((half << 1) - 1);
+    uint32_t       m     = (uint32_t) (q >> shift);
+    m += rem > half || (rem == half && (m & 1));
+
+    // A rounding carry into bit 11 bumps the exponent through the addition
+    return (float16_t) (((e >= 1 ? e - 1 : 0) << 10) + m);
+}
+
+// Q31 multiplier and shift for 2^NORM_Q / sqrt(v), v > 0
+static norm_scale_t norm_rsqrt_scale(uint64_t v) {
+    // v = m * 4^j * 2^16 with m in [1, 4) as fixed16_t
+    const int       t = 63 - __builtin_clzll(v);
+    const int       j = (t - FIXED_SIZE) >> 1;
+    const fixed16_t m = (fixed16_t) (j >= 0 ? v >> (2 * j) : v << (-2 * j));
+    const fixed16_t r = fixed_rsqrt(m); // in (0.5, 1]
+
+    // d * r * 2^(NORM_Q - 24 - j) as a Q31 product
+    norm_scale_t scale;
+    if (FIXED_VAL == r) {
+        scale.multiplier = INT32_C(1) << 30;
+        scale.shift      = Q31_SIZE - 1 - NORM_Q + FIXED_SIZE / 2 + j;
+    } else {
+        scale.multiplier = r << (Q31_SIZE - FIXED_SIZE);
+        scale.shift      = Q31_SIZE - NORM_Q + FIXED_SIZE / 2 + j;
+    }
+    if (scale.shift > 32) {
+        scale.multiplier >>= scale.shift - 32;
+        scale.shift = 32;
+    }
+    return scale;
+}
+
+/*
+ * Row passes
+ */
+
+static void norm_moments(const int32_t* v, size_t n, int64_t* sum, uint32_t* amax) {
+    int64_t  s = 0;
+    uint32_t a = 0;
+    size_t   i = 0;
+
+#if defined(__AVX2__)
+    __m256i vs = _mm256_setzero_si256();
+    __m256i va = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x  = _mm256_loadu_si256((const __m256i*) (v + i));
+        const __m256i lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x));
+        const __m256i hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1));
+        vs               = _mm256_add_epi64(_mm256_add_epi64(vs, lo), hi);
+        va               = _mm256_max_epu32(va, _mm256_abs_epi32(x));
+    }
+
+    int64_t  s_lanes[4];
+    uint32_t a_lanes[8];
+    _mm256_storeu_si256((__m256i*) s_lanes, vs);
+    _mm256_storeu_si256((__m256i*) a_lanes, va);
+    s = s_lanes[0] + s_lanes[1] + s_lanes[2] + s_lanes[3];
+    for (int k = 0; k < 8; ++k) {
+        a = a_lanes[k] > a ? a_lanes[k] : a;
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const uint32_t x = v[i] < 0 ? 0u - (uint32_t) v[i] : (uint32_t) v[i];
+        s += v[i];
+        a = x > a ? x : a;
+    }
+
+    *sum  = s;
+    *amax = a;
+}
+
+static uint64_t norm_sum_squares(const int32_t* v, size_t n, int32_t mean, int r) {
+    uint64_t s = 0;
+    size_t   i = 0;
+
+#if defined(__AVX2__)
+    const __m256i m   = _mm256_set1_epi32(mean);
+    __m256i       acc = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        const __m256i x = norm_shift_epi32(_mm256_loadu_si256((const __m256i*) (v + i)), r);
+        const __m256i d = _mm256_sub_epi32(x, m);
+        const __m256i o = _mm256_srli_epi64(d, 32);
+        acc             = _mm256_add_epi64(acc, _mm256_mul_epi32(d, d));
+        acc             = _mm256_add_epi64(acc, _mm256_mul_epi32(o, o));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, acc);
+    s = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for (; i < n; ++i) {
+        const int64_t d = norm_shift(v[i], r) - mean;
+        s += (uint64_t) (d * d);
+    }
+    return s;
+}
+
+static inline int32_t norm_apply(
+    int32_t x, int32_t mean, int r, norm_scale_t scale, int32_t g, int32_t b
+) {
+    const int32_t d     = norm_shift(x, r) - mean;
+    const int64_t nudge = INT64_C(1) << (scale.shift - 1);
+    const int32_t z     = (int32_t) (((int64_t) d * scale.multiplier + nudge) >> scale.shift);
+    return (int32_t) (((int64_t) z * g + (INT64_C(1) << (NORM_Q - 1))) >> NORM_Q) + b;
+}
+
+#if defined(__AVX2__)
+
+// (a * b + 2^(shift - 1)) >> shift per lane, low 32 bits, for shift in [1, 32]
+static inline __m256i norm_mul_round_epi32(__m256i a, __m256i b, int shift) {
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m256i nudge = _mm256_set1_epi64x(INT64_C(1) << (shift - 1));
+    const __m256i high  = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    const __m256i even  = _mm256_srl_epi64(_mm256_add_epi64(_mm256_mul_epi32(a, b), nudge), count);
+    const __m256i odd   = _mm256_srl_epi64(_mm256_add_epi64(high, nudge), count);
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+static inline __m256i norm_apply_epi32(
+    __m256i x, __m256i mean, int r, norm_scale_t scale, __m256i g, __m256i b
+) {
+    const __m256i d = _mm256_sub_epi32(norm_shift_epi32(x, r), mean);
+    const __m256i z = norm_mul_round_epi32(d, _mm256_set1_epi32(scale.multiplier), scale.shift);
+    return _mm256_add_epi32(norm_mul_round_epi32(z, g, NORM_Q), b);
+}
+
+#endif
+
+// y[i] for i in [begin, end), in fixed16_t
+static void norm_output(
+    const norm_task_t* task,
+    const int32_t*     v,
+    size_t             begin,
+    size_t             end,
+    int32_t            mean,
+    int                r,
+    norm_scale_t       scale,
+    int32_t*           y
+) {
+    size_t i = begin;
+
+#if defined(__AVX2__)
+    const __m256i m = _mm256_set1_epi32(mean);
+    for (; i + 8 <= end; i += 8) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*) (v + i));
+        const __m256i g = task->gamma ? _mm256_loadu_si256((const __m256i*) (task->gamma + i))
+                                      : _mm256_set1_epi32(FIXED_VAL);
+        const __m256i b = task->beta ? _mm256_loadu_si256((const __m256i*) (task->beta + i))
+                                     : _mm256_setzero_si256();
+        _mm256_storeu_si256((__m256i*) (y + i - begin), norm_apply_epi32(x, m, r, scale, g, b));
+    }
+#endif
+
+    for (; i < end; ++i) {
+        const int32_t g = task->gamma ? task->gamma[i] : FIXED_VAL;
+        const int32_t b = task->beta ? task->beta[i] : 0;
+        y[i - begin]    = norm_apply(v[i], mean, r, scale, g, b);
+    }
+}
+
+// Requantizes one block of fixed16_t outputs to k8 with an integer reciprocal
+static void norm_quantize_block(const int32_t* y, quant_k8_t* dst) {
+    uint32_t a = 0;
+    for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+        const uint32_t x = y[i] < 0 ? 0u - (uint32_t) y[i] : (uint32_t) y[i];
+        a                = x > a ? x : a;
+    }
+
+    if (0 == a) {
+        dst->scale = 0;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            dst->quants[i] = 0;
+        }
+        return;
+    }
+
+    // With a below 2^16, |y| * (127 * 2^23 / a) stays below 2^31
+    const int     down = bit_width_u32(a) > 16 ? bit_width_u32(a) - 16 : 0;
+    const int32_t inv  = (int32_t) ((UINT32_C(127) << 23) / (a >> down));
+    dst->scale         = norm_k8_scale(a);
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i vi   = _mm256_set1_epi32(inv);
+    const __m256i half = _mm256_set1_epi32(1 << 22);
+    const __m256i lo   = _mm256_set1_epi32(-127);
+    const __m256i hi   = _mm256_set1_epi32(127);
+    __m256i       q[4];
+    for (int t = 0; t < 4; ++t) {
+        const __m256i x = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i*) (y + 8 * t)), down);
+        q[t] = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(x, vi), half), 23);
+        q[t] = _mm256_min_epi32(_mm256_max_epi32(q[t], lo), hi);
+    }
+
+    // Packs interleave 128-bit lanes; the final permute restores element order
+    q[0] = _mm256_packs_epi16(_mm256_packs_epi32(q[0], q[1]), _mm256_packs_epi32(q[2], q[3]));
+    q[0] = _mm256_permutevar8x32_epi32(q[0], _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256((__m256i*) dst->quants, q[0]);
+    i = QUANT_BLOCK_SIZE;
+#endif
+
+    for (; i < QUANT_BLOCK_SIZE; ++i) {
+        const int32_t q = ((y[i] >> down) * inv + (1 << 22)) >> 23;
+        dst->quants[i]  = (int8_t) (q < -127 ? -127 : (q > 127 ? 127 : q));
+    }
+}
+
+static void norm_row(const norm_task_t* task, const int32_t* v, int s, size_t row) {
+    const size_t n = task->cols;
+
+    int64_t  sum;
+    uint32_t amax;
+    norm_moments(v, n, &sum, &amax);
+
+    // |d| < 2^(width + 1 - r), so cols * d^2 fits 62 bits
+    const int limit = (62 - bit_width_u32((uint32_t) (n - 1))) / 2;
+    int       r     = bit_width_u32(amax) + 1 - limit;
+
+    // eps * 2^(2s - 2r - 16) must fit 61 bits too; tiny rows then keep fewer fraction bits than eps
+    if (task->eps > 0) {
+        const int t       = 2 * s - FIXED_SIZE - 61 + bit_width_u32((uint32_t) task->eps);
+        const int floor_r = t >= 0 ? (t + 1) / 2 : -(-t / 2);
+        r                 = r > floor_r ? r : floor_r;
+    }
+
+    // Mean in units of 2^-r, rounded to nearest
+    int32_t m = 0;
+    if (task->center) {
+        const int64_t scaled = r >= 0 ? sum : sum * (INT64_C(1) << -r);
+        const int64_t half   = (int64_t) (n / 2);
+        m = (int32_t) ((scaled >= 0 ? scaled + half : scaled - half) / (int64_t) n);
+        m = r >= 0 ? m >> r : m;
+    }
+
+    // eps in units of d^2: eps * 2^(2s - 2r - 16)
+    uint64_t  v_sum = norm_sum_squares(v, n, m, r) / n;
+    const int up    = 2 * s - 2 * r - FIXED_SIZE;
+    if (task->eps > 0) {
+        const uint64_t eps = (uint64_t) task->eps;
+        if (up < 0) {
+            v_sum += up > -64 ? eps >> -up : 0;
+        } else {
+            v_sum += eps << up;
+        }
+    }
+
+    const norm_scale_t scale = 0 == v_sum ? (norm_scale_t) {0, 1} : norm_rsqrt_scale(v_sum);
+
+    if (!task->k8_out) {
+        norm_output(task, v, 0, n, m, r, scale, (fixed16_t*) task->dst + row * n);
+        return;
+    }
+
+    quant_k8_t* dst = (quant_k8_t*) task->dst + row * (n / QUANT_BLOCK_SIZE);
+    int32_t     y[QUANT_BLOCK_SIZE];
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        norm_output(task, v, b * QUANT_BLOCK_SIZE, (b + 1) * QUANT_BLOCK_SIZE, m, r, scale, y);
+        norm_quantize_block(y, dst + b);
+    }
+}
+
+static void norm_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const norm_task_t* task = (const norm_task_t*) ctx;
+    const size_t       n    = task->cols;
+
+    for (size_t row = begin; row < end; ++row) {
+        if (task->k8_in) {
+            const size_t      n_blocks = n / QUANT_BLOCK_SIZE;
+            const quant_k8_t* src      = (const quant_k8_t*) task->src + row * n_blocks;
+            int32_t*          v        = task->scratch + thread * n;
+            const int         s        = norm_decode_k8(src, n_blocks, v);
+            norm_row(task, v, s, row);
+        } else {
+            norm_row(task, (const fixed16_t*) task->src + row * n, FIXED_SIZE, row);
+        }
+    }
+}
+
+// Bytes of one input or output row
+static inline size_t norm_row_bytes(const norm_task_t* task, bool k8) {
+    return k8 ? quant_row_size(TYPE_QUANT_K8, task->cols) : task->cols * sizeof(fixed16_t);
+}
+
+static bool norm(norm_task_t* task, size_t rows, size_t n_threads) {
+    assert(task->cols > 0 && task->cols <= NORM_MAX_COLS);
+    assert(!(task->k8_in || task->k8_out) || task->cols % QUANT_BLOCK_SIZE == 0);
+
+    const size_t n_workers = 0 == n_threads ? parallel_thread_count() : n_threads;
+    task->scratch          = NULL;
+    if (task->k8_in) {
+        task->scratch = (int32_t*) malloc(n_workers * task->cols * sizeof(int32_t));
+        if (!task->scratch) {
+            return false;
+        }
+    }
+
+    PROFILE_BEGIN(sample);
+
+    if (1 == n_workers) {
+        norm_rows(task, 0, rows, 0);
+    } else {
+        parallel_for(rows, 0, n_workers, norm_rows, task);
+    }
+
+    PROFILE_END(
+        sample,
+        PROFILE_NORM,
+        rows * task->cols,
+        rows * (norm_row_bytes(task, task->k8_in) + norm_row_bytes(task, task->k8_out))
+    );
+
+    free(task->scratch);
+    return true;
+}
+
+/*
+ * Public API
+ */
+
+void rms_norm_fixed16(
+    const fixed16_t* src,
+    fixed16_t*       dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    fixed16_t        eps,
+    size_t           n_threads
+) {
+    norm_task_t task = {src, false, dst, false, cols, gamma, NULL, eps, false, NULL};
+    norm(&task, rows, n_threads);
+}
+
+void rms_norm_fixed16_k8(
+    const fixed16_t* src,
+    quant_k8_t*      dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    fixed16_t        eps,
+    size_t           n_threads
+) {
+    norm_task_t task = {src, false, dst, true, cols, gamma, NULL, eps, false, NULL};
+    norm(&task, rows, n_threads);
+}
+
+bool rms_norm_k8(
+    const quant_k8_t* src,
+    quant_k8_t*       dst,
+    size_t            rows,
+    size_t            cols,
+    const fixed16_t*  gamma,
+    fixed16_t         eps,
+    size_t            n_threads
+) {
+    norm_task_t task = {src, true, dst, true, cols, gamma, NULL, eps, false, NULL};
+    return norm(&task, rows, n_threads);
+}
+
+void layer_norm_fixed16(
+    const fixed16_t* src,
+    fixed16_t*       dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    const fixed16_t* beta,
+    fixed16_t        eps,
+    size_t           n_threads
+) {
+    norm_task_t task = {src, false, dst, false, cols, gamma, beta, eps, true, NULL};
+    norm(&task, rows, n_threads);
+}
+
+void layer_norm_fixed16_k8(
+    const fixed16_t* src,
+    quant_k8_t*      dst,
+    size_t           rows,
+    size_t           cols,
+    const fixed16_t* gamma,
+    const fixed16_t* beta,
+    fixed16_t        eps,
+    size_t           n_threads
+) {
+    norm_task_t task = {src, false, dst, true, cols, gamma, beta, eps, true, NULL};
+    norm(&task, rows, n_threads);
+}
+
+bool layer_norm_k8(
+    const quant_k8_t* src,
+    quant_k8_t*       dst,
+    size_t            rows,
+    size_t            cols,
+    const fixed16_t*  gamma,
+    const fixed16_t*  beta,
+    fixed16_t         eps,
+    size_t            n_threads
+) {
+    norm_task_t task = {src, true, dst, true, cols, gamma, beta, eps, true, NULL};
+    return norm(&task, rows, n_threads);
+}
@@ -0,0 +1,403 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/quant_stream.c
+ *
+ * @brief Three stage read/quantize/write pipeline over a ring of chunks.
+ *
+ * Each slot in the ring cycles FREE -> READ -> QUANTIZED -> FREE. Stages
+ * visit slots strictly in sequence order, so output order always matches
+ * input order and a single mutex/condition pair is enough to hand chunks
+ * from one stage to the next.
+ */
+
+#include "quant_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_READ,
+    SLOT_QUANTIZED,
+} slot_state_t;
+
+typedef struct {
+    void*        src;   // Raw input bytes (chunk_size source elements of src_elem bytes)
+    void*        dst;   // Encoded output bytes
+    size_t       n;     // Elements held by this slot
+    size_t       size;  // Encoded bytes held by this slot
+    bool         eof;   // Marks the end of the stream
+    slot_state_t state;
+} quant_slot_t;
+
+typedef struct {
+    int                   src_fd;
+    int                   dst_fd;
+    quant_stream_params_t params;
+    size_t                src_elem;  // Bytes per source element
+    float*                scratch;   // Decoded chunk for non-fp32 sources
+    quant_slot_t*         slots;
+    bool                  failed;
+    quant_stream_stats_t  stats;
+    pthread_mutex_t       lock;
+    pthread_cond_t        ready;
+} quant_stream_t;
+
+/*
+ * Blocking I/O helpers
+ */
+
+static ssize_t read_full(int fd, void* buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t r = read(fd, (uint8_t*) buffer + total, size - total);
+        if (r < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -1;
+        }
+        if (0 == r) {
+            break;
+        }
+        total += (size_t) r;
+    }
+    return (ssize_t) total;
+}
+
+static bool write_full(int fd, const void* buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t w = write(fd, (const uint8_t*) buffer + total, size - total);
+        if (w < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        total += (size_t) w;
+    }
+    return true;
+}
+
+/*
+ * Slot hand-off
+ */
+
+// Waits until slot reaches state; returns false if the pipeline failed meanwhile
+static bool slot_acquire(quant_stream_t* stream, quant_slot_t* slot, slot_state_t state) {
+    pthread_mutex_lock(&stream->lock);
+    while (slot->state != state && !stream->failed) {
+        pthread_cond_wait(&stream->ready, &stream->lock);
+    }
+    bool ok = !stream->failed;
+    pthread_mutex_unlock(&stream->lock);
+    return ok;
+}
+
+static void slot_release(quant_stream_t* stream, quant_slot_t* slot, slot_state_t state) {
+    pthread_mutex_lock(&stream->lock);
+    slot->state = state;
+    pthread_cond_broadcast(&stream->ready);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static void stream_fail(quant_stream_t* stream) {
+    pthread_mutex_lock(&stream->lock);
+    stream->failed = true;
+    pthread_cond_broadcast(&stream->ready);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/*
+ * Pipeline stages
+ */
+
+static void* stream_reader(void* arg) {
+    quant_stream_t* stream = (quant_stream_t*) arg;
+    const size_t    chunk  = stream->params.chunk_size;
+
+    for (size_t seq = 0;; ++seq) {
+        quant_slot_t* slot = &stream->slots[seq % stream->params.n_chunks];
+        if (!slot_acquire(stream, slot, SLOT_FREE)) {
+            return NULL;
+        }
+
+        ssize_t r = read_full(stream->src_fd, slot->src, chunk * stream->src_elem);
+        if (r < 0 || 0 != (size_t) r % stream->src_elem) {
+            stream_fail(stream);
+            return NULL;
+        }
+
+        slot->n   = (size_t) r / stream->src_elem;
+        slot->eof = slot->n < chunk;
+        stream->stats.bytes_read += (uint64_t) r;
+        stream->stats.n_elements += slot->n;
+
+        slot_release(stream, slot, SLOT_READ);
+        if (slot->eof) {
+            return NULL;
+        }
+    }
+}
+
+static void* stream_quantizer(void* arg) {
+    quant_stream_t* stream = (quant_stream_t*) arg;
+    const size_t    block  = quant_block_size(stream->params.dst_type);
+
+    for (size_t seq = 0;; ++seq) {
+        quant_slot_t* slot = &stream->slots[seq % stream->params.n_chunks];
+        if (!slot_acquire(stream, slot, SLOT_READ)) {
+            return NULL;
+        }
+
+        // Pad a trailing partial block with zeros
+        const size_t n_padded = (slot->n + block - 1) / block * block;
+        const float* src      = (const float*) slot->src;
+
+        switch (stream->params.src_type) {
+            case TYPE_FLOAT_F32:
+                memset((float*) slot->src + slot->n, 0, (n_padded - slot->n) * sizeof(float));
+                break;
+            case TYPE_FLOAT_F16:
+                for (size_t i = 0; i < slot->n; ++i) {
+                    stream->scratch[i] = decode_float16(((const float16_t*) slot->src)[i]);
+                }
+                memset(stream->scratch + slot->n, 0, (n_padded - slot->n) * sizeof(float));
+                src = stream->scratch;
+                break;
+            case TYPE_FLOAT_BF16:
+                for (size_t i = 0; i < slot->n; ++i) {
+                    stream->scratch[i] = decode_bfloat16(((const bfloat16_t*) slot->src)[i]);
+                }
+                memset(stream->scratch + slot->n, 0, (n_padded - slot->n) * sizeof(float));
+                src = stream->scratch;
+                break;
+            default:
+                stream_fail(stream);
+                return NULL;
+        }
+
+        // quantize_row() writes nothing for an unsupported type once asserts are compiled out
+        slot->size = quantize_row(stream->params.dst_type, src, slot->dst, n_padded);
+        if (0 == slot->size && n_padded > 0) {
+            stream_fail(stream);
+            return NULL;
+        }
+
+        const bool eof = slot->eof;
+        slot_release(stream, slot, SLOT_QUANTIZED);
+        if (eof) {
+            return NULL;
+        }
+    }
+}
+
+static void* stream_writer(void* arg) {
+    quant_stream_t* stream = (quant_stream_t*) arg;
+
+    for (size_t seq = 0;; ++seq) {
+        quant_slot_t* slot = &stream->slots[seq % stream->params.n_chunks];
+        if (!slot_acquire(stream, slot, SLOT_QUANTIZED)) {
+            return NULL;
+        }
+
+        if (!write_full(stream->dst_fd, slot->dst, slot->size)) {
+            stream_fail(stream);
+            return NULL;
+        }
+        stream->stats.bytes_written += slot->size;
+
+        const bool eof = slot->eof;
+        slot_release(stream, slot, SLOT_FREE);
+        if (eof) {
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Public API
+ */
+
+quant_stream_params_t quant_stream_default_params(data_type_t src_type, data_type_t dst_type) {
+    quant_stream_params_t params;
+    params.src_type   = src_type;
+    params.dst_type   = dst_type;
+    params.chunk_size = QUANT_STREAM_CHUNK;
+    params.n_chunks   = QUANT_STREAM_DEPTH;
+    return params;
+}
+
+static void free_slots(quant_slot_t* slots, size_t n_chunks) {
+    if (!slots) {
+        return;
+    }
+    for (size_t i = 0; i < n_chunks; ++i) {
+        free(slots[i].src);
+        free(slots[i].dst);
+    }
+    free(slots);
+}
+
+bool quant_stream_fd(
+    int                          src_fd,
+    int                          dst_fd,
+    const quant_stream_params_t* params,
+    quant_stream_stats_t*        stats
+) {
+    if (!params || params->dst_type >= TYPE_MAX_COUNT) {
+        errno = EINVAL;
+        return false;
+    }
+
+    quant_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.src_fd = src_fd;
+    stream.dst_fd = dst_fd;
+    stream.params = *params;
+
+    switch (params->src_type) {
+        case TYPE_FLOAT_F32:
+            stream.src_elem = sizeof(float);
+            break;
+        case TYPE_FLOAT_F16:
+        case TYPE_FLOAT_BF16:
+            stream.src_elem = sizeof(uint16_t);
+            break;
+        default:
+            errno = EINVAL;
+            return false;
+    }
+
+    // Rounding to whole blocks and the fp32 scratch buffer must not overflow
+    const size_t block = quant_block_size(params->dst_type);
+    if (params->chunk_size > SIZE_MAX / sizeof(float) - block) {
+        errno = EINVAL;
+        return false;
+    }
+
+    stream.params.chunk_size = params->chunk_size ? params->chunk_size : QUANT_STREAM_CHUNK;
+    stream.params.chunk_size = (stream.params.chunk_size + block - 1) / block * block;
+    stream.params.n_chunks   = params->n_chunks < 2 ? 2 : params->n_chunks;
+    const size_t chunk       = stream.params.chunk_size;
+
+    // Header: the element count is exact when the source is a regular file
+    struct stat         st;
+    quant_file_header_t header;
+    header.magic      = QUANT_FILE_MAGIC;
+    header.version    = QUANT_FILE_VERSION;
+    header.type       = (uint32_t) params->dst_type;
+    header.block_size = (uint32_t) block;
+    header.n_elements = 0;
+    if (0 == fstat(src_fd, &st) && S_ISREG(st.st_mode)) {
+        header.n_elements = (uint64_t) st.st_size / stream.src_elem;
+    }
+
+    stream.slots = (quant_slot_t*) calloc(stream.params.n_chunks, sizeof(quant_slot_t));
+    if (!stream.slots) {
+        return false;
+    }
+    for (size_t i = 0; i < stream.params.n_chunks; ++i) {
+        stream.slots[i].src   = malloc(chunk * stream.src_elem);
+        stream.slots[i].dst   = malloc(quant_row_size(params->dst_type, chunk));
+        stream.slots[i].state = SLOT_FREE;
+        if (!stream.slots[i].src || !stream.slots[i].dst) {
+            free_slots(stream.slots, stream.params.n_chunks);
+            return false;
+        }
+    }
+    if (TYPE_FLOAT_F32 != params->src_type) {
+        stream.scratch = (float*) malloc(chunk * sizeof(float));
+        if (!stream.scratch) {
+            free_slots(stream.slots, stream.params.n_chunks);
+            return false;
+        }
+    }
+
+    if (!write_full(dst_fd, &header, sizeof(header))) {
+        free(stream.scratch);
+        free_slots(stream.slots, stream.params.n_chunks);
+        return false;
+    }
+    stream.stats.bytes_written = sizeof(header);
+
+    posix_fadvise(src_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    pthread_mutex_init(&stream.lock, NULL);
+    pthread_cond_init(&stream.ready, NULL);
+
+    pthread_t reader, quantizer, writer;
+    bool      started = 0 == pthread_create(&reader, NULL, stream_reader, &stream);
+    if (started) {
+        if (0 != pthread_create(&quantizer, NULL, stream_quantizer, &stream)) {
+            stream_fail(&stream);
+            pthread_join(reader, NULL);
+            started = false;
+        } else if (0 != pthread_create(&writer, NULL, stream_writer, &stream)) {
+            stream_fail(&stream);
+            pthread_join(reader, NULL);
+            pthread_join(quantizer, NULL);
+            started = false;
+        }
+    }
+    if (started) {
+        pthread_join(reader, NULL);
+        pthread_join(quantizer, NULL);
+        pthread_join(writer, NULL);
+    }
+
+    bool ok = started && !stream.failed;
+
+    // Patch the header when the source length was not known up front
+    if (ok && header.n_elements != stream.stats.n_elements) {
+        header.n_elements = stream.stats.n_elements;
+        ok = sizeof(header) == (size_t) pwrite(dst_fd, &header, sizeof(header), 0);
+    }
+
+    if (stats) {
+        *stats = stream.stats;
+    }
+
+    pthread_cond_destroy(&stream.ready);
+    pthread_mutex_destroy(&stream.lock);
+    free(stream.scratch);
+    free_slots(stream.slots, stream.params.n_chunks);
+    return ok;
+}
+
+bool quant_stream_file(
+    const char*                  src_path,
+    const char*                  dst_path,
+    const quant_stream_params_t* params,
+    quant_stream_stats_t*        stats
+) {
+    int src_fd = open(src_path, O_RDONLY);
+    if (src_fd < 0) {
+        return false;
+    }
+
+    int dst_fd = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst_fd < 0) {
+        close(src_fd);
+        return false;
+    }
+
+    bool ok = quant_stream_fd(src_fd, dst_fd, params, stats);
+    ok      = (0 == close(dst_fd)) && ok;
+    close(src_fd);
+    return ok;
+}
+
+bool quant_file_read_header(int fd, quant_file_header_t* header) {
+    if (sizeof(*header) != (size_t) read_full(fd, header, sizeof(*header))) {
+        return false;
+    }
+    return QUANT_FILE_MAGIC == header->magic && QUANT_FILE_VERSION == header->version
+           && header->type < TYPE_MAX_COUNT;
+}
@@ -6,63 +6,53 @@
 
 #include "quantization.h"
 #include "floating_point.h"
+#include "parallel.h"
+#include "profile.h"
+#include "quant_fp4.h"
+#include "quant_mx.h"
+
+#include <string.h>
 
 // Helper function to encode a float based on its data type
-float_t encode_float(float value, data_type_t type) {
-    float_t encoded;
-    encoded.value = value;
-    encoded.type  = type;
+static float_flex_t encode_float(float value, data_type_t type) {
+    float_flex_t encoded;
+    encoded.type = type;
 
     switch (type) {
         case TYPE_FLOAT_F32:
-            encoded.bits.f32 = *(uint32_t*) &value;
+            encoded.value.bits = encode_float32(value);
             break;
         case TYPE_FLOAT_F16:
-            // Encoding logic for float16
-            // Placeholder: real implementation needed
-            encoded.bits.f16 = (uint16_t) value;
+            encoded.value.bits = encode_float16(value);
             break;
-        case TYPE_FLOAT_F8:
-            // Encoding logic for float8
-            // Placeholder: real implementation needed
-            encoded.bits.f8 = (uint8_t) value;
+        case TYPE_FLOAT_BF16:
+            encoded.value.bits = encode_bfloat16(value);
             break;
         default:
-            // Unsupported type
-            assert(0);
+            // Quantized types carry their delta as a plain float
+            encoded.value.value = value;
+            break;
     }
 
     return encoded;
 }
 
 // Helper function to decode a float based on its data type
-float decode_float(float_t encoded) {
-    float value = 0.0f;
-
+static float decode_float(float_flex_t encoded) {
     switch (encoded.type) {
         case TYPE_FLOAT_F32:
-            value = *(float*) &encoded.bits.f32;
-            break;
+            return decode_float32(encoded.value.bits);
         case TYPE_FLOAT_F16:
-            // Decoding logic for float16
-            // Placeholder: real implementation needed
-            value = (float) encoded.bits.f16;
-            break;
-        case TYPE_FLOAT_F8:
-            // Decoding logic for float8
-            // Placeholder: real implementation needed
-            value = (float) encoded.bits.f8;
-            break;
+            return decode_float16((float16_t) encoded.value.bits);
+        case TYPE_FLOAT_BF16:
+            return decode_bfloat16((bfloat16_t) encoded.value.bits);
         default:
-            // Unsupported type
-            assert(0);
+            return encoded.value.value;
     }
-
-    return value;
 }
 
 // Allocates and initializes a quant_t structure
-quant_t* malloc_quant(float_t delta, size_t size, data_type_t dtype) {
+quant_t* malloc_quant(float_flex_t delta, size_t size, data_type_t dtype, uint8_t* quants) {
     quant_t* q = (quant_t*) malloc(sizeof(quant_t));
     if (!q) {
         return NULL;
@@ -77,6 +67,10 @@ quant_t* malloc_quant(float_t delta, size_t size, data_type_t dtype) {
         return NULL;
     }
 
+    if (quants) {
+        memcpy(q->quants, quants, size * sizeof(uint8_t));
+    }
+
     return q;
 }
 
@@ -89,14 +83,18 @@ void free_quant(quant_t* quant) {
 }
 
 // Example encoding of quantized values
-quant_t* encode_quant(float value, size_t size, data_type_t dtype) {
-    float_t  delta = encode_float(value, dtype);
-    quant_t* quant = malloc_quant(delta, size, dtype);
+quant_t* encode_quant(float value, size_t size, data_type_t dtype, float_flex_t* vflex) {
+    float_flex_t delta = encode_float(value, dtype);
+    quant_t*     quant = malloc_quant(delta, size, dtype, NULL);
 
     if (!quant) {
         return NULL;
     }
 
+    if (vflex) {
+        *vflex = delta;
+    }
+
     // Placeholder for actual quantization logic
     for (size_t i = 0; i < size; ++i) {
         quant->quants[i] = (uint8_t) (value + i); // Example logic
@@ -112,10 +110,533 @@ float decode_quant(const quant_t* quant) {
     }
 
     // Placeholder for actual dequantization logic
-    float value = quant->delta.value;
+    float value = decode_float(quant->delta);
     for (size_t i = 0; i < quant->size; ++i) {
         value += quant->quants[i];
     }
 
     return value / quant->size;
 }
+
+/*
+ * Block layout queries
+ */
+
+static const char* const quant_type_names[TYPE_MAX_COUNT] = {
+    [TYPE_FLOAT_F32]  = "f32",
+    [TYPE_FLOAT_F16]  = "f16",
+    [TYPE_FLOAT_BF16] = "bf16",
+    [TYPE_FLOAT_F8]   = "f8",
+    [TYPE_QUANT_K8]   = "k8",
+    [TYPE_QUANT_K4]   = "k4",
+    [TYPE_QUANT_K2]   = "k2",
+    [TYPE_MX_FP8]     = "mxfp8",
+    [TYPE_MX_FP6]     = "mxfp6",
+    [TYPE_MX_FP4]     = "mxfp4",
+    [TYPE_MX_INT8]    = "mxint8",
+    [TYPE_QUANT_FP4]  = "fp4",
+    [TYPE_QUANT_NF4]  = "nf4",
+};
+
+const char* quant_type_name(data_type_t type) {
+    return type < TYPE_MAX_COUNT ? quant_type_names[type] : NULL;
+}
+
+data_type_t quant_type_from_name(const char* name) {
+    for (int type = 0; type < TYPE_MAX_COUNT; ++type) {
+        if (name && quant_type_names[type] && 0 == strcmp(name, quant_type_names[type])) {
+            return (data_type_t) type;
+        }
+    }
+    return TYPE_MAX_COUNT;
+}
+
+size_t quant_block_size(data_type_t type) {
+    switch (type) {
+        case TYPE_QUANT_K8:
+        case TYPE_QUANT_K4:
+        case TYPE_QUANT_K2:
+        case TYPE_QUANT_FP4:
+        case TYPE_QUANT_NF4:
+            return QUANT_BLOCK_SIZE;
+        case TYPE_MX_FP8:
+        case TYPE_MX_FP6:
+        case TYPE_MX_FP4:
+        case TYPE_MX_INT8:
+            return MX_BLOCK_SIZE;
+        default:
+            return 1;
+    }
+}
+
+size_t quant_type_size(data_type_t type) {
+    switch (type) {
+        case TYPE_FLOAT_F32:
+            return sizeof(float32_t);
+        case TYPE_FLOAT_F16:
+            return sizeof(float16_t);
+        case TYPE_FLOAT_BF16:
+            return sizeof(bfloat16_t);
+        case TYPE_FLOAT_F8:
+            return sizeof(float8_t);
+        case TYPE_QUANT_K8:
+            return sizeof(quant_k8_t);
+        case TYPE_QUANT_K4:
+            return sizeof(quant_k4_t);
+        case TYPE_QUANT_K2:
+            return sizeof(quant_k2_t);
+        case TYPE_MX_FP8:
+            return sizeof(mx_fp8_t);
+        case TYPE_MX_FP6:
+            return sizeof(mx_fp6_t);
+        case TYPE_MX_FP4:
+            return sizeof(mx_fp4_t);
+        case TYPE_MX_INT8:
+            return sizeof(mx_int8_t);
+        case TYPE_QUANT_FP4:
+            return sizeof(quant_fp4_t);
+        case TYPE_QUANT_NF4:
+            return sizeof(quant_nf4_t);
+        default:
+            assert(0 && "Unsupported data type");
+            return 0;
+    }
+}
+
+size_t quant_row_size(data_type_t type, size_t n) {
+    assert(n % quant_block_size(type) == 0);
+    return (n / quant_block_size(type)) * quant_type_size(type);
+}
+
+/*
+ * 8-bit symmetric blocks
+ */
+
+void quantize_row_k8(const float* src, quant_k8_t* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float* x = src + b * QUANT_BLOCK_SIZE;
+
+        float amax = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            amax = fmaxf(amax, fabsf(x[i]));
+        }
+
+        const float delta     = amax / 127.0f;
+        const float inv_delta = delta ? 1.0f / delta : 0.0f;
+
+        dst[b].scale = encode_float16(delta);
+        // NaN, or an infinity times a zero inv_delta, would make the cast undefined
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            const float q    = roundf(x[i] * inv_delta);
+            dst[b].quants[i] = (int8_t) (isnan(q) ? 0.0f : fminf(127.0f, fmaxf(-127.0f, q)));
+        }
+    }
+}
+
+void dequantize_row_k8(const quant_k8_t* src, float* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float delta = decode_float16(src[b].scale);
+        float*      y     = dst + b * QUANT_BLOCK_SIZE;
+
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            y[i] = src[b].quants[i] * delta;
+        }
+    }
+}
+
+/*
+ * 4-bit symmetric blocks
+ */
+
+void quantize_row_k4(const float* src, quant_k4_t* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float* x = src + b * QUANT_BLOCK_SIZE;
+
+        // Keep the sign of the largest magnitude so it maps onto -8 exactly
+        float amax = 0.0f;
+        float vmax = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            if (fabsf(x[i]) > amax) {
+                amax = fabsf(x[i]);
+                vmax = x[i];
+            }
+        }
+
+        const float delta     = vmax / -8.0f;
+        const float inv_delta = delta ? 1.0f / delta : 0.0f;
+
+        dst[b].scale = encode_float16(delta);
+        for (size_t i = 0; i < half; ++i) {
+            const int lo = (int) fminf(15.0f, roundf(x[i] * inv_delta) + 8.0f);
+            const int hi = (int) fminf(15.0f, roundf(x[i + half] * inv_delta) + 8.0f);
+
+            dst[b].quants[i] = (uint8_t) (lo | (hi << 4));
+        }
+    }
+}
+
+void dequantize_row_k4(const quant_k4_t* src, float* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float delta = decode_float16(src[b].scale);
+        float*      y     = dst + b * QUANT_BLOCK_SIZE;
+
+        for (size_t i = 0; i < half; ++i) {
+            y[i]        = ((int) (src[b].quants[i] & 0x0F) - 8) * delta;
+            y[i + half] = ((int) (src[b].quants[i] >> 4) - 8) * delta;
+        }
+    }
+}
+
+/*
+ * 2-bit symmetric blocks
+ */
+
+void quantize_row_k2(const float* src, quant_k2_t* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t quarter = QUANT_BLOCK_SIZE / 4;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float* x = src + b * QUANT_BLOCK_SIZE;
+
+        float amax = 0.0f;
+        float vmax = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            if (fabsf(x[i]) > amax) {
+                amax = fabsf(x[i]);
+                vmax = x[i];
+            }
+        }
+
+        const float delta     = vmax / -2.0f;
+        const float inv_delta = delta ? 1.0f / delta : 0.0f;
+
+        dst[b].scale = encode_float16(delta);
+        for (size_t j = 0; j < quarter; ++j) {
+            uint8_t packed = 0;
+            for (size_t part = 0; part < 4; ++part) {
+                const float l = fminf(3.0f, roundf(x[j + part * quarter] * inv_delta) + 2.0f);
+                packed |= (uint8_t) ((int) l << (2 * part));
+            }
+            dst[b].quants[j] = packed;
+        }
+    }
+}
+
+void dequantize_row_k2(const quant_k2_t* src, float* dst, size_t n) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t quarter = QUANT_BLOCK_SIZE / 4;
+
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const float delta = decode_float16(src[b].scale);
+        float*      y     = dst + b * QUANT_BLOCK_SIZE;
+
+        for (size_t j = 0; j < quarter; ++j) {
+            for (size_t part = 0; part < 4; ++part) {
+                const int q           = (src[b].quants[j] >> (2 * part)) & 0x03;
+                y[j + part * quarter] = (q - 2) * delta;
+            }
+        }
+    }
+}
+
+/*
+ * Importance-weighted scale search
+ */
+
+/// Candidate scales tried on either side of the absmax scale.
+#define QUANT_SEARCH_STEPS 9
+
+// Rounds and clamps to [qmin, qmax]; NaN maps to 0 rather than an undefined cast
+static inline int quant_level(float v, int qmin, int qmax) {
+    const float q = roundf(v);
+    return isnan(q) ? 0 : (int) fminf((float) qmax, fmaxf((float) qmin, q));
+}
+
+// Fits scale and levels in [qmin, qmax] minimizing the weighted squared error
+static float fit_block_scale(const float* x, const float* w, int qmin, int qmax, int* levels) {
+    float amax = 0.0f;
+    float vmax = 0.0f;
+    for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+        if (fabsf(x[i]) > amax) {
+            amax = fabsf(x[i]);
+            vmax = x[i];
+        }
+    }
+
+    if (0.0f == amax) {
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            levels[i] = 0;
+        }
+        return 0.0f;
+    }
+
+    float best_score = -1.0f;
+    float best_scale = 0.0f;
+    int   candidate[QUANT_BLOCK_SIZE];
+
+    // Maximizing sumlx^2 / suml2 minimizes sum(w * (x - d * l)^2) at d = sumlx / suml2
+    for (int step = -QUANT_SEARCH_STEPS; step <= QUANT_SEARCH_STEPS; ++step) {
+        const float iscale = (qmin + 0.1f * step) / vmax;
+
+        float sumlx = 0.0f;
+        float suml2 = 0.0f;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            const int l = quant_level(iscale * x[i], qmin, qmax);
+
+            const float wi = w ? w[i] : 1.0f;
+            candidate[i]   = l;
+            sumlx += wi * x[i] * l;
+            suml2 += wi * l * l;
+        }
+
+        if (suml2 > 0.0f && sumlx * sumlx > best_score * suml2) {
+            best_score = sumlx * sumlx / suml2;
+            best_scale = sumlx / suml2;
+            for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+                levels[i] = candidate[i];
+            }
+        }
+    }
+
+    // No candidate had weight, e.g. all-zero importance: fall back to the absmax scale
+    if (best_score < 0.0f) {
+        const float iscale = qmin / vmax;
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            levels[i] = quant_level(iscale * x[i], qmin, qmax);
+        }
+        return 1.0f / iscale;
+    }
+
+    return best_scale;
+}
+
+void quantize_row_k8_weighted(
+    const float* src, quant_k8_t* dst, size_t n, const float* importance
+) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    int levels[QUANT_BLOCK_SIZE];
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const size_t offset = b * QUANT_BLOCK_SIZE;
+        const float  delta  = fit_block_scale(
+            src + offset, importance ? importance + offset : NULL, -127, 127, levels
+        );
+
+        dst[b].scale = encode_float16(delta);
+        for (size_t i = 0; i < QUANT_BLOCK_SIZE; ++i) {
+            dst[b].quants[i] = (int8_t) levels[i];
+        }
+    }
+}
+
+void quantize_row_k4_weighted(
+    const float* src, quant_k4_t* dst, size_t n, const float* importance
+) {
+    assert(n % QUANT_BLOCK_SIZE == 0);
+
+    const size_t half = QUANT_BLOCK_SIZE / 2;
+
+    int levels[QUANT_BLOCK_SIZE];
+    for (size_t b = 0; b < n / QUANT_BLOCK_SIZE; ++b) {
+        const size_t offset = b * QUANT_BLOCK_SIZE;
+        const float  delta  = fit_block_scale(
+            src + offset, importance ? importance + offset : NULL, -8, 7, levels
+        );
+
+        dst[b].scale = encode_float16(delta);
+        for (size_t i = 0; i < half; ++i) {
+            dst[b].quants[i] = (uint8_t) ((levels[i] + 8) | ((levels[i + half] + 8) << 4));
+        }
+    }
+}
+
+/*
+ * Generic row conversion
+ */
+
+// Unprofiled body of quantize_row(), for callers that profile a whole tensor
+static size_t quantize_row_any(data_type_t type, const float* src, void* dst, size_t n) {
+    switch (type) {
+        case TYPE_FLOAT_F32:
+            memcpy(dst, src, n * sizeof(float));
+            break;
+        case TYPE_FLOAT_F16:
+            for (size_t i = 0; i < n; ++i) {
+                ((float16_t*) dst)[i] = encode_float16(src[i]);
+            }
+            break;
+        case TYPE_FLOAT_BF16:
+            for (size_t i = 0; i < n; ++i) {
+                ((bfloat16_t*) dst)[i] = encode_bfloat16(src[i]);
+            }
+            break;
+        case TYPE_FLOAT_F8:
+            for (size_t i = 0; i < n; ++i) {
+                ((float8_t*) dst)[i] = encode_float8(src[i]);
+            }
+            break;
+        case TYPE_QUANT_K8:
+            quantize_row_k8(src, (quant_k8_t*) dst, n);
+            break;
+        case TYPE_QUANT_K4:
+            quantize_row_k4(src, (quant_k4_t*) dst, n);
+            break;
+        case TYPE_QUANT_K2:
+            quantize_row_k2(src, (quant_k2_t*) dst, n);
+            break;
+        case TYPE_MX_FP8:
+        case TYPE_MX_FP6:
+        case TYPE_MX_FP4:
+        case TYPE_MX_INT8:
+            quantize_row_mx(type, src, dst, n);
+            break;
+        case TYPE_QUANT_FP4:
+            quantize_row_fp4(src, (quant_fp4_t*) dst, n);
+            break;
+        case TYPE_QUANT_NF4:
+            quantize_row_nf4(src, (quant_nf4_t*) dst, n);
+            break;
+        default:
+            assert(0 && "Unsupported data type");
+            return 0;
+    }
+
+    return quant_row_size(type, n);
+}
+
+size_t quantize_row(data_type_t type, const float* src, void* dst, size_t n) {
+    PROFILE_BEGIN(sample);
+
+    const size_t size = quantize_row_any(type, src, dst, n);
+
+    PROFILE_END(sample, PROFILE_QUANTIZE_ROW, size ? n : 0, size ? n * sizeof(float) + size : 0);
+    return size;
+}
+
+size_t dequantize_row(data_type_t type, const void* src, float* dst, size_t n) {
+    PROFILE_BEGIN(sample);
+
+    switch (type) {
+        case TYPE_FLOAT_F32:
+            memcpy(dst, src, n * sizeof(float));
+            break;
+        case TYPE_FLOAT_F16:
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = decode_float16(((const float16_t*) src)[i]);
+            }
+            break;
+        case TYPE_FLOAT_BF16:
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = decode_bfloat16(((const bfloat16_t*) src)[i]);
+            }
+            break;
+        case TYPE_FLOAT_F8:
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = decode_float8(((const float8_t*) src)[i]);
+            }
+            break;
+        case TYPE_QUANT_K8:
+            dequantize_row_k8((const quant_k8_t*) src, dst, n);
+            break;
+        case TYPE_QUANT_K4:
+            dequantize_row_k4((const quant_k4_t*) src, dst, n);
+            break;
+        case TYPE_QUANT_K2:
+            dequantize_row_k2((const quant_k2_t*) src, dst, n);
+            break;
+        case TYPE_MX_FP8:
+        case TYPE_MX_FP6:
+        case TYPE_MX_FP4:
+        case TYPE_MX_INT8:
+            dequantize_row_mx(type, src, dst, n);
+            break;
+        case TYPE_QUANT_FP4:
+            dequantize_row_fp4((const quant_fp4_t*) src, dst, n);
+            break;
+        case TYPE_QUANT_NF4:
+            dequantize_row_nf4((const quant_nf4_t*) src, dst, n);
+            break;
+        default:
+            assert(0 && "Unsupported data type");
+            PROFILE_END(sample, PROFILE_DEQUANTIZE_ROW, 0, 0);
+            return 0;
+    }
+
+    PROFILE_END(sample, PROFILE_DEQUANTIZE_ROW, n, quant_row_size(type, n) + n * sizeof(float));
+    return quant_row_size(type, n);
+}
+
+/*
+ * Multithreaded tensor quantization
+ */
+
+typedef struct {
+    data_type_t  type;
+    const float* src;
+    uint8_t*     dst;
+    size_t       cols;
+    size_t       row_size;
+    const float* importance;
+} quant_tensor_task_t;
+
+static void quantize_tensor_rows(void* ctx, size_t begin, size_t end, size_t thread) {
+    const quant_tensor_task_t* task = (const quant_tensor_task_t*) ctx;
+    (void) thread;
+
+    for (size_t row = begin; row < end; ++row) {
+        const float* x = task->src + row * task->cols;
+        uint8_t*     y = task->dst + row * task->row_size;
+
+        if (task->importance && TYPE_QUANT_K8 == task->type) {
+            quantize_row_k8_weighted(x, (quant_k8_t*) y, task->cols, task->importance);
+        } else if (task->importance && TYPE_QUANT_K4 == task->type) {
+            quantize_row_k4_weighted(x, (quant_k4_t*) y, task->cols, task->importance);
+        } else {
+            quantize_row_any(task->type, x, y, task->cols);
+        }
+    }
+}
+
+void quantize_tensor(
+    data_type_t  type,
+    const float* src,
+    void*        dst,
+    size_t       rows,
+    size_t       cols,
+    const float* importance,
+    size_t       n_threads
+) {
+    quant_tensor_task_t task;
+    task.type       = type;
+    task.src        = src;
+    task.dst        = (uint8_t*) dst;
+    task.cols       = cols;
+    task.row_size   = quant_row_size(type, cols);
+    task.importance = importance;
+
+    PROFILE_BEGIN(sample);
+
+    // Single-row tasks keep stealing fine-grained when row costs are uneven
+    parallel_for(rows, 1, n_threads, quantize_tensor_rows, &task);
+
+    PROFILE_END(
+        sample,
+        PROFILE_QUANTIZE_TENSOR,
+        rows * cols,
+        rows * (cols * sizeof(float) + task.row_size)
+    );
+}
@@ -0,0 +1,296 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/reduce.c
+ *
+ * @brief Compensated, deterministic reductions over reduced-precision arrays.
+ *
+ * Chunks are processed in batches of REDUCE_BATCH: each batch runs through
+ * parallel_for() with one partial slot per chunk, then the slots are folded
+ * in order on the caller. Partials live on the stack, so no allocation is
+ * needed for any input size.
+ */
+
+#include "reduce.h"
+#include "parallel.h"
+#include "profile.h"
+#include "quantization.h"
+#include "simd_convert.h"
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+/// Chunks reduced per parallel_for() call.
+#define REDUCE_BATCH 1024
+
+typedef enum {
+    REDUCE_OP_SUM,     // x
+    REDUCE_OP_SQUARES, // (x - shift)^2
+    REDUCE_OP_DOT,     // a * b
+} reduce_op_t;
+
+typedef struct {
+    float sum;
+    float comp;
+} reduce_partial_t;
+
+typedef struct {
+    data_type_t       type;
+    reduce_op_t       op;
+    float             shift;
+    const uint8_t*    a;
+    const uint8_t*    b;
+    size_t            n;
+    size_t            first; // first chunk of the batch
+    reduce_partial_t* partials;
+} reduce_task_t;
+
+// Kahan-Neumaier step: the rounding error of sum + value is kept in comp
+static inline void reduce_neumaier(reduce_partial_t* acc, float value) {
+    const float t = acc->sum + value;
+    if (fabsf(acc->sum) >= fabsf(value)) {
+        acc->comp += (acc->sum - t) + value;
+    } else {
+        acc->comp += (value - t) + acc->sum;
+    }
+    acc->sum = t;
+}
+
+static inline __attribute__((always_inline)) float
+reduce_load(data_type_t type, const uint8_t* x, size_t i) {
+    switch (type) {
+        case TYPE_FLOAT_F16:
+            return decode_float16(((const float16_t*) x)[i]);
+        case TYPE_FLOAT_BF16:
+            return decode_bfloat16(((const bfloat16_t*) x)[i]);
+        case TYPE_FLOAT_F8:
+            return decode_float8(x[i]);
+        default:
+            return ((const float*) x)[i];
+    }
+}
+
+static inline __attribute__((always_inline)) float reduce_term(
+    data_type_t type, reduce_op_t op, float shift, const uint8_t* a, const uint8_t* b, size_t i
+) {
+    const float x = reduce_load(type, a, i);
+    switch (op) {
+        case REDUCE_OP_SUM:
+            return x;
+        case REDUCE_OP_SQUARES:
+            return (x - shift) * (x - shift);
+        default:
+            return x * reduce_load(type, b, i);
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+
+// Widens eight elements starting at index i to fp32
+static inline __attribute__((always_inline)) __m256
+reduce_load_ps(data_type_t type, const uint8_t* x, size_t i) {
+    switch (type) {
+        case TYPE_FLOAT_F16:
+            return simd_load_f16_ps((const float16_t*) x + i);
+        case TYPE_FLOAT_BF16:
+            return simd_load_bf16_ps((const bfloat16_t*) x + i);
+        case TYPE_FLOAT_F8:
+            return simd_load_f8_ps((const float8_t*) x + i);
+        default:
+            return _mm256_loadu_ps((const float*) x + i);
+    }
+}
+
+static inline __attribute__((always_inline)) __m256 reduce_step_ps(
+    data_type_t    type,
+    reduce_op_t    op,
+    __m256         shift,
+    const uint8_t* a,
+    const uint8_t* b,
+    size_t         i,
+    __m256         acc
+) {
+    const __m256 x = reduce_load_ps(type, a, i);
+    switch (op) {
+        case REDUCE_OP_SUM:
+            return _mm256_add_ps(acc, x);
+        case REDUCE_OP_SQUARES: {
+            const __m256 d = _mm256_sub_ps(x, shift);
+            return _mm256_fmadd_ps(d, d, acc);
+        }
+        default:
+            return _mm256_fmadd_ps(x, reduce_load_ps(type, b, i), acc);
+    }
+}
+
+#endif
+
+// Reduces elements [begin, end) into a compensated partial
+static inline __attribute__((always_inline)) reduce_partial_t reduce_range(
+    data_type_t    type,
+    reduce_op_t    op,
+    float          shift,
+    const uint8_t* a,
+    const uint8_t* b,
+    size_t         begin,
+    size_t         end
+) {
+    reduce_partial_t acc = {0.0f, 0.0f};
+    size_t           i   = begin;
+
+#if defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    const __m256 vshift = _mm256_set1_ps(shift);
+    const __m256 mask   = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    __m256 sum  = _mm256_setzero_ps();
+    __m256 comp = _mm256_setzero_ps();
+
+    for (; i + REDUCE_BLOCK <= end; i += REDUCE_BLOCK) {
+        __m256 block0 = _mm256_setzero_ps();
+        __m256 block1 = _mm256_setzero_ps();
+        for (size_t j = i; j < i + REDUCE_BLOCK; j += 16) {
+            block0 = reduce_step_ps(type, op, vshift, a, b, j, block0);
+            block1 = reduce_step_ps(type, op, vshift, a, b, j + 8, block1);
+        }
+
+        // Lane-wise Neumaier step on the block sum
+        const __m256 value = _mm256_add_ps(block0, block1);
+        const __m256 t     = _mm256_add_ps(sum, value);
+        const __m256 big   = _mm256_cmp_ps(
+            _mm256_and_ps(sum, mask), _mm256_and_ps(value, mask), _CMP_GE_OQ
+        );
+        const __m256 err = _mm256_blendv_ps(
+            _mm256_add_ps(_mm256_sub_ps(value, t), sum),
+            _mm256_add_ps(_mm256_sub_ps(sum, t), value),
+            big
+        );
+        comp = _mm256_add_ps(comp, err);
+        sum  = t;
+    }
+
+    float lanes[8];
+    float errors[8];
+    _mm256_storeu_ps(lanes, sum);
+    _mm256_storeu_ps(errors, comp);
+    for (size_t l = 0; l < 8; ++l) {
+        reduce_neumaier(&acc, lanes[l]);
+        acc.comp += errors[l];
+    }
+#endif
+
+    while (i < end) {
+        const size_t stop  = end - i < REDUCE_BLOCK ? end : i + REDUCE_BLOCK;
+        float        block = 0.0f;
+        for (; i < stop; ++i) {
+            block += reduce_term(type, op, shift, a, b, i);
+        }
+        reduce_neumaier(&acc, block);
+    }
+
+    return acc;
+}
+
+static void reduce_chunks(void* ctx, size_t begin, size_t end, size_t thread) {
+    const reduce_task_t* task = (const reduce_task_t*) ctx;
+    (void) thread;
+
+    for (size_t c = begin; c < end; ++c) {
+        const size_t first = (task->first + c) * REDUCE_CHUNK;
+        const size_t last  = task->n - first < REDUCE_CHUNK ? task->n : first + REDUCE_CHUNK;
+
+        reduce_partial_t* out = &task->partials[c];
+        switch (task->type) {
+            case TYPE_FLOAT_F16:
+                *out = reduce_range(
+                    TYPE_FLOAT_F16, task->op, task->shift, task->a, task->b, first, last
+                );
+                break;
+            case TYPE_FLOAT_BF16:
+                *out = reduce_range(
+                    TYPE_FLOAT_BF16, task->op, task->shift, task->a, task->b, first, last
+                );
+                break;
+            case TYPE_FLOAT_F8:
+                *out = reduce_range(
+                    TYPE_FLOAT_F8, task->op, task->shift, task->a, task->b, first, last
+                );
+                break;
+            default:
+                *out = reduce_range(
+                    TYPE_FLOAT_F32, task->op, task->shift, task->a, task->b, first, last
+                );
+                break;
+        }
+    }
+}
+
+static float reduce(
+    data_type_t type,
+    reduce_op_t op,
+    float       shift,
+    const void* a,
+    const void* b,
+    size_t      n,
+    size_t      n_threads
+) {
+    assert(
+        TYPE_FLOAT_F32 == type || TYPE_FLOAT_F16 == type || TYPE_FLOAT_BF16 == type
+        || TYPE_FLOAT_F8 == type
+    );
+
+    reduce_partial_t partials[REDUCE_BATCH];
+
+    reduce_task_t task;
+    task.type     = type;
+    task.op       = op;
+    task.shift    = shift;
+    task.a        = (const uint8_t*) a;
+    task.b        = (const uint8_t*) b;
+    task.n        = n;
+    task.partials = partials;
+
+    const size_t n_chunks = (n + REDUCE_CHUNK - 1) / REDUCE_CHUNK;
+
+    PROFILE_BEGIN(sample);
+
+    reduce_partial_t total = {0.0f, 0.0f};
+    for (size_t first = 0; first < n_chunks; first += REDUCE_BATCH) {
+        const size_t count = n_chunks - first < REDUCE_BATCH ? n_chunks - first : REDUCE_BATCH;
+
+        task.first = first;
+        parallel_for(count, 1, n_threads, reduce_chunks, &task);
+
+        for (size_t c = 0; c < count; ++c) {
+            reduce_neumaier(&total, partials[c].sum);
+            total.comp += partials[c].comp;
+        }
+    }
+
+    PROFILE_END(sample, PROFILE_REDUCE, n, (b ? 2 : 1) * n * quant_type_size(type));
+    return total.sum + total.comp;
+}
+
+float reduce_sum(data_type_t type, const void* x, size_t n, size_t n_threads) {
+    return reduce(type, REDUCE_OP_SUM, 0.0f, x, NULL, n, n_threads);
+}
+
+float reduce_mean(data_type_t type, const void* x, size_t n, size_t n_threads) {
+    return n ? reduce_sum(type, x, n, n_threads) / (float) n : 0.0f;
+}
+
+float reduce_dot(data_type_t type, const void* a, const void* b, size_t n, size_t n_threads) {
+    return reduce(type, REDUCE_OP_DOT, 0.0f, a, b, n, n_threads);
+}
+
+float reduce_norm2(data_type_t type, const void* x, size_t n, size_t n_threads) {
+    return sqrtf(reduce(type, REDUCE_OP_SQUARES, 0.0f, x, NULL, n, n_threads));
+}
+
+float reduce_variance(data_type_t type, const void* x, size_t n, size_t n_threads) {
+    if (0 == n) {
+        return 0.0f;
+    }
+    const float mean = reduce_mean(type, x, n, n_threads);
+    return reduce(type, REDUCE_OP_SQUARES, mean, x, NULL, n, n_threads) / (float) n;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/requantize_kernel.h
+ *
+ * @brief Internal, unprofiled body of requantize_rows().
+ *
+ * conv2d.c requantizes every output row inside its own profiled span, so it
+ * calls the kernel directly instead of the public wrapper, which would record
+ * each row a second time under PROFILE_REQUANTIZE.
+ *
+ * This header is not installed.
+ */
+
+#ifndef REQUANTIZE_KERNEL_H
+#define REQUANTIZE_KERNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief requantize_rows() without profiling; same arguments and results.
+ */
+void requantize_rows_kernel(
+    const int32_t* acc,
+    int8_t*        dst,
+    size_t         rows,
+    size_t         channels,
+    const int32_t* bias,
+    const int32_t* multiplier,
+    const int32_t* shift,
+    int32_t        zero_point
+);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // REQUANTIZE_KERNEL_H
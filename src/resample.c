@@ -0,0 +1,292 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/resample.c
+ *
+ * @brief Integer-only polyphase sample-rate conversion of fixed16_t streams.
+ *
+ * Subfilter p, tap j holds the prototype g(t) at t = taps / 2 - 1 + p / PHASES - j,
+ * where g is a sinc with cutoff fc (in units of the input Nyquist frequency)
+ * under a Kaiser window spanning taps input samples. The bank is computed once
+ * in double precision and rounded to Q1.15. Each subfilter is normalized so
+ * that its integer coefficients sum to exactly 1.0, which passes DC without a
+ * ripple between phases.
+ *
+ * History is primed with taps / 2 - 1 zeros, so output 0 is centered on
+ * input 0 and the filter's group delay never shows up in the output.
+ */
+
+#include "resample.h"
+#include "profile.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+/// log2(RESAMPLE_PHASES): fraction bits that select the subfilter.
+#define RESAMPLE_PHASE_BITS  8
+
+/// Remaining fraction bits, which blend two neighbouring subfilters.
+#define RESAMPLE_WEIGHT_BITS (FIXED_SIZE - RESAMPLE_PHASE_BITS)
+
+/// Input samples appended to the history per pass.
+#define RESAMPLE_BLOCK       1024
+
+/*
+ * Coefficient bank
+ */
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b) {
+        const uint32_t t = a % b;
+        a                = b;
+        b                = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind, by its power series
+static double bessel_i0(double x) {
+    double sum  = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > 1e-12 * sum; ++k) {
+        const double ratio = x / (2.0 * k);
+        term *= ratio * ratio;
+        sum += term;
+    }
+    return sum;
+}
+
+static void resample_bank(int16_t* bank, size_t taps, double cutoff) {
+    const double half  = 0.5 * (double) taps;
+    const double scale = 1.0 / bessel_i0(RESAMPLE_BETA);
+    double       g[RESAMPLE_MAX_TAPS];
+
+    for (size_t p = 0; p <= RESAMPLE_PHASES; ++p) {
+        int16_t* row = bank + p * taps;
+
+        double sum = 0.0;
+        for (size_t j = 0; j < taps; ++j) {
+            const double t = half - 1.0 + (double) p / RESAMPLE_PHASES - (double) j;
+            const double u = t / half;
+            const double x = M_PI * cutoff * t;
+            g[j]           = 0.0;
+            if (fabs(u) < 1.0) {
+                const double sinc   = 0.0 == x ? 1.0 : sin(x) / x;
+                const double window = bessel_i0(RESAMPLE_BETA * sqrt(1.0 - u * u));
+                g[j]                = cutoff * sinc * window * scale;
+            }
+            sum += g[j];
+        }
+
+        // Round, then move the rounding residue onto the largest tap
+        int32_t total   = 0;
+        size_t  largest = 0;
+        for (size_t j = 0; j < taps; ++j) {
+            long value = lround(g[j] / sum * (1 << RESAMPLE_COEFF_Q));
+            value      = value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+            row[j]     = (int16_t) value;
+            total += row[j];
+            if (abs(row[j]) > abs(row[largest])) {
+                largest = j;
+            }
+        }
+        const int32_t fixed = row[largest] + (1 << RESAMPLE_COEFF_Q) - total;
+        row[largest]        = (int16_t) (fixed > INT16_MAX ? INT16_MAX : fixed);
+    }
+}
+
+resampler_t* malloc_resampler(uint32_t in_rate, uint32_t out_rate) {
+    if (0 == in_rate || 0 == out_rate) {
+        return NULL;
+    }
+
+    resampler_t* resampler = (resampler_t*) calloc(1, sizeof(resampler_t));
+    if (!resampler) {
+        return NULL;
+    }
+
+    const uint32_t divisor = gcd_u32(in_rate, out_rate);
+    resampler->in_rate     = in_rate / divisor;
+    resampler->out_rate    = out_rate / divisor;
+
+    // Downsampling narrows the passband, so the filter spans proportionally more input
+    double cutoff = RESAMPLE_CUTOFF;
+    size_t taps   = RESAMPLE_TAPS;
+    if (resampler->in_rate > resampler->out_rate) {
+        const double ratio = (double) resampler->in_rate / resampler->out_rate;
+        cutoff /= ratio;
+        taps = (size_t) ceil(RESAMPLE_TAPS * ratio / 8.0) * 8;
+        taps = taps > RESAMPLE_MAX_TAPS ? RESAMPLE_MAX_TAPS : taps;
+    }
+    resampler->taps = taps;
+
+    const uint64_t frac  = ((uint64_t) (resampler->in_rate % resampler->out_rate)) << FIXED_SIZE;
+    resampler->step      = resampler->in_rate / resampler->out_rate;
+    resampler->step_frac = (fixed16_t) (frac / resampler->out_rate);
+    resampler->step_rem  = (uint32_t) (frac % resampler->out_rate);
+
+    resampler->capacity = taps + RESAMPLE_BLOCK;
+    resampler->bank     = (int16_t*) malloc((RESAMPLE_PHASES + 1) * taps * sizeof(int16_t));
+    resampler->history  = (fixed16_t*) malloc(resampler->capacity * sizeof(fixed16_t));
+    if (!resampler->bank || !resampler->history) {
+        free_resampler(resampler);
+        return NULL;
+    }
+
+    resample_bank(resampler->bank, taps, cutoff);
+    resampler_reset(resampler);
+    return resampler;
+}
+
+void free_resampler(resampler_t* resampler) {
+    if (resampler) {
+        free(resampler->bank);
+        free(resampler->history);
+        free(resampler);
+    }
+}
+
+void resampler_reset(resampler_t* resampler) {
+    resampler->filled = resampler->taps / 2 - 1;
+    memset(resampler->history, 0, resampler->filled * sizeof(fixed16_t));
+    resampler->index = 0;
+    resampler->frac  = 0;
+    resampler->rem   = 0;
+    resampler->n_in  = 0;
+    resampler->n_out = 0;
+}
+
+size_t resampler_max_output(const resampler_t* resampler, size_t n) {
+    return (size_t) ((uint64_t) n * resampler->out_rate / resampler->in_rate) + 2;
+}
+
+/*
+ * Inner products
+ */
+
+// Both subfilters against one window, blended by weight / 2^RESAMPLE_WEIGHT_BITS
+static inline fixed16_t resample_dot(
+    const fixed16_t* x, const int16_t* c0, const int16_t* c1, size_t taps, int64_t weight
+) {
+    int64_t a = 0;
+    int64_t b = 0;
+    size_t  j = 0;
+
+#if defined(__AVX2__)
+    __m256i sum_a = _mm256_setzero_si256();
+    __m256i sum_b = _mm256_setzero_si256();
+    for (; j + 8 <= taps; j += 8) {
+        const __m256i v   = _mm256_loadu_si256((const __m256i*) (x + j));
+        const __m256i v_o = _mm256_srli_epi64(v, 32);
+        const __m256i k0  = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (c0 + j)));
+        const __m256i k1  = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (c1 + j)));
+
+        // mul_epi32 multiplies the even lanes; shifting by 32 exposes the odd ones
+        sum_a = _mm256_add_epi64(sum_a, _mm256_mul_epi32(v, k0));
+        sum_a = _mm256_add_epi64(sum_a, _mm256_mul_epi32(v_o, _mm256_srli_epi64(k0, 32)));
+        sum_b = _mm256_add_epi64(sum_b, _mm256_mul_epi32(v, k1));
+        sum_b = _mm256_add_epi64(sum_b, _mm256_mul_epi32(v_o, _mm256_srli_epi64(k1, 32)));
+    }
+
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, sum_a);
+    a = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256((__m256i*) lanes, sum_b);
+    b = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for (; j < taps; ++j) {
+        a += (int64_t) x[j] * c0[j];
+        b += (int64_t) x[j] * c1[j];
+    }
+
+    const int     shift = RESAMPLE_COEFF_Q + RESAMPLE_WEIGHT_BITS;
+    const int64_t blend = a * ((INT64_C(1) << RESAMPLE_WEIGHT_BITS) - weight) + b * weight;
+    const int64_t y     = (blend + (INT64_C(1) << (shift - 1))) >> shift;
+    return (fixed16_t) (y > INT32_MAX ? INT32_MAX : (y < INT32_MIN ? INT32_MIN : y));
+}
+
+/*
+ * Streaming
+ */
+
+// Appends src to the history and writes at most limit outputs
+static size_t resample_run(
+    resampler_t* resampler, const fixed16_t* src, size_t n, fixed16_t* dst, uint64_t limit
+) {
+    PROFILE_BEGIN(sample);
+
+    const size_t taps    = resampler->taps;
+    const size_t n_in    = n;
+    size_t       written = 0;
+    (void) n_in; // Only read by PROFILE_END()
+
+    while (n > 0) {
+        const size_t room = resampler->capacity - resampler->filled;
+        const size_t take = n < room ? n : room;
+        if (src) {
+            memcpy(resampler->history + resampler->filled, src, take * sizeof(fixed16_t));
+            src += take;
+        } else {
+            memset(resampler->history + resampler->filled, 0, take * sizeof(fixed16_t));
+        }
+        resampler->filled += take;
+        n -= take;
+
+        while (resampler->index + taps <= resampler->filled && written < limit) {
+            const size_t   phase  = (size_t) resampler->frac >> RESAMPLE_WEIGHT_BITS;
+            const int64_t  weight = resampler->frac & ((1 << RESAMPLE_WEIGHT_BITS) - 1);
+            const int16_t* row    = resampler->bank + phase * taps;
+            dst[written++]        = resample_dot(
+                resampler->history + resampler->index, row, row + taps, taps, weight
+            );
+
+            // Advance by in_rate / out_rate, carrying the exact remainder
+            resampler->index += resampler->step;
+            resampler->frac += resampler->step_frac;
+            resampler->rem += resampler->step_rem;
+            if (resampler->rem >= resampler->out_rate) {
+                resampler->rem -= resampler->out_rate;
+                resampler->frac += 1;
+            }
+            if (resampler->frac >= FIXED_VAL) {
+                resampler->frac -= FIXED_VAL;
+                resampler->index += 1;
+            }
+        }
+
+        // Drop samples no future window reaches; downsampling may skip past the end
+        const size_t filled = resampler->filled;
+        const size_t drop   = resampler->index < filled ? resampler->index : filled;
+        memmove(resampler->history, resampler->history + drop, (filled - drop) * sizeof(fixed16_t));
+        resampler->filled -= drop;
+        resampler->index -= drop;
+    }
+
+    // Each output blends two adjacent subfilters
+    PROFILE_END(sample, PROFILE_RESAMPLE, written * 2 * taps, (n_in + written) * sizeof(fixed16_t));
+
+    resampler->n_out += written;
+    return written;
+}
+
+size_t resampler_process(resampler_t* resampler, const fixed16_t* src, size_t n, fixed16_t* dst) {
+    resampler->n_in += n;
+    return resample_run(resampler, src, n, dst, UINT64_MAX);
+}
+
+size_t resampler_flush(resampler_t* resampler, fixed16_t* dst) {
+    const uint64_t in_rate = resampler->in_rate;
+    const uint64_t total   = (resampler->n_in * resampler->out_rate + in_rate - 1) / in_rate;
+    const uint64_t limit   = total > resampler->n_out ? total - resampler->n_out : 0;
+
+    // taps zeros move every remaining output position past its window
+    const size_t written = resample_run(resampler, NULL, resampler->taps, dst, limit);
+    resampler_reset(resampler);
+    return written;
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/simd_convert.c
+ *
+ * @brief Bulk entry points over the shared SIMD conversion helpers.
+ *
+ * Full vectors go through the helpers in simd_convert.h; the tail and
+ * builds without the instruction set use the scalar codecs.
+ */
+
+#include "simd_convert.h"
+
+void simd_convert_encode_f16(const float* src, float16_t* dst, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        simd_store_f16_ps(dst + i, _mm256_loadu_ps(src + i));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = encode_float16(src[i]);
+    }
+}
+
+void simd_convert_decode_f16(const float16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, simd_load_f16_ps(src + i));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = decode_float16(src[i]);
+    }
+}
+
+void simd_convert_encode_bf16(const float* src, bfloat16_t* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        simd_store_bf16_ps(dst + i, _mm256_loadu_ps(src + i));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = encode_bfloat16(src[i]);
+    }
+}
+
+void simd_convert_decode_bf16(const bfloat16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, simd_load_bf16_ps(src + i));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = decode_bfloat16(src[i]);
+    }
+}
+
+void simd_convert_decode_f8(const float8_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, simd_load_f8_ps(src + i));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = decode_float8(src[i]);
+    }
+}
+
+void simd_convert_decode_f8_mx(const float8_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    const __m256 scale = _mm256_set1_ps(0x1p8f);
+    for (; i + 16 <= n; i += 16) {
+        const __m256i h  = simd_load_f8_f16_epi16(src + i);
+        const __m256  lo = _mm256_cvtph_ps(_mm256_castsi256_si128(h));
+        const __m256  hi = _mm256_cvtph_ps(_mm256_extracti128_si256(h, 1));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(lo, scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(hi, scale));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = decode_float8(src[i]);
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file src/simd_convert.h
+ *
+ * @brief Internal AVX2 and F16C conversions shared by the bulk kernels.
+ *
+ * blas_half.c, reduce.c, float_compare.c and quant_mx.c widen and narrow
+ * half-precision and FP8 vectors with these helpers instead of the scalar
+ * codecs, and each helper must match its scalar codec bit for bit (up to
+ * NaN payloads). The simd_convert_* entry points wrap every helper in a bulk
+ * loop so that tools/verify_conversions can sweep them exhaustively. When the
+ * library is built without the needed instruction set, an entry point falls
+ * back to the scalar codec.
+ *
+ * This header is not installed.
+ */
+
+#ifndef SIMD_CONVERT_H
+#define SIMD_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#include "floating_point.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__AVX2__) || defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+#if defined(__F16C__)
+
+// Widens eight float16 values, as decode_float16() does
+static inline __m256 simd_load_f16_ps(const float16_t* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) p));
+}
+
+// Rounds eight floats to float16 to nearest even, as encode_float16() does
+static inline void simd_store_f16_ps(float16_t* p, __m256 v) {
+    _mm_storeu_si128((__m128i*) p, _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+// Widens eight bfloat16 values by a 16-bit shift, as decode_bfloat16() does
+static inline __m256 simd_load_bf16_ps(const bfloat16_t* p) {
+    const __m128i h = _mm_loadu_si128((const __m128i*) p);
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+}
+
+// Rounds eight floats to bfloat16 exactly as encode_bfloat16() does
+static inline void simd_store_bf16_ps(bfloat16_t* p, __m256 v) {
+    const __m256i bits = _mm256_castps_si256(v);
+    const __m256i abs  = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+
+    // Quiet NaN: keep the top half and set the quiet bit
+    const __m256i is_nan = _mm256_cmpgt_epi32(abs, _mm256_set1_epi32(0x7F800000));
+    const __m256i nan    = _mm256_or_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x0040));
+
+    // Subnormals flush to signed zero
+    const __m256i is_sub = _mm256_cmpeq_epi32(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x7F800000)), _mm256_setzero_si256()
+    );
+    const __m256i flushed = _mm256_blendv_epi8(
+        bits, _mm256_and_si256(bits, _mm256_set1_epi32((int) 0x80000000)), is_sub
+    );
+
+    // Round to nearest even: add 0x7FFF plus the lowest kept bit
+    const __m256i odd     = _mm256_and_si256(_mm256_srli_epi32(flushed, 16), _mm256_set1_epi32(1));
+    const __m256i rounded = _mm256_srli_epi32(
+        _mm256_add_epi32(flushed, _mm256_add_epi32(odd, _mm256_set1_epi32(0x7FFF))), 16
+    );
+
+    const __m256i half   = _mm256_blendv_epi8(rounded, nan, is_nan);
+    const __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(half, half), _MM_SHUFFLE(3, 1, 2, 0)
+    );
+    _mm_storeu_si128((__m128i*) p, _mm256_castsi256_si128(packed));
+}
+
+// Widens eight E4M3 values, as decode_float8() does
+static inline __m256 simd_load_f8_ps(const float8_t* p) {
+    // E4M3 fields moved into fp32 position, then rebiased by 2^(127 - 7)
+    const __m256i v    = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) p));
+    const __m256i body = _mm256_and_si256(v, _mm256_set1_epi32(0x7F));
+    const __m256i bits = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0x80)), 24),
+        _mm256_slli_epi32(body, 20)
+    );
+    const __m256 value = _mm256_mul_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(0x1p120f));
+    const __m256 nan   = _mm256_castsi256_ps(_mm256_cmpeq_epi32(body, _mm256_set1_epi32(0x7F)));
+    return _mm256_blendv_ps(value, _mm256_set1_ps(NAN), nan);
+}
+
+// Loads sixteen E4M3 values as the float16 bits of decode_float8() * 2^-8
+static inline __m256i simd_load_f8_f16_epi16(const float8_t* p) {
+    // Sign, exponent and mantissa move up unchanged; the NaN codes 0x7F and 0xFF
+    // would land on a finite value, so they are blended to NaN
+    const __m256i w    = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) p));
+    const __m256i body = _mm256_set1_epi16(0x7F);
+    const __m256i b    = _mm256_and_si256(w, body);
+    const __m256i h    = _mm256_or_si256(
+        _mm256_and_si256(_mm256_slli_epi16(w, 8), _mm256_set1_epi16((short) 0x8000)),
+        _mm256_slli_epi16(b, 7)
+    );
+    return _mm256_blendv_epi8(h, _mm256_set1_epi16(0x7E00), _mm256_cmpeq_epi16(b, body));
+}
+
+#endif
+
+/**
+ * @brief Bulk wrappers of the helpers above, for verification.
+ *
+ * Each converts n elements: encoders read float and write codes, decoders
+ * read codes and write float. simd_convert_decode_f8_mx() goes through
+ * simd_load_f8_f16_epi16() and scales the result back by 2^8, which is exact.
+ */
+void simd_convert_encode_f16(const float* src, float16_t* dst, size_t n);
+void simd_convert_decode_f16(const float16_t* src, float* dst, size_t n);
+void simd_convert_encode_bf16(const float* src, bfloat16_t* dst, size_t n);
+void simd_convert_decode_bf16(const bfloat16_t* src, float* dst, size_t n);
+void simd_convert_decode_f8(const float8_t* src, float* dst, size_t n);
+void simd_convert_decode_f8_mx(const float8_t* src, float* dst, size_t n);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SIMD_CONVERT_H
@@ -0,0 +1,202 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file tools/bit_dump.c
+ *
+ * @brief Renders or summarizes a raw f32/f16/bf16/f8/fixed16 file.
+ *
+ * The file is memory mapped read-only. Lines are rendered into a
+ * BIT_DUMP_BUFFER byte buffer that is written with one fwrite() per fill.
+ * Statistics are computed per BIT_DUMP_CHUNK elements with parallel_for()
+ * and merged in chunk order, so the summary does not depend on the thread
+ * count.
+ *
+ * Usage: bit_dump [-t type] [-o offset] [-n count] [-j threads] [-s] file
+ */
+
+#include "bit_dump.h"
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Bytes of rendered text per write.
+#define BIT_DUMP_BUFFER (1 << 22)
+
+/// Elements summarized per scheduled task.
+#define BIT_DUMP_CHUNK  (1 << 20)
+
+typedef struct {
+    bit_dump_type_t   type;
+    const uint8_t*    data;
+    size_t            n;
+    bit_dump_stats_t* partials;
+} bit_dump_task_t;
+
+static void stats_chunks(void* ctx, size_t begin, size_t end, size_t thread) {
+    const bit_dump_task_t* task = (const bit_dump_task_t*) ctx;
+    const size_t           size = bit_dump_type_size(task->type);
+    (void) thread;
+
+    for (size_t c = begin; c < end; ++c) {
+        const size_t first = c * BIT_DUMP_CHUNK;
+        const size_t count = task->n - first < BIT_DUMP_CHUNK ? task->n - first : BIT_DUMP_CHUNK;
+
+        bit_dump_stats_reset(&task->partials[c]);
+        bit_dump_stats_update(task->type, task->data + first * size, count, &task->partials[c]);
+    }
+}
+
+static bool summarize(
+    bit_dump_type_t type, const uint8_t* data, size_t n, size_t n_threads, bit_dump_stats_t* stats
+) {
+    const size_t n_chunks = (n + BIT_DUMP_CHUNK - 1) / BIT_DUMP_CHUNK;
+    const size_t n_slots  = n_chunks ? n_chunks : 1;
+
+    bit_dump_task_t task = {type, data, n, NULL};
+    task.partials        = (bit_dump_stats_t*) malloc(n_slots * sizeof(bit_dump_stats_t));
+    if (!task.partials) {
+        return false;
+    }
+
+    parallel_for(n_chunks, 1, n_threads, stats_chunks, &task);
+
+    bit_dump_stats_reset(stats);
+    for (size_t c = 0; c < n_chunks; ++c) {
+        bit_dump_stats_merge(stats, &task.partials[c]);
+    }
+
+    free(task.partials);
+    return true;
+}
+
+static bool dump(bit_dump_type_t type, const uint8_t* data, size_t n, uint64_t first_index) {
+    char* buffer = (char*) malloc(BIT_DUMP_BUFFER);
+    if (!buffer) {
+        return false;
+    }
+
+    const size_t size  = bit_dump_type_size(type);
+    const size_t width = bit_dump_line_width(type);
+
+    bool ok = width == fwrite(buffer, 1, bit_dump_header(type, buffer, BIT_DUMP_BUFFER), stdout);
+    for (size_t i = 0; ok && i < n;) {
+        const size_t lines = bit_dump_format(
+            type, data + i * size, n - i, first_index + i, buffer, BIT_DUMP_BUFFER
+        );
+        ok                 = lines * width == fwrite(buffer, 1, lines * width, stdout);
+        i                 += lines;
+    }
+
+    free(buffer);
+    return ok;
+}
+
+static void usage(const char* program) {
+    fprintf(
+        stderr,
+        "Usage: %s [-t type] [-o offset] [-n count] [-j threads] [-s] file\n"
+        "  -t  Element type: f32, f16, bf16, f8 or fixed16 (default f32)\n"
+        "  -o  Byte offset of the first element (default 0)\n"
+        "  -n  Number of elements (default through the end of the file)\n"
+        "  -j  Worker threads for the summary (default all processors)\n"
+        "  -s  Print only the summary\n",
+        program
+    );
+}
+
+int main(int argc, char* argv[]) {
+    bit_dump_type_t type         = BIT_DUMP_F32;
+    size_t          offset       = 0;
+    size_t          count        = SIZE_MAX;
+    size_t          n_threads    = 0;
+    bool            summary_only = false;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "t:o:n:j:sh"))) {
+        switch (opt) {
+            case 't':
+                type = bit_dump_type_from_name(optarg);
+                break;
+            case 'o':
+                offset = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                count = strtoull(optarg, NULL, 0);
+                break;
+            case 'j':
+                n_threads = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                summary_only = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind + 1 != argc || BIT_DUMP_MAX_TYPE == type) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* path = argv[optind];
+    const int   fd   = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || 0 != fstat(fd, &st)) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    const size_t file_size = (size_t) st.st_size;
+    if (offset > file_size) {
+        fprintf(stderr, "%s: offset %zu is past the end (%zu bytes)\n", path, offset, file_size);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // Trailing bytes that do not form a whole element are ignored
+    const size_t size      = bit_dump_type_size(type);
+    const size_t available = (file_size - offset) / size;
+    const size_t n         = count < available ? count : available;
+
+    const uint8_t* map = NULL;
+    if (file_size > 0) {
+        map = (const uint8_t*) mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == map) {
+            perror("mmap");
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        madvise((void*) map, file_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    const uint8_t* data = map ? map + offset : NULL;
+
+    bool ok = summary_only || dump(type, data, n, 0);
+
+    bit_dump_stats_t stats;
+    if (ok && !summarize(type, data, n, n_threads, &stats)) {
+        fprintf(stderr, "Failed to allocate the summary\n");
+        ok = false;
+    }
+    if (ok) {
+        if (!summary_only) {
+            fputc('\n', stdout);
+        }
+        bit_dump_stats_print(stdout, type, &stats);
+    }
+
+    if (map) {
+        munmap((void*) map, file_size);
+    }
+    return ok && 0 == fflush(stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file tools/quantize_stream.c
+ *
+ * @brief Quantizes a raw float file of any size in bounded memory.
+ *
+ * Usage: quantize_stream [-s f32|f16|bf16] [-t k8|k4|k2|mxfp8|...|f32]
+ *                        [-c chunk] [-d depth] input output
+ */
+
+#include "quant_stream.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void usage(const char* program) {
+    fprintf(
+        stderr,
+        "Usage: %s [-s src_type] [-t dst_type] [-c chunk] [-d depth] input output\n"
+        "  -s  Raw input encoding: f32, f16 or bf16 (default f32)\n"
+        "  -t  Output encoding: k8, k4, k2, fp4, nf4, mxfp8, mxfp6, mxfp4, mxint8,\n"
+        "      f32, f16, bf16 or f8 (default k8)\n"
+        "  -c  Elements per chunk (default %d)\n"
+        "  -d  Chunks in flight (default %d)\n",
+        program,
+        QUANT_STREAM_CHUNK,
+        QUANT_STREAM_DEPTH
+    );
+}
+
+// Parses a positive decimal count; rejects signs, trailing text, zero and overflow
+static bool parse_count(const char* text, size_t* count) {
+    if (!isdigit((unsigned char) text[0])) {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+
+    const unsigned long long value = strtoull(text, &end, 10);
+    if ('\0' != *end || ERANGE == errno || 0 == value || value > SIZE_MAX) {
+        return false;
+    }
+
+    *count = (size_t) value;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    quant_stream_params_t params = quant_stream_default_params(TYPE_FLOAT_F32, TYPE_QUANT_K8);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "s:t:c:d:h"))) {
+        switch (opt) {
+            case 's':
+                params.src_type = quant_type_from_name(optarg);
+                if (TYPE_FLOAT_F32 != params.src_type && TYPE_FLOAT_F16 != params.src_type
+                    && TYPE_FLOAT_BF16 != params.src_type) {
+                    fprintf(stderr, "%s: -s must be f32, f16 or bf16, not '%s'\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                params.dst_type = quant_type_from_name(optarg);
+                break;
+            case 'c':
+                if (!parse_count(optarg, &params.chunk_size)) {
+                    fprintf(stderr, "%s: -c must be a positive count, not '%s'\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'd':
+                if (!parse_count(optarg, &params.n_chunks)) {
+                    fprintf(stderr, "%s: -d must be a positive count, not '%s'\n", argv[0], optarg);
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 2 || TYPE_MAX_COUNT == params.dst_type) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    quant_stream_stats_t stats;
+    if (!quant_stream_file(argv[optind], argv[optind + 1], &params, &stats)) {
+        perror("quantize_stream");
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%s -> %s: %llu elements, %llu bytes read, %llu bytes written\n",
+        quant_type_name(params.src_type),
+        quant_type_name(params.dst_type),
+        (unsigned long long) stats.n_elements,
+        (unsigned long long) stats.bytes_read,
+        (unsigned long long) stats.bytes_written
+    );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file tools/verify_conv2d.c
+ *
+ * @brief Checks the integer convolutions against an exact int64 reference.
+ *
+ * Each case runs conv2d() or conv2d_depthwise() on a small image and
+ * compares every output with the same convolution summed in int64 and
+ * scaled in double precision. The full-scale cases drive every product to
+ * its largest magnitude, so their true sums exceed int32 and only pass when
+ * the accumulators are protected.
+ *
+ * Usage: verify_conv2d [-t threads]
+ */
+
+#include "conv2d.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// Largest accepted absolute error, in output LSB.
+#define VERIFY_TOLERANCE 1.0
+
+typedef struct {
+    const char*   name;
+    conv2d_type_t type; // Input and output encoding
+    bool          depthwise;
+    size_t        kernel;     // Square kernel size
+    size_t        channels;   // Input channels; output channels for standard cases
+    bool          full_scale; // Every input -32768 or -128 and every weight -128
+    double        gain;       // Real multiplier relative to the full-scale sum
+} verify_case_t;
+
+static const verify_case_t verify_cases[] = {
+    {"q15_3x3x64_full", CONV2D_Q15, false, 3, 64, true, 0.5},
+    {"q15_3x3x64_random", CONV2D_Q15, false, 3, 64, false, 16.0},
+    {"q15_5x5x48_random", CONV2D_Q15, false, 5, 48, false, 16.0},
+    {"q15_3x3x16_random", CONV2D_Q15, false, 3, 16, false, 8.0},
+    {"i8_3x3x64_full", CONV2D_I8, false, 3, 64, true, 0.5},
+    {"i8_3x3x64_random", CONV2D_I8, false, 3, 64, false, 16.0},
+    {"q15_dw_25x25_full", CONV2D_Q15, true, 25, 16, true, 0.5},
+    {"q15_dw_3x3_random", CONV2D_Q15, true, 3, 20, false, 4.0},
+};
+
+#define VERIFY_N_CASES (sizeof(verify_cases) / sizeof(verify_cases[0]))
+
+static int32_t verify_random(int32_t min, int32_t max) {
+    return min + (int32_t) ((double) rand() / ((double) RAND_MAX + 1.0) * (max - min + 1));
+}
+
+static bool verify_case(const verify_case_t* c, size_t n_threads) {
+    const bool           q15 = CONV2D_Q15 == c->type;
+    const conv2d_shape_t s   = {
+          .batch        = 2,
+          .height       = c->kernel + 4,
+          .width        = c->kernel + 3,
+          .in_channels  = c->channels,
+          .out_channels = c->depthwise ? c->channels : 12,
+          .kernel_h     = c->kernel,
+          .kernel_w     = c->kernel,
+          .pad_h        = c->kernel / 2,
+          .pad_w        = c->kernel / 2,
+    };
+
+    const size_t  taps  = c->kernel * c->kernel;
+    const size_t  k     = c->depthwise ? taps : taps * c->channels;
+    const size_t  out_h = conv2d_out_height(&s);
+    const size_t  out_w = conv2d_out_width(&s);
+    const size_t  n_src = s.batch * s.height * s.width * s.in_channels;
+    const size_t  n_dst = s.batch * out_h * out_w * s.out_channels;
+    const size_t  n_w   = taps * s.in_channels * (c->depthwise ? 1 : s.out_channels);
+    const size_t  elem  = q15 ? sizeof(int16_t) : sizeof(int8_t);
+    const int32_t zp_in = q15 ? 0 : 127; // Shifts -128 to -255, the largest int8 magnitude
+
+    void*    src        = malloc(n_src * elem);
+    void*    dst        = malloc(n_dst * elem);
+    int8_t*  w          = (int8_t*) malloc(n_w);
+    int32_t* bias       = (int32_t*) malloc(s.out_channels * sizeof(int32_t));
+    int32_t* multiplier = (int32_t*) malloc(s.out_channels * sizeof(int32_t));
+    int32_t* shift      = (int32_t*) malloc(s.out_channels * sizeof(int32_t));
+    if (!src || !dst || !w || !bias || !multiplier || !shift) {
+        free(src);
+        free(dst);
+        free(w);
+        free(bias);
+        free(multiplier);
+        free(shift);
+        return false;
+    }
+
+    for (size_t i = 0; i < n_src; ++i) {
+        if (q15) {
+            const int32_t v     = verify_random(INT16_MIN, INT16_MAX);
+            ((int16_t*) src)[i] = (int16_t) (c->full_scale ? INT16_MIN : v);
+        } else {
+            const int32_t v    = verify_random(INT8_MIN, INT8_MAX);
+            ((int8_t*) src)[i] = (int8_t) (c->full_scale ? INT8_MIN : v);
+        }
+    }
+    for (size_t i = 0; i < n_w; ++i) {
+        w[i] = c->full_scale ? INT8_MIN : (int8_t) verify_random(INT8_MIN, INT8_MAX);
+    }
+
+    // Scale the largest possible sum to gain times the output range
+    const double x_max   = q15 ? 32768.0 : 255.0;
+    const double out_max = q15 ? 32767.0 : 127.0;
+    const double real    = c->gain * out_max / ((double) k * x_max * 128.0);
+    for (size_t o = 0; o < s.out_channels; ++o) {
+        const quant_multiplier_t m = quant_multiplier_from_float(real * (1.0 + 0.01 * (double) o));
+        multiplier[o]              = m.multiplier;
+        shift[o]                   = m.shift;
+        bias[o]                    = verify_random(-(1 << 20), 1 << 20);
+    }
+
+    const conv2d_epilogue_t e       = {bias, multiplier, shift, zp_in, 0, false};
+    conv2d_weights_t*       weights = c->depthwise ? NULL : malloc_conv2d_weights(&s, w);
+    bool                    ran     = false;
+    if (c->depthwise) {
+        ran = conv2d_depthwise(&s, c->type, src, w, &e, c->type, dst, n_threads);
+    } else if (weights) {
+        ran = conv2d(&s, c->type, src, weights, &e, c->type, dst, n_threads);
+    }
+
+    double max_error = ran ? 0.0 : INFINITY;
+    for (size_t i = 0; ran && i < n_dst; ++i) {
+        const size_t o  = i % s.out_channels;
+        const size_t ox = (i / s.out_channels) % out_w;
+        const size_t oy = (i / (s.out_channels * out_w)) % out_h;
+        const size_t b  = i / (s.out_channels * out_w * out_h);
+
+        int64_t acc = bias[o];
+        for (size_t ky = 0; ky < s.kernel_h; ++ky) {
+            for (size_t kx = 0; kx < s.kernel_w; ++kx) {
+                const size_t y = oy + ky - s.pad_h;
+                const size_t x = ox + kx - s.pad_w;
+                if (y >= s.height || x >= s.width) {
+                    continue;
+                }
+                const size_t pixel = ((b * s.height + y) * s.width + x) * s.in_channels;
+                for (size_t ci = 0; ci < s.in_channels; ++ci) {
+                    if (c->depthwise && ci != o) {
+                        continue;
+                    }
+                    const size_t  tap = (ky * s.kernel_w + kx) * s.in_channels + ci;
+                    const int32_t xv  = q15 ? ((int16_t*) src)[pixel + ci]
+                                            : ((int8_t*) src)[pixel + ci] - zp_in;
+                    acc += (int64_t) xv * w[c->depthwise ? tap : o * k + tap];
+                }
+            }
+        }
+
+        double expected = (double) acc * multiplier[o] / 2147483648.0 / ldexp(1.0, shift[o]);
+        expected        = fmin(out_max, fmax(-out_max - 1.0, expected));
+        const double actual = q15 ? ((int16_t*) dst)[i] : ((int8_t*) dst)[i];
+        const double error  = fabs(actual - expected);
+        max_error           = error > max_error ? error : max_error;
+    }
+
+    const bool passed = max_error <= VERIFY_TOLERANCE;
+    printf(
+        "%-18s K %-5zu max abs error %.3g LSB  %s\n",
+        c->name,
+        k,
+        max_error,
+        passed ? "ok" : "FAILED"
+    );
+
+    free_conv2d_weights(weights);
+    free(src);
+    free(dst);
+    free(w);
+    free(bias);
+    free(multiplier);
+    free(shift);
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n_threads = 0;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "t:h"))) {
+        switch (opt) {
+            case 't':
+                n_threads = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t threads]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    srand(1);
+    bool passed = true;
+    for (size_t k = 0; k < VERIFY_N_CASES; ++k) {
+        passed = verify_case(&verify_cases[k], n_threads) && passed;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,350 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file tools/verify_conversions.c
+ *
+ * @brief Exhaustively checks the library's SIMD conversions against the scalar codecs.
+ *
+ * The kernels are the simd_convert_* entry points from src/simd_convert.h,
+ * which run the same AVX2 and F16C helpers as blas_half.c, reduce.c,
+ * float_compare.c and quant_mx.c. The tool must be built with the library's
+ * instruction set flags, otherwise they only exercise the scalar fallback.
+ *
+ * Encoders are driven with all 2^32 fp32 bit patterns, decoders with every
+ * 2^16 or 2^8 code. Each kernel converts inputs in chunks of VERIFY_CHUNK
+ * and every output is compared bit for bit with encode_float16(),
+ * encode_bfloat16() or the matching decoder. Chunks are spread over all
+ * processors with parallel_for().
+ *
+ * By default any NaN output is accepted where the reference is NaN, since
+ * payload propagation is not specified; -s requires identical NaN bits.
+ *
+ * Usage: verify_conversions [-k kernel] [-t threads] [-m max_report] [-s]
+ */
+
+#include "floating_point.h"
+#include "parallel.h"
+#include "simd_convert.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Inputs converted per scheduled task.
+#define VERIFY_CHUNK      (1 << 14)
+
+/// Upper bound on mismatches kept for the report.
+#define VERIFY_MAX_REPORT 64
+
+typedef struct {
+    const char* name;
+    size_t      input_bits;  // 32 for encoders, 16 or 8 for decoders
+    size_t      output_size; // bytes per output code
+    void (*bulk)(const void* src, void* dst, size_t n);
+    uint32_t (*reference)(uint32_t input);
+    bool (*is_nan)(uint32_t output);
+} verify_kernel_t;
+
+typedef struct {
+    uint32_t input;
+    uint32_t expected;
+    uint32_t actual;
+} verify_mismatch_t;
+
+typedef struct {
+    const verify_kernel_t* kernel;
+    bool                   strict;
+    size_t                 max_report;
+    _Atomic uint64_t       n_mismatches;
+    pthread_mutex_t        lock;
+    size_t                 n_report;
+    verify_mismatch_t      report[VERIFY_MAX_REPORT];
+} verify_task_t;
+
+/*
+ * NaN predicates per output encoding
+ */
+
+static bool is_nan_f32(uint32_t bits) {
+    return (bits & UINT32_C(0x7FFFFFFF)) > UINT32_C(0x7F800000);
+}
+
+static bool is_nan_f16(uint32_t bits) {
+    return (bits & 0x7FFF) > 0x7C00;
+}
+
+static bool is_nan_bf16(uint32_t bits) {
+    return (bits & 0x7FFF) > 0x7F80;
+}
+
+/*
+ * Scalar references
+ */
+
+static uint32_t ref_encode_f16(uint32_t input) {
+    return encode_float16(decode_float32(input));
+}
+
+static uint32_t ref_encode_bf16(uint32_t input) {
+    return encode_bfloat16(decode_float32(input));
+}
+
+static uint32_t ref_decode_f16(uint32_t input) {
+    return encode_float32(decode_float16((float16_t) input));
+}
+
+static uint32_t ref_decode_bf16(uint32_t input) {
+    return encode_float32(decode_bfloat16((bfloat16_t) input));
+}
+
+static uint32_t ref_decode_f8(uint32_t input) {
+    return encode_float32(decode_float8((float8_t) input));
+}
+
+/*
+ * Bulk kernels under test
+ */
+
+static void simd_encode_f16(const void* src, void* dst, size_t n) {
+    simd_convert_encode_f16((const float*) src, (float16_t*) dst, n);
+}
+
+static void simd_encode_bf16(const void* src, void* dst, size_t n) {
+    simd_convert_encode_bf16((const float*) src, (bfloat16_t*) dst, n);
+}
+
+static void simd_decode_f16(const void* src, void* dst, size_t n) {
+    simd_convert_decode_f16((const float16_t*) src, (float*) dst, n);
+}
+
+static void simd_decode_bf16(const void* src, void* dst, size_t n) {
+    simd_convert_decode_bf16((const bfloat16_t*) src, (float*) dst, n);
+}
+
+static void simd_decode_f8(const void* src, void* dst, size_t n) {
+    simd_convert_decode_f8((const float8_t*) src, (float*) dst, n);
+}
+
+static void simd_decode_f8_mx(const void* src, void* dst, size_t n) {
+    simd_convert_decode_f8_mx((const float8_t*) src, (float*) dst, n);
+}
+
+static const verify_kernel_t verify_kernels[] = {
+    {"simd_encode_f16", 32, 2, simd_encode_f16, ref_encode_f16, is_nan_f16},
+    {"simd_encode_bf16", 32, 2, simd_encode_bf16, ref_encode_bf16, is_nan_bf16},
+    {"simd_decode_f16", 16, 4, simd_decode_f16, ref_decode_f16, is_nan_f32},
+    {"simd_decode_bf16", 16, 4, simd_decode_bf16, ref_decode_bf16, is_nan_f32},
+    {"simd_decode_f8", 8, 4, simd_decode_f8, ref_decode_f8, is_nan_f32},
+    {"simd_decode_f8_mx", 8, 4, simd_decode_f8_mx, ref_decode_f8, is_nan_f32},
+};
+
+#define VERIFY_N_KERNELS (sizeof(verify_kernels) / sizeof(verify_kernels[0]))
+
+/*
+ * Sweep
+ */
+
+static uint32_t load_code(const uint8_t* buffer, size_t size, size_t i) {
+    switch (size) {
+        case 1:
+            return buffer[i];
+        case 2:
+            return ((const uint16_t*) buffer)[i];
+        default:
+            return ((const uint32_t*) buffer)[i];
+    }
+}
+
+static void store_code(uint8_t* buffer, size_t size, size_t i, uint32_t code) {
+    switch (size) {
+        case 1:
+            buffer[i] = (uint8_t) code;
+            break;
+        case 2:
+            ((uint16_t*) buffer)[i] = (uint16_t) code;
+            break;
+        default:
+            ((uint32_t*) buffer)[i] = code;
+            break;
+    }
+}
+
+// Keeps the max_report lowest mismatching inputs, in input order
+static void verify_record(verify_task_t* task, const verify_mismatch_t* found, size_t count) {
+    pthread_mutex_lock(&task->lock);
+    for (size_t f = 0; f < count; ++f) {
+        size_t slot = task->n_report;
+        while (slot > 0 && task->report[slot - 1].input > found[f].input) {
+            slot--;
+        }
+        if (slot >= task->max_report) {
+            continue;
+        }
+        const bool   full = task->n_report >= task->max_report;
+        const size_t kept = full ? task->max_report - 1 : task->n_report;
+        memmove(&task->report[slot + 1], &task->report[slot], (kept - slot) * sizeof(*found));
+        task->report[slot] = found[f];
+        task->n_report     = kept + 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+}
+
+static void verify_chunks(void* ctx, size_t begin, size_t end, size_t thread) {
+    verify_task_t*         task   = (verify_task_t*) ctx;
+    const verify_kernel_t* kernel = task->kernel;
+    const size_t           input  = kernel->input_bits / 8;
+    const size_t           domain = (size_t) 1 << kernel->input_bits;
+    (void) thread;
+
+    _Alignas(32) uint8_t src[VERIFY_CHUNK * sizeof(uint32_t)];
+    _Alignas(32) uint8_t dst[VERIFY_CHUNK * sizeof(uint32_t)];
+
+    for (size_t c = begin; c < end; ++c) {
+        const size_t first = c * VERIFY_CHUNK;
+        const size_t count = domain - first < VERIFY_CHUNK ? domain - first : VERIFY_CHUNK;
+
+        for (size_t i = 0; i < count; ++i) {
+            store_code(src, input, i, (uint32_t) (first + i));
+        }
+        kernel->bulk(src, dst, count);
+
+        verify_mismatch_t found[VERIFY_MAX_REPORT];
+        size_t            n_found = 0;
+        uint64_t          n_bad   = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t expected = kernel->reference((uint32_t) (first + i));
+            const uint32_t actual   = load_code(dst, kernel->output_size, i);
+            if (expected == actual
+                || (!task->strict && kernel->is_nan(expected) && kernel->is_nan(actual))) {
+                continue;
+            }
+            if (n_found < task->max_report) {
+                found[n_found++] = (verify_mismatch_t) {(uint32_t) (first + i), expected, actual};
+            }
+            n_bad++;
+        }
+
+        if (n_bad) {
+            atomic_fetch_add(&task->n_mismatches, n_bad);
+            verify_record(task, found, n_found);
+        }
+    }
+}
+
+static bool
+verify_kernel(const verify_kernel_t* kernel, size_t n_threads, size_t max_report, bool strict) {
+    verify_task_t task;
+    task.kernel     = kernel;
+    task.strict     = strict;
+    task.max_report = max_report;
+    task.n_report   = 0;
+    atomic_init(&task.n_mismatches, 0);
+    pthread_mutex_init(&task.lock, NULL);
+
+    // Decoders see fewer inputs than one chunk covers; the partial chunk is trimmed above
+    const size_t domain   = (size_t) 1 << kernel->input_bits;
+    const size_t n_chunks = (domain + VERIFY_CHUNK - 1) / VERIFY_CHUNK;
+
+    struct timespec start;
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parallel_for(n_chunks, 1, n_threads, verify_chunks, &task);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    const double   seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+    const uint64_t n_bad   = atomic_load(&task.n_mismatches);
+
+    printf(
+        "%-16s %10zu inputs  %10llu mismatches  %7.2f s\n",
+        kernel->name,
+        domain,
+        (unsigned long long) n_bad,
+        seconds
+    );
+    for (size_t i = 0; i < task.n_report; ++i) {
+        printf(
+            "    input 0x%08x  expected 0x%08x  actual 0x%08x\n",
+            task.report[i].input,
+            task.report[i].expected,
+            task.report[i].actual
+        );
+    }
+
+    fflush(stdout);
+
+    pthread_mutex_destroy(&task.lock);
+    return 0 == n_bad;
+}
+
+static void usage(const char* program) {
+    fprintf(
+        stderr,
+        "Usage: %s [-k kernel] [-t threads] [-m max_report] [-s]\n"
+        "  -k  Verify only the named kernel (default all)\n"
+        "  -t  Worker threads (default all processors)\n"
+        "  -m  Mismatches listed per kernel, at most %d (default 8)\n"
+        "  -s  Require bit-identical NaN outputs\n"
+        "Kernels:",
+        program,
+        VERIFY_MAX_REPORT
+    );
+    for (size_t k = 0; k < VERIFY_N_KERNELS; ++k) {
+        fprintf(stderr, " %s", verify_kernels[k].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* only       = NULL;
+    size_t      n_threads  = 0;
+    size_t      max_report = 8;
+    bool        strict     = false;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "k:t:m:sh"))) {
+        switch (opt) {
+            case 'k':
+                only = optarg;
+                break;
+            case 't':
+                n_threads = strtoull(optarg, NULL, 10);
+                break;
+            case 'm':
+                max_report = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                strict = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc || max_report > VERIFY_MAX_REPORT) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool   passed = true;
+    size_t n_run  = 0;
+    for (size_t k = 0; k < VERIFY_N_KERNELS; ++k) {
+        if (only && 0 != strcmp(only, verify_kernels[k].name)) {
+            continue;
+        }
+        passed = verify_kernel(&verify_kernels[k], n_threads, max_report, strict) && passed;
+        n_run++;
+    }
+
+    if (0 == n_run) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright © 2024 Austin Berrio
+ *
+ * @file tools/verify_norm.c
+ *
+ * @brief Checks the integer RMSNorm and LayerNorm kernels against a double reference.
+ *
+ * Each case normalizes a few rows with rms_norm_fixed16() and
+ * layer_norm_fixed16() and compares every output with the same formula
+ * evaluated in double precision. Rows span large, small and offset values.
+ * The regression cases hold only a few LSB per element, so eps dominates the
+ * variance and the output has to follow it.
+ *
+ * Usage: verify_norm [-t threads]
+ */
+
+#include "quant_norm.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/// Largest accepted absolute error, a few fixed16_t LSB.
+#define VERIFY_TOLERANCE 1e-4
+
+typedef struct {
+    const char*    name;
+    size_t         cols;
+    double         amplitude; // Values within amplitude of offset, in fixed16_t LSB
+    double         offset;
+    fixed16_t      eps;
+    const int32_t* values; // Fixed row instead of random values, or NULL
+} verify_case_t;
+
+static const int32_t small_row[] = {3, -5, 6, 1, -2, 4, 0, -6};
+
+static const verify_case_t verify_cases[] = {
+    {"random_unit", 4096, 65536.0, 0.0, 1, NULL},
+    {"random_large", 1024, 1 << 30, 0.0, 1, NULL},
+    {"random_offset", 1000, 6553.6, 32768.0, 16, NULL},
+    {"random_tiny", 256, 64.0, 0.0, 1, NULL},
+    {"small_eps_1", 8, 0.0, 0.0, 1, small_row},
+    {"small_eps_16", 8, 0.0, 0.0, 16, small_row},
+    {"small_eps_65536", 8, 0.0, 0.0, 65536, small_row},
+};
+
+#define VERIFY_N_CASES (sizeof(verify_cases) / sizeof(verify_cases[0]))
+
+static bool verify_case(const verify_case_t* c, bool center, size_t n_threads) {
+    const size_t rows = 4;
+    const size_t n    = c->cols;
+    fixed16_t*   x    = (fixed16_t*) malloc(rows * n * sizeof(fixed16_t));
+    fixed16_t*   y    = (fixed16_t*) malloc(rows * n * sizeof(fixed16_t));
+    if (!x || !y) {
+        free(x);
+        free(y);
+        return false;
+    }
+
+    for (size_t i = 0; i < rows * n; ++i) {
+        const double u = (double) rand() / RAND_MAX * 2.0 - 1.0;
+        x[i]           = c->values ? c->values[i % n]
+                                   : (fixed16_t) lround(c->offset + c->amplitude * u);
+    }
+
+    if (center) {
+        layer_norm_fixed16(x, y, rows, n, NULL, NULL, c->eps, n_threads);
+    } else {
+        rms_norm_fixed16(x, y, rows, n, NULL, c->eps, n_threads);
+    }
+
+    double max_error = 0.0;
+    for (size_t r = 0; r < rows; ++r) {
+        const fixed16_t* xr   = x + r * n;
+        double           mean = 0.0;
+        double           var  = 0.0;
+        for (size_t i = 0; center && i < n; ++i) {
+            mean += xr[i] / 65536.0;
+        }
+        mean /= (double) n;
+        for (size_t i = 0; i < n; ++i) {
+            const double d = xr[i] / 65536.0 - mean;
+            var += d * d;
+        }
+
+        const double inv = 1.0 / sqrt(var / (double) n + c->eps / 65536.0);
+        for (size_t i = 0; i < n; ++i) {
+            const double error = fabs(y[r * n + i] / 65536.0 - (xr[i] / 65536.0 - mean) * inv);
+            max_error          = error > max_error ? error : max_error;
+        }
+    }
+
+    const bool passed = max_error <= VERIFY_TOLERANCE;
+    printf(
+        "%-11s %-16s max abs error %.3g  %s\n",
+        center ? "layer_norm" : "rms_norm",
+        c->name,
+        max_error,
+        passed ? "ok" : "FAILED"
+    );
+
+    free(x);
+    free(y);
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n_threads = 0;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "t:h"))) {
+        switch (opt) {
+            case 't':
+                n_threads = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t threads]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    srand(1);
+    bool passed = true;
+    for (size_t k = 0; k < VERIFY_N_CASES; ++k) {
+        passed = verify_case(&verify_cases[k], false, n_threads) && passed;
+        passed = verify_case(&verify_cases[k], true, n_threads) && passed;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}